@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+#include "compact-catalog.hpp"
+
+#include <algorithm>
+
+#include <boost/assert.hpp>
+#include <boost/concept_check.hpp>
+
+namespace ndn {
+namespace ntorrent {
+
+BOOST_CONCEPT_ASSERT((boost::EqualityComparable<CompactCatalog>));
+
+// ACCESSORS
+Name
+CompactCatalog::at(size_t index) const
+{
+  BOOST_ASSERT(index < size());
+  Name name(m_packetPrefix);
+  name.appendSequenceNumber(index);
+  name.append(name::Component::fromImplicitSha256Digest(digest(index), DIGEST_SIZE));
+  return name;
+}
+
+size_t
+CompactCatalog::find(const Name& name) const
+{
+  if (name.size() != m_packetPrefix.size() + 2 || !m_packetPrefix.isPrefixOf(name)) {
+    return size();
+  }
+  const auto& seqComponent    = name.get(-2);
+  const auto& digestComponent = name.get(-1);
+  if (!seqComponent.isSequenceNumber() || !digestComponent.isImplicitSha256Digest()) {
+    return size();
+  }
+  auto index = seqComponent.toSequenceNumber();
+  if (index >= size() ||
+      !std::equal(digestComponent.value_begin(), digestComponent.value_end(), digest(index))) {
+    return size();
+  }
+  return index;
+}
+
+std::vector<Name>
+CompactCatalog::materialize() const
+{
+  std::vector<Name> names;
+  names.reserve(size());
+  for (size_t i = 0; i < size(); ++i) {
+    names.push_back(at(i));
+  }
+  return names;
+}
+
+// MANIPULATORS
+bool
+CompactCatalog::push_back(const Name& name)
+{
+  if (name.size() != m_packetPrefix.size() + 2 || !m_packetPrefix.isPrefixOf(name)) {
+    return false;
+  }
+  const auto& seqComponent    = name.get(-2);
+  const auto& digestComponent = name.get(-1);
+  if (!seqComponent.isSequenceNumber()
+   || seqComponent.toSequenceNumber() != size()
+   || !digestComponent.isImplicitSha256Digest()) {
+    return false;
+  }
+  m_digests.insert(m_digests.end(), digestComponent.value_begin(), digestComponent.value_end());
+  return true;
+}
+
+bool
+CompactCatalog::push_back_suffix(size_t prefixSize, const Block& suffix)
+{
+  suffix.parse();
+  const auto& components = suffix.elements();
+  if (prefixSize > m_packetPrefix.size()
+   || components.size() != m_packetPrefix.size() - prefixSize + 2) {
+    return false;
+  }
+  for (size_t i = prefixSize; i < m_packetPrefix.size(); ++i) {
+    if (name::Component(components[i - prefixSize]) != m_packetPrefix.get(i)) {
+      return false;
+    }
+  }
+  name::Component seqComponent(components[components.size() - 2]);
+  name::Component digestComponent(components.back());
+  if (!seqComponent.isSequenceNumber()
+   || seqComponent.toSequenceNumber() != size()
+   || !digestComponent.isImplicitSha256Digest()) {
+    return false;
+  }
+  m_digests.insert(m_digests.end(), digestComponent.value_begin(), digestComponent.value_end());
+  return true;
+}
+
+bool operator==(const CompactCatalog& lhs, const CompactCatalog& rhs)
+{
+  return lhs.size()          == rhs.size()
+      && lhs.packet_prefix() == rhs.packet_prefix()
+      && (lhs.empty() || std::equal(lhs.digest(0),
+                                    lhs.digest(0) + lhs.size() * CompactCatalog::DIGEST_SIZE,
+                                    rhs.digest(0)));
+}
+
+}  // end ntorrent
+}  // end ndn
@@ -0,0 +1,206 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+#ifndef INCLUDED_COMPACT_CATALOG_HPP
+#define INCLUDED_COMPACT_CATALOG_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <ndn-cxx/name.hpp>
+
+namespace ndn {
+namespace ntorrent {
+
+class CompactCatalog {
+/**
+* \class CompactCatalog
+*
+* \brief A compact, value semantic representation of the catalog of a FileManifest
+*
+* Every entry of a regular catalog has the form <packetPrefix>/<seq-num>/<implicit-digest>, where
+* <seq-num> is the position of the entry in the catalog. Rather than storing one Name per entry,
+* a CompactCatalog stores the shared 'packetPrefix' once along with a contiguous array of the
+* 32-byte implicit digests, indexed by sequence number. Names are materialised on demand.
+*/
+ public:
+  // TYPES
+  enum {
+    // The size in bytes of each implicit SHA-256 digest stored in the catalog
+    DIGEST_SIZE = 32
+  };
+
+  // CREATORS
+  CompactCatalog() = default;
+
+  explicit
+  CompactCatalog(const Name& packetPrefix);
+  /// Creates a new empty catalog for the Data packets named under the specified 'packetPrefix'
+
+  // ACCESSORS
+  const Name&
+  packet_prefix() const;
+  /// Returns the common prefix of the Data packets in this catalog
+
+  size_t
+  size() const;
+  /// Returns the number of entries in this catalog
+
+  bool
+  empty() const;
+  /// Returns 'true' if this catalog has no entries, and 'false' otherwise
+
+  Name
+  at(size_t index) const;
+  /**
+   * \brief Returns the full name of the Data packet at the specified 'index'
+   *
+   * The behavior is undefined unless 'index < size()'.
+   */
+
+  const uint8_t*
+  digest(size_t index) const;
+  /**
+   * \brief Returns a pointer to the DIGEST_SIZE bytes of the implicit digest at 'index'
+   *
+   * The behavior is undefined unless 'index < size()'.
+   */
+
+  size_t
+  find(const Name& name) const;
+  /// Returns the index of the specified 'name' in this catalog, or 'size()' if it is not present
+
+  std::vector<Name>
+  materialize() const;
+  /// Returns the full names of all the entries in this catalog, in order
+
+  // MANIPULATORS
+  bool
+  push_back(const Name& name);
+  /**
+   * \brief Appends the specified 'name' to this catalog if it is the next regular entry
+   *
+   * Returns 'true' if 'name' has the form <packetPrefix>/<size()>/<implicit-digest> and was
+   * appended, and 'false' (leaving this catalog unmodified) otherwise.
+   */
+
+  bool
+  push_back_suffix(size_t prefixSize, const Block& suffix);
+  /**
+   * \brief Appends the entry named by the first 'prefixSize' components of the packet prefix
+   *        followed by the components of the specified 'suffix' Name TLV
+   *
+   * Same as 'push_back', but reads the components of 'suffix' in place, as they are decoded
+   * from a manifest, without building the Name of the entry.
+   */
+
+  void
+  pop_back();
+  /// Removes the last entry of this catalog. The behavior is undefined if this catalog is empty.
+
+  void
+  reserve(size_t capacity);
+  /// Reserve memory adequate to hold at least 'capacity' entries.
+
+  void
+  shrink_to_fit();
+  /// Release any memory reserved but not used by this catalog.
+
+  void
+  clear();
+  /// Removes all the entries of this catalog, retaining its packet prefix
+
+ private:
+  Name                 m_packetPrefix;
+  std::vector<uint8_t> m_digests;
+};
+
+/// Non-member functions
+bool operator==(const CompactCatalog& lhs, const CompactCatalog& rhs);
+/// Returns 'true' if 'lhs' and 'rhs' have the same value, 'false' otherwise.
+
+bool operator!=(const CompactCatalog& lhs, const CompactCatalog& rhs);
+/// Returns 'true' if 'lhs' and 'rhs' have different values, and 'false' otherwise.
+
+inline
+CompactCatalog::CompactCatalog(const Name& packetPrefix)
+: m_packetPrefix(packetPrefix)
+, m_digests()
+{
+}
+
+inline const Name&
+CompactCatalog::packet_prefix() const
+{
+  return m_packetPrefix;
+}
+
+inline size_t
+CompactCatalog::size() const
+{
+  return m_digests.size() / DIGEST_SIZE;
+}
+
+inline bool
+CompactCatalog::empty() const
+{
+  return m_digests.empty();
+}
+
+inline const uint8_t*
+CompactCatalog::digest(size_t index) const
+{
+  return &m_digests[index * DIGEST_SIZE];
+}
+
+inline void
+CompactCatalog::pop_back()
+{
+  m_digests.resize(m_digests.size() - DIGEST_SIZE);
+}
+
+inline void
+CompactCatalog::reserve(size_t capacity)
+{
+  m_digests.reserve(capacity * DIGEST_SIZE);
+}
+
+inline void
+CompactCatalog::shrink_to_fit()
+{
+  m_digests.shrink_to_fit();
+}
+
+inline void
+CompactCatalog::clear()
+{
+  m_digests.clear();
+}
+
+inline bool
+operator!=(const CompactCatalog& lhs, const CompactCatalog& rhs)
+{
+  return !(lhs == rhs);
+}
+
+}  // end ntorrent
+}  // end ndn
+
+#endif // INCLUDED_COMPACT_CATALOG_HPP
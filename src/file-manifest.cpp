@@ -20,8 +20,12 @@
 */
 #include "file-manifest.hpp"
 
+#include "util/chain-builder.hpp"
 #include "util/io-util.hpp"
+#include "util/signer.hpp"
+#include "util/tree-builder.hpp"
 
+#include <algorithm>
 #include <limits>
 
 #include <boost/assert.hpp>
@@ -109,13 +113,13 @@ FileManifest::generate(const std::string& filePath,
                                           dataPacketSize,
                                           subManifestSize,
                                           subManifestNum);
-    if (returnData) {
-      allPackets.insert(allPackets.end(), packets.begin(), packets.end());
-    }
     curr_manifest.reserve(packets.size());
     // Collect all the Data packets into the sub-manifests
     for (const auto& p: packets) {
-      curr_manifest.push_back(p.getFullName());
+      curr_manifest.push_back(p.fullName);
+      if (returnData) {
+        allPackets.push_back(Data(p.wire));
+      }
     }
     // append the last manifest
     manifests.push_back(curr_manifest);
@@ -123,18 +127,97 @@ FileManifest::generate(const std::string& filePath,
   allPackets.shrink_to_fit();
   manifests.shrink_to_fit();
   // Set all the submanifest_ptrs and sign all the manifests
-  security::KeyChain key_chain;
+  auto& signer = Signer::getDefault();
   manifests.back().finalize();
-  key_chain.sign(manifests.back(), signingWithSha256());
+  signer.sign(manifests.back());
   for (auto it = manifests.rbegin() + 1; it != manifests.rend(); ++it) {
     auto next = it - 1;
     it->set_submanifest_ptr(std::make_shared<Name>(next->getFullName()));
     it->finalize();
-    key_chain.sign(*it, signingWithSha256());
+    signer.sign(*it);
   }
   return {manifests, allPackets};
 }
 
+Name
+FileManifest::generateStreaming(const std::string& filePath,
+                                const Name&        manifestPrefix,
+                                size_t             subManifestSize,
+                                size_t             dataPacketSize,
+                                const SegmentSink& sink,
+                                size_t             fanout)
+{
+  BOOST_ASSERT(0 < subManifestSize);
+  BOOST_ASSERT(0 < dataPacketSize);
+  BOOST_ASSERT(1 != fanout);
+  fs::path path(filePath);
+  if (!fs::exists(path)) {
+    BOOST_THROW_EXCEPTION(Error(filePath + ": no such file."));
+  }
+  size_t file_length = fs::file_size(filePath);
+  if (0 == file_length) {
+    BOOST_THROW_EXCEPTION(Error(filePath + ": cannot generate the manifest of an empty file."));
+  }
+  size_t numSubManifests = file_length / (subManifestSize * dataPacketSize) +
+                              !!(file_length % (subManifestSize * dataPacketSize));
+  auto manifestName = get_name_of_manifest(filePath, manifestPrefix);
+  ChainBuilder<FileManifest> chain([] (FileManifest& m, const Name& next) {
+    m.set_submanifest_ptr(std::make_shared<Name>(next));
+  });
+  // The leaves of a tree do not point to each other, so each is signed as soon as it is
+  // complete, and the nodes above it as soon as their last child is
+  std::unique_ptr<TreeBuilder> tree;
+  if (0 != fanout) {
+    tree.reset(new TreeBuilder(manifestName, fanout, numSubManifests, sink));
+  }
+  for (auto subManifestNum : irange<size_t>(0, numSubManifests)) {
+    auto curr_manifest_name = manifestName;
+    curr_manifest_name.appendSequenceNumber(subManifestNum);
+    FileManifest curr_manifest(curr_manifest_name, dataPacketSize, manifestPrefix);
+    auto packets = IoUtil::packetize_file(path,
+                                          curr_manifest_name,
+                                          dataPacketSize,
+                                          subManifestSize,
+                                          subManifestNum);
+    curr_manifest.reserve(packets.size());
+    for (const auto& p: packets) {
+      curr_manifest.push_back(p.fullName);
+    }
+    if (nullptr == tree) {
+      chain.append(std::move(curr_manifest));
+      continue;
+    }
+    curr_manifest.finalize();
+    Signer::getDefault().sign(curr_manifest);
+    sink(curr_manifest);
+    tree->append(curr_manifest.getFullName());
+  }
+  return nullptr == tree ? chain.build(sink) : tree->getRootName();
+}
+
+std::pair<std::vector<FileManifest>, std::vector<ManifestTreeNode>>
+FileManifest::generateTree(const std::string& filePath,
+                           const Name&        manifestPrefix,
+                           size_t             subManifestSize,
+                           size_t             dataPacketSize,
+                           size_t             fanout)
+{
+  BOOST_ASSERT(1 < fanout);
+  std::vector<FileManifest> manifests;
+  std::vector<ManifestTreeNode> nodes;
+  generateStreaming(filePath, manifestPrefix, subManifestSize, dataPacketSize,
+                    [&manifests, &nodes] (const Data& segment) {
+                      if (IoUtil::MANIFEST_TREE_NODE == IoUtil::findType(segment.getFullName())) {
+                        nodes.push_back(ManifestTreeNode(segment.wireEncode()));
+                      }
+                      else {
+                        manifests.push_back(FileManifest(segment.wireEncode()));
+                      }
+                    },
+                    fanout);
+  return {std::move(manifests), std::move(nodes)};
+}
+
 void
 FileManifest::wireDecode(const Block& wire)
 {
@@ -165,10 +248,9 @@ FileManifest::encodeContent(ndn::EncodingImpl<TAG>& encoder) const {
 
   size_t totalLength = 0;
 
-  // build suffix catalog
-  vector<Name> suffixCatalog;
-  suffixCatalog.reserve(m_catalog.size());
-  for (auto name: m_catalog) {
+  // encode the suffix of each catalog entry (materialising one entry at a time)
+  for (size_t i = catalog_size(); i > 0; --i) {
+    Name name = catalog_entry(i - 1);
     if (!m_catalogPrefix.isPrefixOf(name)) {
       BOOST_THROW_EXCEPTION(Error(name.toUri() + " does not have the prefix "
                                                + m_catalogPrefix.toUri()));
@@ -177,10 +259,6 @@ FileManifest::encodeContent(ndn::EncodingImpl<TAG>& encoder) const {
     if (name.empty()) {
       BOOST_THROW_EXCEPTION(Error("Manifest cannot include empty string"));
     }
-    suffixCatalog.push_back(name);
-  }
-
-  for (const auto& name : suffixCatalog |  boost::adaptors::reversed) {
     totalLength += name.wireEncode(encoder);
   }
 
@@ -204,11 +282,31 @@ FileManifest::push_back(const Name& name)
 {
   BOOST_ASSERT(name != m_catalogPrefix);
   BOOST_ASSERT(m_catalogPrefix.isPrefixOf(name));
-  m_catalog.push_back(name.toUri());
+  if (m_isCompact) {
+    if (m_compactCatalog.push_back(name)) {
+      m_catalog.clear();
+      return;
+    }
+    expand();
+  }
+  m_catalog.push_back(name);
 }
 
 bool
 FileManifest::remove(const ndn::Name& name) {
+  if (m_isCompact) {
+    auto index = m_compactCatalog.find(name);
+    if (m_compactCatalog.size() == index) {
+      return false;
+    }
+    if (m_compactCatalog.size() - 1 == index) {
+      m_compactCatalog.pop_back();
+      m_catalog.clear();
+      return true;
+    }
+    // removing from the middle breaks the sequence numbering of the compact form
+    expand();
+  }
   const auto it = std::find(m_catalog.begin(), m_catalog.end(), name);
   if (m_catalog.end() == it) {
     return false;
@@ -219,10 +317,26 @@ FileManifest::remove(const ndn::Name& name) {
 
 void
 FileManifest::finalize() {
-  m_catalog.shrink_to_fit();
+  if (m_isCompact) {
+    m_compactCatalog.shrink_to_fit();
+    // drop any materialised copy of the catalog
+    std::vector<Name>().swap(m_catalog);
+  }
+  else {
+    m_catalog.shrink_to_fit();
+  }
   encodeContent();
 }
 
+void
+FileManifest::expand()
+{
+  BOOST_ASSERT(m_isCompact);
+  m_catalog = m_compactCatalog.materialize();
+  m_compactCatalog = CompactCatalog(m_compactCatalog.packet_prefix());
+  m_isCompact = false;
+}
+
 void FileManifest::encodeContent() {
   // Name
   //     <file_name>/ImplicitDigest
@@ -295,17 +409,42 @@ FileManifest::decodeContent() {
   ++element;
   // Catalog
   m_catalog.clear();
+  m_compactCatalog = CompactCatalog(getName());
+  m_isCompact = true;
+  // regular entries only contribute their digest, read in place from the suffix
+  const bool isPacketPrefix = m_catalogPrefix.isPrefixOf(getName());
   for (; element != content.elements_end(); ++element) {
     element->parse();
-    Name name = m_catalogPrefix;
-    name.append(Name(*element));
-    if (name == m_catalogPrefix) {
+    if (element->elements().empty()) {
       BOOST_THROW_EXCEPTION(Error("Empty name included in a FileManifest"));
     }
+    if (m_isCompact && isPacketPrefix
+     && m_compactCatalog.push_back_suffix(m_catalogPrefix.size(), *element)) {
+      continue;
+    }
+    Name name = m_catalogPrefix;
+    name.append(Name(*element));
     push_back(name);
   }
 }
 
+static bool
+catalogs_equal(const FileManifest& lhs, const FileManifest& rhs)
+{
+  if (lhs.is_compact() && rhs.is_compact()) {
+    return lhs.compact_catalog() == rhs.compact_catalog();
+  }
+  if (lhs.catalog_size() != rhs.catalog_size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.catalog_size(); ++i) {
+    if (lhs.catalog_entry(i) != rhs.catalog_entry(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool operator==(const FileManifest& lhs, const FileManifest& rhs) {
   return lhs.name()             == rhs.name()
       && lhs.data_packet_size() == rhs.data_packet_size()
@@ -315,7 +454,7 @@ bool operator==(const FileManifest& lhs, const FileManifest& rhs) {
            && *rhs.submanifest_ptr() == *lhs.submanifest_ptr()
          )
       )
-      && lhs.catalog()          == rhs.catalog();
+      && catalogs_equal(lhs, rhs);
 }
 
 bool operator!=(const FileManifest& lhs, const FileManifest& rhs) {
@@ -327,7 +466,7 @@ bool operator!=(const FileManifest& lhs, const FileManifest& rhs) {
          || *rhs.submanifest_ptr() != *lhs.submanifest_ptr()
         )
       )
-      || lhs.catalog()          != rhs.catalog();
+      || !catalogs_equal(lhs, rhs);
 }
 
 }  // end ntorrent
@@ -21,9 +21,12 @@
 #ifndef INCLUDED_FILE_MANIFEST_HPP
 #define INCLUDED_FILE_MANIFEST_HPP
 
+#include "compact-catalog.hpp"
+#include "manifest-tree-node.hpp"
 #include "util/shared-constants.hpp"
 
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -54,6 +57,9 @@ class FileManifest : public Data {
     }
   };
 
+  typedef std::function<void(const Data&)> SegmentSink;
+  /// Callback that receives each manifest as soon as it is finalized and signed
+
  public:
   // CLASS METHODS
   static std::vector<FileManifest>
@@ -88,8 +94,55 @@ class FileManifest : public Data {
    '* O < subManifestSize' and '0 < dataPacketSize'.
    */
 
+  static Name
+  generateStreaming(const std::string& filePath,
+                    const ndn::Name&   manifestPrefix,
+                    size_t             subManifestSize,
+                    size_t             dataPacketSize,
+                    const SegmentSink& sink,
+                    size_t             fanout = 0);
+  /**
+   * \brief Generates the FileManifest(s) for the file at the specified 'filePath', passing each
+   * one to the specified 'sink' as soon as it is signed
+   *
+   * @param fanout The maximum number of children of each node of the Merkle tree over the
+   *               sub-manifests, or 0 to chain them
+   *
+   * @throws Error if the file does not exist or is empty
+   *
+   * With a 0 'fanout', generates the same sub-manifests as 'generate', from the last one to the
+   * initial one. The sub-manifests are spilled, unsigned, to a temporary file until they can be
+   * chained, and the full name of the initial sub-manifest is returned. Otherwise, generates
+   * the same sub-manifests and ManifestTreeNode(s) as 'generateTree', passing each sub-manifest
+   * in order and each node once its children are passed, and returns the full name of the root
+   * of the tree. Either way, the memory used does not depend on the size of the file. The
+   * behavior is undefined if 'fanout' is 1.
+   */
+
+  static std::pair<std::vector<FileManifest>, std::vector<ManifestTreeNode>>
+  generateTree(const std::string& filePath,
+               const ndn::Name&   manifestPrefix,
+               size_t             subManifestSize,
+               size_t             dataPacketSize,
+               size_t             fanout);
+  /**
+   * \brief Generates the FileManifest(s) for the file at the specified 'filePath' and the
+   * Merkle tree of ManifestTreeNode(s) over them
+   *
+   * @param fanout The maximum number of children of each node of the tree
+   *
+   * @throws Error if the file does not exist or is empty
+   *
+   * Generates the same sub-manifests as 'generate', except that they are not chained: each one
+   * is authenticated through the nodes on its path to the root of the tree, so it can be fetched
+   * and verified independently of the others. Returns the sub-manifests in order, and the nodes
+   * in the order they are completed, so the root is the last node. The behavior is undefined
+   * unless '1 < fanout'.
+   */
+
   // CREATORS
-  FileManifest() = default;
+  FileManifest();
+  /// Creates a new empty FileManifest
 
   ~FileManifest() = default;
   /// Destroy this object
@@ -157,7 +210,42 @@ class FileManifest : public Data {
 
   const std::vector<Name>&
   catalog() const;
-  /// Returns an unmodifiable reference to the 'catalog' of this FileManifest
+  /**
+   * \brief Returns an unmodifiable reference to the 'catalog' of this FileManifest
+   *
+   * If the catalog is held in compact form, this materialises a Name for every entry; prefer
+   * 'catalog_size()' and 'catalog_entry()' on paths that only need some of the entries.
+   */
+
+  size_t
+  catalog_size() const;
+  /// Returns the number of entries in the 'catalog' of this FileManifest
+
+  Name
+  catalog_entry(size_t index) const;
+  /// Returns the entry at 'index' of the 'catalog'. Behavior is undefined unless in range.
+
+  const uint8_t*
+  catalog_digest(size_t index) const;
+  /**
+   * \brief Returns a pointer to the 32 bytes of the implicit digest of the entry at 'index'
+   *
+   * Returns 'nullptr' if the entry does not end with an implicit digest. Behavior is undefined
+   * unless 'index' is in range.
+   */
+
+  const CompactCatalog&
+  compact_catalog() const;
+  /// Returns the compact catalog of this FileManifest. Behavior is undefined unless 'is_compact()'
+
+  bool
+  is_compact() const;
+  /**
+   * \brief Returns 'true' if the catalog is held as a CompactCatalog, and 'false' otherwise
+   *
+   * A catalog is compact as long as every entry is <name()>/<seq-num>/<implicit-digest> with
+   * <seq-num> equal to its position, which holds for all generated and received manifests.
+   */
 
  private:
   template<encoding::Tag TAG>
@@ -214,12 +302,20 @@ private:
   encodeContent();
   /// Encodes the contents of this FileManifest into the content section of its Data packet.
 
+  void
+  expand();
+  /// Converts the compact catalog into an explicit catalog of Names.
+
 // DATA
  private:
-  size_t                 m_dataPacketSize;
-  Name                   m_catalogPrefix;
-  std::vector<Name>      m_catalog;
-  std::shared_ptr<Name>  m_submanifestPtr;
+  size_t                    m_dataPacketSize;
+  Name                      m_catalogPrefix;
+  // The catalog while every entry is regular (see 'is_compact()')
+  CompactCatalog            m_compactCatalog;
+  // The catalog once it is no longer compact, otherwise a lazily materialised copy
+  mutable std::vector<Name> m_catalog;
+  std::shared_ptr<Name>     m_submanifestPtr;
+  bool                      m_isCompact;
 };
 
 /// Non-member functions
@@ -249,9 +345,15 @@ FileManifest::FileManifest(
 : Data(name)
 , m_dataPacketSize(dataPacketSize)
 , m_catalogPrefix(catalogPrefix)
-, m_catalog(catalog)
+, m_compactCatalog(name)
+, m_catalog()
 , m_submanifestPtr(subManifestPtr)
+, m_isCompact(true)
 {
+  reserve(catalog.size());
+  for (const auto& n : catalog) {
+    push_back(n);
+  }
 }
 
 
@@ -265,8 +367,26 @@ FileManifest::FileManifest(
 : Data(name)
 , m_dataPacketSize(dataPacketSize)
 , m_catalogPrefix(catalogPrefix)
-, m_catalog(catalog)
+, m_compactCatalog(name)
+, m_catalog()
 , m_submanifestPtr(subManifestPtr)
+, m_isCompact(true)
+{
+  reserve(catalog.size());
+  for (const auto& n : catalog) {
+    push_back(n);
+  }
+}
+
+inline
+FileManifest::FileManifest()
+: Data()
+, m_dataPacketSize(0)
+, m_catalogPrefix()
+, m_compactCatalog()
+, m_catalog()
+, m_submanifestPtr(nullptr)
+, m_isCompact(true)
 {
 }
 
@@ -275,8 +395,10 @@ FileManifest::FileManifest(const Block& block)
 : Data()
 , m_dataPacketSize(0)
 , m_catalogPrefix("")
+, m_compactCatalog()
 , m_catalog()
 , m_submanifestPtr(nullptr)
+, m_isCompact(true)
 {
   wireDecode(block);
 }
@@ -302,9 +424,49 @@ FileManifest::catalog_prefix() const
 inline const std::vector<Name>&
 FileManifest::catalog() const
 {
+  if (m_isCompact && m_catalog.size() != m_compactCatalog.size()) {
+    m_catalog = m_compactCatalog.materialize();
+  }
   return m_catalog;
 }
 
+inline size_t
+FileManifest::catalog_size() const
+{
+  return m_isCompact ? m_compactCatalog.size() : m_catalog.size();
+}
+
+inline Name
+FileManifest::catalog_entry(size_t index) const
+{
+  return m_isCompact ? m_compactCatalog.at(index) : m_catalog[index];
+}
+
+inline const uint8_t*
+FileManifest::catalog_digest(size_t index) const
+{
+  if (m_isCompact) {
+    return m_compactCatalog.digest(index);
+  }
+  const Name& entry = m_catalog[index];
+  if (entry.empty() || !entry.get(-1).isImplicitSha256Digest()) {
+    return nullptr;
+  }
+  return entry.get(-1).value();
+}
+
+inline const CompactCatalog&
+FileManifest::compact_catalog() const
+{
+  return m_compactCatalog;
+}
+
+inline bool
+FileManifest::is_compact() const
+{
+  return m_isCompact;
+}
+
 inline std::shared_ptr<Name>
 FileManifest::submanifest_ptr() const
 {
@@ -335,7 +497,12 @@ FileManifest::set_submanifest_ptr(std::shared_ptr<Name> subManifestPtr)
 inline void
 FileManifest::reserve(size_t capacity)
 {
-  m_catalog.reserve(capacity);
+  if (m_isCompact) {
+    m_compactCatalog.reserve(capacity);
+  }
+  else {
+    m_catalog.reserve(capacity);
+  }
 }
 
 }  // end ntorrent
@@ -28,14 +28,21 @@ void
 InterestQueue::push(shared_ptr<Interest> interest, DataCallback dataReceivedCallback,
      TimeoutCallback dataFailedCallback)
 {
-  m_queue.push(std::make_tuple(interest, dataReceivedCallback, dataFailedCallback));
+  m_queue.push_back(std::make_tuple(interest, dataReceivedCallback, dataFailedCallback));
+}
+
+void
+InterestQueue::pushFront(shared_ptr<Interest> interest, DataCallback dataReceivedCallback,
+                         TimeoutCallback dataFailedCallback)
+{
+  m_queue.push_front(std::make_tuple(interest, dataReceivedCallback, dataFailedCallback));
 }
 
 queueTuple
 InterestQueue::pop()
 {
   queueTuple tup = m_queue.front();
-  m_queue.pop();
+  m_queue.pop_front();
   return tup;
 }
 
@@ -23,7 +23,7 @@
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/interest.hpp>
 
-#include <queue>
+#include <deque>
 #include <tuple>
 
 typedef std::tuple<std::shared_ptr<ndn::Interest>, ndn::DataCallback, ndn::TimeoutCallback> queueTuple;
@@ -51,6 +51,19 @@ public:
   push(shared_ptr<Interest> interest, DataCallback dataReceivedCallback,
        TimeoutCallback dataFailedCallback);
 
+  /**
+   * @brief Push a tuple to the front of the Interest Queue, to be popped before the others
+   * @param interest A shared pointer to an Interest
+   * @param dataReceivedCallback Callback to be called when data is received for the given
+   *                             Interest
+   * @param dataFailedCallback Callback to be called when we fail to retrieve data for the
+   *                           given Interest
+   *
+   */
+  void
+  pushFront(shared_ptr<Interest> interest, DataCallback dataReceivedCallback,
+            TimeoutCallback dataFailedCallback);
+
   /**
    * @brief Pop a tuple from the Interest Queue
    * @return A tuple of a shared pointer to an Interest, a callaback for successful data
@@ -81,7 +94,7 @@ public:
    front() const;
 
 private:
-  std::queue<queueTuple> m_queue;
+  std::deque<queueTuple> m_queue;
 };
 
 inline size_t
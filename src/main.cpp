@@ -18,13 +18,17 @@
  *
  * See AUTHORS.md for complete list of nTorrent authors and contributors.
  */
+#include "file-manifest.hpp"
+#include "manifest-tree-node.hpp"
 #include "sequential-data-fetcher.hpp"
 #include "torrent-file.hpp"
 #include "util/io-util.hpp"
 #include "util/logging.hpp"
+#include "util/metadata-store.hpp"
 
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <stdexcept>
 #include <algorithm>
 #include <unordered_map>
@@ -66,9 +70,12 @@ int main(int argc, char *argv[])
     desc.add_options()
     // TODO(msweatt) Consider  adding  flagged args for other parameters
       ("help,h", "produce help message")
-      ("generate,g" , "-g <data directory> <output-path>? <names-per-segment>? <names-per-manifest-segment>? <data-packet-size>?")
+      ("generate,g" , "-g <data directory> <output-path>? <names-per-segment>? <names-per-manifest-segment>? <data-packet-size>? <manifest-tree-fanout>?")
+      ("binary,b", "With -g, write the metadata to the binary metadata store instead of the torrent_files and manifests directories.")
+      ("force,f", "With -g -b, replace an existing binary metadata store.")
       ("seed,s", "After download completes, continue to seed")
       ("dump,d", "-d <file> Dump the contents of the Data stored at the <file>.")
+      ("migrate,m", "-m <torrent metadata directory> Copy the torrent_files and manifests of the directory into its binary metadata store.")
       ("log-level", po::value<std::string>(), "trace | debug | info | warming | error | fatal")
       ("args", po::value<std::vector<std::string> >(), "For arguments you want to specify without flags")
     ;
@@ -109,41 +116,105 @@ int main(int argc, char *argv[])
       auto args = vm["args"].as<std::vector<std::string>>();
       // if generate mode
       if (vm.count("generate")) {
-        if (args.size() < 1 || args.size() > 5) {
+        if (args.size() < 1 || args.size() > 6) {
           throw ndn::Error("wrong number of arguments for generate");
         }
         auto dataPath         = args[0];
         auto outputPath       = args.size() >= 2 ? args[1] : ".appdata/";
         auto namesPerSegment  = args.size() >= 3 ? boost::lexical_cast<size_t>(args[2]) : 1024;
         auto namesPerManifest = args.size() >= 4 ? boost::lexical_cast<size_t>(args[3]) : 1024;
-        auto dataPacketSize   = args.size() == 5 ? boost::lexical_cast<size_t>(args[4]) : 1024;
-
-        const auto& content = TorrentFile::generate(dataPath,
-                                                    namesPerSegment,
-                                                    namesPerManifest,
-                                                    dataPacketSize);
-        const auto& torrentSegments = content.first;
-        std::vector<FileManifest> manifests;
-        for (const auto& ms : content.second) {
-          manifests.insert(manifests.end(), ms.first.begin(), ms.first.end());
+        auto dataPacketSize   = args.size() >= 5 ? boost::lexical_cast<size_t>(args[4]) : 1024;
+        // the sub-manifests of each file are chained, unless a fanout for their tree is given
+        auto treeFanout       = args.size() == 6 ? boost::lexical_cast<size_t>(args[5]) : 0;
+        if (1 == treeFanout) {
+          throw ndn::Error("the manifest tree fanout must be 0 or at least 2");
         }
+
         auto torrentPrefix = fs::canonical(dataPath).filename().string();
         outputPath += ("/" + torrentPrefix);
-        auto torrentPath =  outputPath + "/torrent_files/";
-        // write all the torrent segments
-        for (const TorrentFile& t : torrentSegments) {
-          if (!IoUtil::writeTorrentSegment(t, torrentPath)) {
-            LOG_ERROR << "Write failed: " << t.getName() << std::endl;
+        // write each manifest and torrent segment as soon as it is signed, instead of holding the
+        // metadata of the whole directory in memory, to the torrent_files and manifests
+        // directories unless the binary metadata store is asked for
+        std::unique_ptr<MetadataStore> store;
+        if (vm.count("binary")) {
+          auto storePath = MetadataStore::pathFor(outputPath);
+          if (fs::exists(storePath)) {
+            if (!vm.count("force")) {
+              throw ndn::Error(storePath + " already exists, use --force to replace it");
+            }
+            fs::remove(storePath);
+          }
+          try {
+            store.reset(new MetadataStore(storePath));
+          }
+          catch (const MetadataStore::Error& e) {
+            LOG_ERROR << "Write failed: " << e.what() << std::endl;
             return -1;
           }
         }
+        auto torrentPath = outputPath + "/torrent_files/";
         auto manifestPath = outputPath + "/manifests/";
-        for (const FileManifest& m : manifests) {
-          if (!IoUtil::writeFileManifest(m, manifestPath)) {
-            LOG_ERROR << "Write failed: " << m.getName() << std::endl;
-            return -1;
+        // the torrent-file segments come last, from the last one to the initial one
+        Name initialSegmentName;
+        bool writeFailed = false;
+        auto writeSegment = [&] (const Data& segment) {
+          auto type = IoUtil::findType(segment.getFullName());
+          if (IoUtil::TORRENT_FILE == type) {
+            initialSegmentName = segment.getFullName();
+          }
+          if (nullptr != store) {
+            store->append(segment);
+            return true;
+          }
+          switch (type) {
+            case IoUtil::TORRENT_FILE:
+              return IoUtil::writeTorrentSegment(TorrentFile(segment.wireEncode()), torrentPath);
+            case IoUtil::FILE_MANIFEST:
+              return IoUtil::writeFileManifest(FileManifest(segment.wireEncode()), manifestPath);
+            case IoUtil::MANIFEST_TREE_NODE:
+              return IoUtil::writeManifestTreeNode(ManifestTreeNode(segment.wireEncode()),
+                                                   manifestPath);
+            default:
+              return false;
           }
+        };
+        try {
+          TorrentFile::generateStreaming(dataPath,
+                                         namesPerSegment,
+                                         namesPerManifest,
+                                         dataPacketSize,
+                                         [&writeSegment, &writeFailed] (const Data& segment) {
+                                           // the remaining segments are still generated, but
+                                           // no longer written
+                                           if (!writeFailed && !writeSegment(segment)) {
+                                             LOG_ERROR << "Write failed: " << segment.getName()
+                                                       << std::endl;
+                                             writeFailed = true;
+                                           }
+                                         },
+                                         treeFanout);
+          if (nullptr != store) {
+            store->flush();
+          }
+        }
+        catch (const MetadataStore::Error& e) {
+          LOG_ERROR << "Write failed: " << e.what() << std::endl;
+          return -1;
+        }
+        if (writeFailed) {
+          return -1;
+        }
+        // the name to start the download of the torrent from
+        std::cout << initialSegmentName << std::endl;
+      }
+      // if migrate mode
+      else if (vm.count("migrate")) {
+        if (args.size() != 1) {
+          throw ndn::Error("wrong number of arguments for migrate");
         }
+        auto torrentPath = args[0];
+        auto count = MetadataStore::migrate(torrentPath, MetadataStore::pathFor(torrentPath));
+        std::cout << "Migrated " << count << " segments" << std::endl;
       }
       // if dump mode
       else if(vm.count("dump")) {
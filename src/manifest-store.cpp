@@ -0,0 +1,277 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "manifest-store.hpp"
+
+#include "manifest-tree-node.hpp"
+#include "util/io-util.hpp"
+#include "util/metadata-store.hpp"
+#include "util/shared-constants.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+#include <boost/filesystem.hpp>
+
+#include <ndn-cxx/encoding/buffer-stream.hpp>
+#include <ndn-cxx/encoding/tlv.hpp>
+#include <ndn-cxx/security/transform/base64-decode.hpp>
+#include <ndn-cxx/security/transform/buffer-source.hpp>
+#include <ndn-cxx/security/transform/hex-decode.hpp>
+#include <ndn-cxx/security/transform/stream-sink.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace ndn {
+namespace ntorrent {
+
+// Return the name of the Data packet at the head of the specified wire encoding, or an empty name
+// if the head does not hold the whole name of a Data packet
+static Name
+decodeDataName(const uint8_t* begin, const uint8_t* end)
+{
+  const uint8_t* pos = begin;
+  uint32_t type = 0;
+  uint64_t length = 0;
+  if (!tlv::readType(pos, end, type) || tlv::Data != type ||
+      !tlv::readVarNumber(pos, end, length)) {
+    return Name();
+  }
+  const uint8_t* nameBegin = pos;
+  if (!tlv::readType(pos, end, type) || tlv::Name != type ||
+      !tlv::readVarNumber(pos, end, length) ||
+      static_cast<uint64_t>(end - pos) < length) {
+    return Name();
+  }
+  try {
+    return Name(Block(nameBegin, pos + length - nameBegin));
+  }
+  catch (const tlv::Error&) {
+    return Name();
+  }
+}
+
+// Return the name of the Data packet stored in the specified file, decoding no more of the file
+// than its head, or an empty name if it is not a Data packet
+static Name
+readDataName(const std::string& path, io::IoEncoding encoding)
+{
+  namespace tr = security::transform;
+  std::ifstream is(path, std::ios::binary);
+  std::string head;
+  // the name comes first in the packet, read a larger head only if it does not hold all of it
+  size_t headSize = 2048;
+  do {
+    std::string chunk(headSize - head.size(), '\0');
+    is.read(&chunk[0], chunk.size());
+    head.append(chunk, 0, is.gcount());
+    headSize *= 2;
+
+    if (io::NO_ENCODING == encoding) {
+      auto bytes = reinterpret_cast<const uint8_t*>(head.data());
+      auto name = decodeDataName(bytes, bytes + head.size());
+      if (!name.empty()) {
+        return name;
+      }
+      continue;
+    }
+    // decode only the whole groups of characters read so far
+    std::string text;
+    std::remove_copy_if(head.begin(), head.end(), std::back_inserter(text),
+                        [] (char c) { return std::isspace(static_cast<unsigned char>(c)); });
+    text.resize(text.size() - text.size() % (io::BASE64 == encoding ? 4 : 2));
+    OBufferStream os;
+    try {
+      if (io::BASE64 == encoding) {
+        tr::bufferSource(text) >> tr::base64Decode(false) >> tr::streamSink(os);
+      }
+      else {
+        tr::bufferSource(text) >> tr::hexDecode() >> tr::streamSink(os);
+      }
+    }
+    catch (const tr::Error&) {
+      return Name();
+    }
+    auto buffer = os.buf();
+    auto name = decodeDataName(buffer->buf(), buffer->buf() + buffer->size());
+    if (!name.empty()) {
+      return name;
+    }
+  } while (is);
+  return Name();
+}
+
+ManifestStore::Key
+ManifestStore::makeKey(const Name& manifestName)
+{
+  // .../<file_name>/<sub-manifest number>[/<implicit digest>]
+  Name name = manifestName;
+  if (!name.empty() && name.get(-1).isImplicitSha256Digest()) {
+    name = name.getPrefix(-1);
+  }
+  Name scheme(SharedConstants::commonPrefix);
+  if (name.size() < 2 + scheme.size() || !name.get(-1).isSequenceNumber()) {
+    // not the name of a manifest segment, use a key that no segment can have
+    return std::make_pair(manifestName.toUri(), 0);
+  }
+  // same convention as FileManifest::file_name()
+  return std::make_pair(name.getSubName(1 + scheme.size(),
+                                        name.size() - (2 + scheme.size())).toUri(),
+                        name.get(-1).toSequenceNumber());
+}
+
+void
+ManifestStore::indexDirectory(const std::string& dirPath, ndn::io::IoEncoding encoding)
+{
+  if (!fs::exists(dirPath)) {
+    return;
+  }
+  std::set<std::string> fileNames;
+  for (fs::recursive_directory_iterator it(dirPath);
+       it != fs::recursive_directory_iterator();
+       ++it)
+  {
+    if (fs::is_regular_file(it->status())
+        && it->path().extension() != IoUtil::TEMP_FILE_EXTENSION) {
+      fileNames.insert(it->path().string());
+    }
+  }
+  for (const auto& f : fileNames) {
+    // decode only the name of the segment, at the head of the file
+    auto name = readDataName(f, encoding);
+    if (name.empty() || !name.get(-1).isSequenceNumber()) {
+      continue;
+    }
+    // the nodes of the manifest tree of a file are stored next to its sub-manifests
+    if (ManifestTreeNode::isNodeName(name)) {
+      continue;
+    }
+    insert(makeKey(name), Location{f, 0, encoding});
+  }
+}
+
+void
+ManifestStore::insert(const Key& key,
+                      const Location& location,
+                      std::shared_ptr<const FileManifest> manifest)
+{
+  m_index[key] = location;
+  m_pinned.erase(key);
+  // drop any stale decoded copy
+  auto it = m_cache.find(key);
+  if (m_cache.end() != it) {
+    m_recency.erase(it->second.second);
+    m_cache.erase(it);
+  }
+  if (nullptr != manifest) {
+    touch(key, std::move(manifest));
+  }
+}
+
+void
+ManifestStore::insert(const Key& key, std::shared_ptr<const FileManifest> manifest)
+{
+  insert(key, Location{std::string(), 0, ndn::io::NO_ENCODING});
+  m_pinned[key] = std::move(manifest);
+}
+
+bool
+ManifestStore::erase(const Key& key)
+{
+  auto it = m_cache.find(key);
+  if (m_cache.end() != it) {
+    m_recency.erase(it->second.second);
+    m_cache.erase(it);
+  }
+  m_pinned.erase(key);
+  return m_index.erase(key) != 0;
+}
+
+void
+ManifestStore::clear()
+{
+  m_index.clear();
+  m_pinned.clear();
+  m_cache.clear();
+  m_recency.clear();
+}
+
+std::shared_ptr<const FileManifest>
+ManifestStore::get(const Key& key)
+{
+  auto pinned_it = m_pinned.find(key);
+  if (m_pinned.end() != pinned_it) {
+    return pinned_it->second;
+  }
+  auto cache_it = m_cache.find(key);
+  if (m_cache.end() != cache_it) {
+    auto manifest = cache_it->second.first;
+    touch(key, manifest);
+    return manifest;
+  }
+  auto index_it = m_index.find(key);
+  if (m_index.end() == index_it) {
+    return nullptr;
+  }
+  auto manifest = load(index_it->second);
+  if (nullptr != manifest) {
+    touch(key, manifest);
+  }
+  return manifest;
+}
+
+std::shared_ptr<const FileManifest>
+ManifestStore::load(const Location& location) const
+{
+  if (ndn::io::NO_ENCODING != location.encoding) {
+    return ndn::io::load<FileManifest>(location.path, location.encoding);
+  }
+  // a raw block, either alone in its file or among the records of a MetadataStore
+  try {
+    return std::make_shared<FileManifest>(MetadataStore::readBlock(location.path,
+                                                                   location.offset));
+  }
+  catch (const std::exception&) {
+    return nullptr;
+  }
+}
+
+void
+ManifestStore::touch(const Key& key, std::shared_ptr<const FileManifest> manifest)
+{
+  auto it = m_cache.find(key);
+  if (m_cache.end() != it) {
+    m_recency.erase(it->second.second);
+  }
+  m_recency.push_front(key);
+  m_cache[key] = std::make_pair(manifest, m_recency.begin());
+  // evict the least recently used segments
+  while (m_cache.size() > m_cacheCapacity && !m_recency.empty()) {
+    m_cache.erase(m_recency.back());
+    m_recency.pop_back();
+  }
+}
+
+} // namespace ntorrent
+} // namespace ndn
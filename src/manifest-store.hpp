@@ -0,0 +1,222 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef INCLUDED_MANIFEST_STORE_HPP
+#define INCLUDED_MANIFEST_STORE_HPP
+
+#include "file-manifest.hpp"
+
+#include <ndn-cxx/name.hpp>
+#include <ndn-cxx/util/io.hpp>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace ndn {
+namespace ntorrent {
+
+/**
+ * @brief An index of the file manifest segments stored on disk, decoded on demand
+ *
+ * The store keeps in memory only the location of each manifest segment, keyed by the file name
+ * and sub-manifest number of the segment. A FileManifest is read and decoded from disk the first
+ * time it is requested and is kept in a bounded, least-recently-used cache afterwards.
+ */
+class ManifestStore : noncopyable {
+public:
+  /**
+   * @brief The key of a manifest segment: its file name and its sub-manifest number
+   */
+  typedef std::pair<std::string, size_t> Key;
+
+  /**
+   * @brief The location on disk of the wire encoding of a manifest segment
+   */
+  struct Location {
+    // The path of the file holding the segment
+    std::string         path;
+    // The offset of the segment in the file, only used for raw (NO_ENCODING) files
+    size_t              offset;
+    // The encoding of the file
+    ndn::io::IoEncoding encoding;
+  };
+
+  typedef std::map<Key, Location>::const_iterator const_iterator;
+
+  enum {
+    // Default number of decoded manifests to keep in memory
+    DEFAULT_CACHE_CAPACITY = 1024
+  };
+
+  /**
+   * @brief Create a new empty store
+   * @param cacheCapacity The maximum number of decoded manifests to keep in memory
+   */
+  explicit
+  ManifestStore(size_t cacheCapacity = DEFAULT_CACHE_CAPACITY);
+
+  /**
+   * @brief Return the key of the manifest segment with the specified name
+   * @param manifestName The name, or full name, of a manifest segment
+   */
+  static Key
+  makeKey(const Name& manifestName);
+
+  /**
+   * @brief Index all the manifest segments stored as separate files under @p dirPath
+   *
+   * Only the name at the head of each file is read and decoded, the rest of the segment is
+   * decoded on demand.
+   */
+  void
+  indexDirectory(const std::string& dirPath,
+                 ndn::io::IoEncoding encoding = ndn::io::IoEncoding::BASE64);
+
+  /**
+   * @brief Insert (or replace) the location of the manifest segment with the specified key
+   * @param manifest The decoded segment, if the caller has it, cached as the most recently used
+   */
+  void
+  insert(const Key& key,
+         const Location& location,
+         std::shared_ptr<const FileManifest> manifest = nullptr);
+
+  /**
+   * @brief Insert (or replace) a manifest segment that is not stored on disk
+   *
+   * The segment is kept in memory, out of the cache, until it is erased.
+   */
+  void
+  insert(const Key& key, std::shared_ptr<const FileManifest> manifest);
+
+  /**
+   * @brief Remove the manifest segment with the specified key from the index and the cache
+   * @return True if the segment was indexed, otherwise false
+   */
+  bool
+  erase(const Key& key);
+
+  /**
+   * @brief Remove all the segments from the store
+   */
+  void
+  clear();
+
+  /**
+   * @brief Return the manifest segment with the specified key
+   * @return A pointer to the segment, or nullptr if it is not indexed or cannot be decoded
+   *
+   * Loads the segment from disk unless it is already cached.
+   */
+  std::shared_ptr<const FileManifest>
+  get(const Key& key);
+
+  /**
+   * @brief Return whether the segment with the specified key is indexed
+   */
+  bool
+  contains(const Key& key) const;
+
+  /**
+   * @brief Return the number of indexed segments
+   */
+  size_t
+  size() const;
+
+  /**
+   * @brief Return the number of decoded segments currently in memory
+   */
+  size_t
+  cacheSize() const;
+
+  /**
+   * @brief Iterators over the index, in ascending (file name, sub-manifest number) order
+   */
+  const_iterator
+  begin() const;
+
+  const_iterator
+  end() const;
+
+private:
+  std::shared_ptr<const FileManifest>
+  load(const Location& location) const;
+
+  void
+  touch(const Key& key, std::shared_ptr<const FileManifest> manifest);
+
+private:
+  typedef std::pair<std::shared_ptr<const FileManifest>, std::list<Key>::iterator> CacheEntry;
+
+  // The location of every manifest segment in the store
+  std::map<Key, Location> m_index;
+  // The segments that are only kept in memory
+  std::map<Key, std::shared_ptr<const FileManifest>> m_pinned;
+  // The decoded segments, along with their position in the recency list
+  std::map<Key, CacheEntry> m_cache;
+  // The keys of the decoded segments, most recently used first
+  std::list<Key> m_recency;
+  size_t m_cacheCapacity;
+};
+
+inline
+ManifestStore::ManifestStore(size_t cacheCapacity)
+  : m_cacheCapacity(cacheCapacity)
+{
+}
+
+inline bool
+ManifestStore::contains(const Key& key) const
+{
+  return m_index.count(key) != 0;
+}
+
+inline size_t
+ManifestStore::size() const
+{
+  return m_index.size();
+}
+
+inline size_t
+ManifestStore::cacheSize() const
+{
+  return m_cache.size();
+}
+
+inline ManifestStore::const_iterator
+ManifestStore::begin() const
+{
+  return m_index.begin();
+}
+
+inline ManifestStore::const_iterator
+ManifestStore::end() const
+{
+  return m_index.end();
+}
+
+} // namespace ntorrent
+} // namespace ndn
+
+#endif // INCLUDED_MANIFEST_STORE_HPP
@@ -0,0 +1,267 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "manifest-tree-node.hpp"
+
+#include "compact-catalog.hpp"
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/encoding/encoding-buffer.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+namespace ndn {
+
+namespace ntorrent {
+
+BOOST_CONCEPT_ASSERT((WireEncodable<ManifestTreeNode>));
+BOOST_CONCEPT_ASSERT((WireDecodable<ManifestTreeNode>));
+static_assert(std::is_base_of<Data::Error, ManifestTreeNode::Error>::value,
+                "ManifestTreeNode::Error should inherit from Data::Error");
+
+static const size_t DIGEST_SIZE = CompactCatalog::DIGEST_SIZE;
+
+static const char NAME_MARKER_VALUE[] = "\0manifest-tree";
+
+const name::Component ManifestTreeNode::NAME_MARKER(
+  reinterpret_cast<const uint8_t*>(NAME_MARKER_VALUE), sizeof(NAME_MARKER_VALUE) - 1);
+
+const char* ManifestTreeNode::DIRECTORY_NAME = "manifest-tree";
+
+ManifestTreeNode::ManifestTreeNode()
+  : m_fanout(0)
+  , m_leafCount(0)
+{
+}
+
+ManifestTreeNode::ManifestTreeNode(const Name& filePrefix,
+                                   size_t level,
+                                   size_t index,
+                                   size_t fanout,
+                                   size_t leafCount)
+  : Data(makeName(filePrefix, level, index))
+  , m_fanout(fanout)
+  , m_leafCount(leafCount)
+{
+  BOOST_ASSERT(0 < level);
+  BOOST_ASSERT(1 < fanout);
+}
+
+ManifestTreeNode::ManifestTreeNode(const Block& block)
+  : m_fanout(0)
+  , m_leafCount(0)
+{
+  this->wireDecode(block);
+}
+
+Name
+ManifestTreeNode::makeName(const Name& filePrefix, size_t level, size_t index)
+{
+  Name name = filePrefix;
+  name.append(NAME_MARKER).appendSequenceNumber(level).appendSequenceNumber(index);
+  return name;
+}
+
+bool
+ManifestTreeNode::isNodeName(const Name& name)
+{
+  return name.size() >= 3 && NAME_MARKER == name.get(-3)
+      && name.get(-2).isSequenceNumber() && name.get(-1).isSequenceNumber()
+      && 0 != name.get(-2).toSequenceNumber();
+}
+
+size_t
+ManifestTreeNode::getHeight(size_t leafCount, size_t fanout)
+{
+  // there is always a root, even above a single sub-manifest
+  size_t height = 1;
+  for (size_t width = fanout; width < leafCount; width *= fanout) {
+    ++height;
+  }
+  return height;
+}
+
+size_t
+ManifestTreeNode::childCount() const
+{
+  return m_digests.size() / DIGEST_SIZE;
+}
+
+Name
+ManifestTreeNode::getChildPrefix(size_t i) const
+{
+  size_t childIndex = getIndex() * m_fanout + i;
+  if (1 == getLevel()) {
+    return Name(getFilePrefix()).appendSequenceNumber(childIndex);
+  }
+  return makeName(getFilePrefix(), getLevel() - 1, childIndex);
+}
+
+Name
+ManifestTreeNode::getChildName(size_t i) const
+{
+  BOOST_ASSERT(i < childCount());
+  return getChildPrefix(i).appendImplicitSha256Digest(&m_digests[i * DIGEST_SIZE], DIGEST_SIZE);
+}
+
+void
+ManifestTreeNode::insert(const Name& childFullName)
+{
+  size_t i = childCount();
+  if (i == m_fanout) {
+    BOOST_THROW_EXCEPTION(Error("A manifest tree node has at most " + to_string(m_fanout) +
+                                " children"));
+  }
+  if (childFullName.empty() || !childFullName.get(-1).isImplicitSha256Digest()
+      || childFullName.getPrefix(-1) != getChildPrefix(i)) {
+    BOOST_THROW_EXCEPTION(Error(childFullName.toUri() + " is not the next child of " +
+                                getName().toUri()));
+  }
+  const auto& digest = childFullName.get(-1);
+  m_digests.insert(m_digests.end(), digest.value_begin(), digest.value_end());
+}
+
+bool
+ManifestTreeNode::verifyChild(const Data& child) const
+{
+  const Name& childName = child.getName();
+  if (childName.empty() || !childName.get(-1).isSequenceNumber()) {
+    return false;
+  }
+  size_t firstChild = getIndex() * m_fanout;
+  size_t childIndex = childName.get(-1).toSequenceNumber();
+  if (childIndex < firstChild || childIndex - firstChild >= childCount()) {
+    return false;
+  }
+  size_t i = childIndex - firstChild;
+  if (childName != getChildPrefix(i)) {
+    return false;
+  }
+  const auto& digest = child.getFullName().get(-1);
+  return std::equal(digest.value_begin(), digest.value_end(), &m_digests[i * DIGEST_SIZE]);
+}
+
+template<encoding::Tag TAG>
+size_t
+ManifestTreeNode::encodeContent(EncodingImpl<TAG>& encoder) const
+{
+  // ManifestTreeNodeContent ::= CONTENT-TYPE TLV-LENGTH
+  //                           Fanout
+  //                           LeafCount
+  //                           ChildDigest+
+
+  // Fanout ::= FANOUT-TYPE TLV-LENGTH
+  //          nonNegativeInteger
+
+  // LeafCount ::= LEAF-COUNT-TYPE TLV-LENGTH
+  //             nonNegativeInteger
+
+  // ChildDigest ::= IMPLICIT-SHA256-DIGEST-COMPONENT-TYPE TLV-LENGTH(=32)
+  //               BYTE+
+
+  size_t totalLength = 0;
+  for (size_t i = childCount(); i > 0; --i) {
+    totalLength += encoder.prependByteArrayBlock(tlv::ImplicitSha256DigestComponent,
+                                                 &m_digests[(i - 1) * DIGEST_SIZE],
+                                                 DIGEST_SIZE);
+  }
+  totalLength += prependNonNegativeIntegerBlock(encoder, LEAF_COUNT_TYPE, m_leafCount);
+  totalLength += prependNonNegativeIntegerBlock(encoder, FANOUT_TYPE, m_fanout);
+  totalLength += encoder.prependVarNumber(totalLength);
+  totalLength += encoder.prependVarNumber(tlv::Content);
+  return totalLength;
+}
+
+void
+ManifestTreeNode::encodeContent()
+{
+  onChanged();
+
+  EncodingEstimator estimator;
+  size_t estimatedSize = encodeContent(estimator);
+
+  EncodingBuffer buffer(estimatedSize, 0);
+  encodeContent(buffer);
+
+  setContentType(tlv::ContentType_Blob);
+  setContent(buffer.block());
+}
+
+void
+ManifestTreeNode::decodeContent()
+{
+  if (getContentType() != tlv::ContentType_Blob) {
+    BOOST_THROW_EXCEPTION(Error("Expected Content Type Blob"));
+  }
+  const Name& name = getName();
+  if (!isNodeName(name)) {
+    BOOST_THROW_EXCEPTION(Error(name.toUri() + " is not the name of a manifest tree node"));
+  }
+
+  const Block& content = Data::getContent();
+  content.parse();
+  auto element = content.elements_begin();
+  if (content.elements_end() == element || FANOUT_TYPE != element->type()) {
+    BOOST_THROW_EXCEPTION(Error("Manifest tree node without a fanout"));
+  }
+  m_fanout = readNonNegativeInteger(*element);
+  ++element;
+  if (content.elements_end() == element || LEAF_COUNT_TYPE != element->type()) {
+    BOOST_THROW_EXCEPTION(Error("Manifest tree node without a leaf count"));
+  }
+  m_leafCount = readNonNegativeInteger(*element);
+  ++element;
+  if (m_fanout < 2) {
+    BOOST_THROW_EXCEPTION(Error("Manifest tree node with a fanout less than 2"));
+  }
+
+  m_digests.clear();
+  m_digests.reserve(std::distance(element, content.elements_end()) * DIGEST_SIZE);
+  for (; element != content.elements_end(); ++element) {
+    if (tlv::ImplicitSha256DigestComponent != element->type()
+        || DIGEST_SIZE != element->value_size()) {
+      BOOST_THROW_EXCEPTION(Error("Invalid child digest in a manifest tree node"));
+    }
+    m_digests.insert(m_digests.end(), element->value_begin(), element->value_end());
+  }
+  if (m_digests.empty() || childCount() > m_fanout) {
+    BOOST_THROW_EXCEPTION(Error("Manifest tree node with " + to_string(childCount()) +
+                                " children"));
+  }
+}
+
+void
+ManifestTreeNode::wireDecode(const Block& wire)
+{
+  Data::wireDecode(wire);
+  this->decodeContent();
+}
+
+void
+ManifestTreeNode::finalize()
+{
+  this->encodeContent();
+}
+
+} // namespace ntorrent
+
+} // namespace ndn
@@ -0,0 +1,270 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef MANIFEST_TREE_NODE_HPP
+#define MANIFEST_TREE_NODE_HPP
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/name.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace ndn {
+
+namespace ntorrent {
+
+/**
+ * @brief A node of the Merkle tree over the sub-manifests of a file
+ *
+ * In the tree format, the sub-manifests of a file are not chained to each other. They are the
+ * leaves of a tree whose nodes hold the implicit digests of their children:
+ *
+ *   <file prefix>/<seq>                              the sub-manifests (level 0)
+ *   <file prefix>/%00manifest-tree/<level>/<index>   the nodes, from level 1 up to the root
+ *
+ * The children of node <index> at <level> are the nodes (or, at level 1, the sub-manifests)
+ * [index * fanout, (index + 1) * fanout) of the level below. Since the full name of a node is
+ * the digest of its encoding, which holds the digests of its children, the full name of the root
+ * authenticates every sub-manifest of the file. Given the root, any sub-manifest can be verified
+ * through the nodes on its path alone, and all the nodes of a level can be fetched in parallel,
+ * so retrieving the manifests of a file takes a number of round trips logarithmic in the number
+ * of its sub-manifests.
+ */
+class ManifestTreeNode : public Data {
+public:
+  class Error : public Data::Error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : Data::Error(what)
+    {
+    }
+  };
+
+  enum {
+    FANOUT_TYPE     = 140,
+    LEAF_COUNT_TYPE = 141
+  };
+
+  /**
+   * @brief The name component that follows the file prefix in the name of each node
+   *
+   * It starts with a NUL byte, which no file name holds, so that the names of a file, or of a
+   * directory, called "manifest-tree" are never taken for the names of nodes.
+   */
+  static const name::Component NAME_MARKER;
+
+  /**
+   * @brief The directory of the nodes of a file, next to its sub-manifests on disk
+   */
+  static const char* DIRECTORY_NAME;
+
+  /**
+   * @brief Create a new empty ManifestTreeNode
+   */
+  ManifestTreeNode();
+
+  /**
+   * @brief Create a new ManifestTreeNode with no children
+   * @param filePrefix The name of the file, i.e., the name of its sub-manifests without <seq>
+   * @param level The level of the node, 1 for the parents of the sub-manifests
+   * @param index The position of the node in its level
+   * @param fanout The maximum number of children of each node of the tree
+   * @param leafCount The number of sub-manifests of the file
+   */
+  ManifestTreeNode(const Name& filePrefix,
+                   size_t level,
+                   size_t index,
+                   size_t fanout,
+                   size_t leafCount);
+
+  /**
+   * @brief Create a new ManifestTreeNode
+   * @param block The block format of the node
+   */
+  explicit
+  ManifestTreeNode(const Block& block);
+
+  /**
+   * @brief Return the name of node @p index at @p level of the tree of the specified file
+   */
+  static Name
+  makeName(const Name& filePrefix, size_t level, size_t index);
+
+  /**
+   * @brief Return whether @p name, without its implicit digest, is the name of a node:
+   *        <file prefix>/NAME_MARKER/<level>/<index>, with sequence numbers for a level of at
+   *        least 1 and for the index
+   */
+  static bool
+  isNodeName(const Name& name);
+
+  /**
+   * @brief Return the number of levels of nodes of a tree with the specified number of leaves
+   */
+  static size_t
+  getHeight(size_t leafCount, size_t fanout);
+
+  /**
+   * @brief Get the name of the file of this node
+   */
+  Name
+  getFilePrefix() const;
+
+  /**
+   * @brief Get the level of this node, 1 for the parents of the sub-manifests
+   */
+  size_t
+  getLevel() const;
+
+  /**
+   * @brief Get the position of this node in its level
+   */
+  size_t
+  getIndex() const;
+
+  /**
+   * @brief Get the maximum number of children of each node of the tree
+   */
+  size_t
+  getFanout() const;
+
+  /**
+   * @brief Get the number of sub-manifests of the file
+   */
+  size_t
+  getLeafCount() const;
+
+  /**
+   * @brief Return whether this is the root of the tree
+   */
+  bool
+  isRoot() const;
+
+  /**
+   * @brief Get the number of children of this node
+   */
+  size_t
+  childCount() const;
+
+  /**
+   * @brief Get the full name of the child at @p i, which must be less than childCount()
+   */
+  Name
+  getChildName(size_t i) const;
+
+  /**
+   * @brief Append the full name of the next child of this node
+   * @throws Error if @p childFullName is not the full name of the next child
+   */
+  void
+  insert(const Name& childFullName);
+
+  /**
+   * @brief Return whether @p child is one of the children of this node
+   *
+   * The name of @p child has to be the name of a child of this node, and the SHA-256 of its wire
+   * encoding has to match the digest this node holds for that child.
+   */
+  bool
+  verifyChild(const Data& child) const;
+
+  /**
+   * @brief Decode from wire format
+   */
+  void
+  wireDecode(const Block& wire);
+
+  /**
+   * @brief Finalize the node before signing the data packet
+   */
+  void
+  finalize();
+
+protected:
+  template<encoding::Tag TAG>
+  size_t
+  encodeContent(EncodingImpl<TAG>& encoder) const;
+
+  void
+  encodeContent();
+
+  void
+  decodeContent();
+
+private:
+  /**
+   * @brief Return the name (without the implicit digest) of the child at @p i
+   */
+  Name
+  getChildPrefix(size_t i) const;
+
+private:
+  size_t               m_fanout;
+  size_t               m_leafCount;
+  // The implicit digests of the children, DIGEST_SIZE bytes each
+  std::vector<uint8_t> m_digests;
+};
+
+inline size_t
+ManifestTreeNode::getFanout() const
+{
+  return m_fanout;
+}
+
+inline size_t
+ManifestTreeNode::getLeafCount() const
+{
+  return m_leafCount;
+}
+
+inline Name
+ManifestTreeNode::getFilePrefix() const
+{
+  return getName().getPrefix(-3);
+}
+
+inline size_t
+ManifestTreeNode::getLevel() const
+{
+  return getName().get(-2).toSequenceNumber();
+}
+
+inline size_t
+ManifestTreeNode::getIndex() const
+{
+  return getName().get(-1).toSequenceNumber();
+}
+
+inline bool
+ManifestTreeNode::isRoot() const
+{
+  return getHeight(m_leafCount, m_fanout) == getLevel();
+}
+
+} // namespace ntorrent
+
+} // namespace ndn
+
+#endif // MANIFEST_TREE_NODE_HPP
@@ -0,0 +1,254 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "piece-availability.hpp"
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/encoding/encoding-buffer.hpp>
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace ndn {
+
+namespace ntorrent {
+
+const char* PieceAvailability::NAME_MARKER = "AVAILABILITY";
+
+const time::milliseconds PieceAvailability::FRESHNESS_PERIOD = time::seconds(1);
+
+Name
+PieceAvailability::makeName(const Name& manifestFullName)
+{
+  return Name(manifestFullName).append(NAME_MARKER);
+}
+
+bool
+PieceAvailability::isAvailabilityName(const Name& name)
+{
+  return !name.empty() && name.get(-1) == name::Component(NAME_MARKER);
+}
+
+PieceAvailability::Bitfield::Bitfield(const std::vector<bool>& bitmap)
+  : m_size(bitmap.size())
+  , m_count(0)
+{
+  bool value = false;
+  for (size_t i = 0; i < bitmap.size(); value = !value) {
+    size_t end = std::find(bitmap.begin() + i, bitmap.end(), !value) - bitmap.begin();
+    m_runs.push_back(end - i);
+    if (value) {
+      m_count += end - i;
+    }
+    i = end;
+  }
+}
+
+bool
+PieceAvailability::Bitfield::set(size_t index)
+{
+  BOOST_ASSERT(index < m_size);
+  // find the run of the packet, the runs at even positions are the missing packets
+  size_t k = 0;
+  uint64_t start = 0;
+  while (start + m_runs[k] <= index) {
+    start += m_runs[k];
+    ++k;
+  }
+  if (k % 2 == 1) {
+    return false;
+  }
+  // split the missing run around the packet, then merge the held packet with the held runs
+  // next to it, leaving no empty run but the first one
+  uint64_t before = index - start;
+  uint64_t after = m_runs[k] - before - 1;
+  m_runs[k] = before;
+  m_runs.insert(m_runs.begin() + k + 1, {1, after});
+  if (0 == after) {
+    if (k + 3 < m_runs.size()) {
+      m_runs[k + 1] += m_runs[k + 3];
+      m_runs.erase(m_runs.begin() + k + 2, m_runs.begin() + k + 4);
+    }
+    else {
+      m_runs.erase(m_runs.begin() + k + 2);
+    }
+  }
+  if (0 == before && k > 0) {
+    m_runs[k - 1] += m_runs[k + 1];
+    m_runs.erase(m_runs.begin() + k, m_runs.begin() + k + 2);
+  }
+  ++m_count;
+  return true;
+}
+
+Block
+PieceAvailability::Bitfield::encode() const
+{
+  // Content ::= CONTENT-TYPE TLV-LENGTH
+  //             BitCount
+  //             RunLengths
+
+  // BitCount ::= BIT-COUNT-TYPE TLV-LENGTH
+  //              nonNegativeInteger
+
+  // RunLengths ::= RUN-LENGTHS-TYPE TLV-LENGTH
+  //                VAR-NUMBER* (alternating runs of missing and held packets)
+
+  EncodingBuffer encoder;
+  size_t runsLength = 0;
+  for (auto run = m_runs.rbegin(); run != m_runs.rend(); ++run) {
+    runsLength += encoder.prependVarNumber(*run);
+  }
+  runsLength += encoder.prependVarNumber(runsLength);
+  runsLength += encoder.prependVarNumber(RUN_LENGTHS_TYPE);
+
+  size_t totalLength = runsLength;
+  totalLength += prependNonNegativeIntegerBlock(encoder, BIT_COUNT_TYPE, m_size);
+  totalLength += encoder.prependVarNumber(totalLength);
+  totalLength += encoder.prependVarNumber(tlv::Content);
+  return encoder.block();
+}
+
+shared_ptr<Data>
+PieceAvailability::makeData(const Name& manifestFullName, const std::vector<bool>& bitmap)
+{
+  return makeData(manifestFullName, Bitfield(bitmap));
+}
+
+shared_ptr<Data>
+PieceAvailability::makeData(const Name& manifestFullName, const Bitfield& bitfield)
+{
+  auto data = make_shared<Data>(makeName(manifestFullName).appendSequenceNumber(bitfield.count()));
+  data->setContentType(tlv::ContentType_Blob);
+  data->setContent(bitfield.encode());
+  data->setFreshnessPeriod(FRESHNESS_PERIOD);
+  return data;
+}
+
+uint64_t
+PieceAvailability::getVersion(const Name& dataName)
+{
+  return dataName.get(-1).toSequenceNumber();
+}
+
+Block
+PieceAvailability::encode(const std::vector<bool>& bitmap)
+{
+  return Bitfield(bitmap).encode();
+}
+
+std::vector<bool>
+PieceAvailability::decode(const Block& content)
+{
+  content.parse();
+  auto bitCount = content.find(BIT_COUNT_TYPE);
+  auto runLengths = content.find(RUN_LENGTHS_TYPE);
+  if (content.elements_end() == bitCount || content.elements_end() == runLengths) {
+    BOOST_THROW_EXCEPTION(Error("Malformed availability bitfield"));
+  }
+  uint64_t nBits = readNonNegativeInteger(*bitCount);
+  if (nBits > MAX_BIT_COUNT) {
+    BOOST_THROW_EXCEPTION(Error("Availability bitfield of " + std::to_string(nBits) + " bits"));
+  }
+
+  std::vector<bool> bitmap;
+  bitmap.reserve(nBits);
+  bool value = false;
+  auto begin = runLengths->value_begin();
+  auto end = runLengths->value_end();
+  while (begin != end) {
+    uint64_t length = tlv::readVarNumber(begin, end);
+    if (length > nBits - bitmap.size()) {
+      BOOST_THROW_EXCEPTION(Error("Availability runs longer than the bitfield"));
+    }
+    bitmap.insert(bitmap.end(), length, value);
+    value = !value;
+  }
+  if (bitmap.size() != nBits) {
+    BOOST_THROW_EXCEPTION(Error("Availability runs shorter than the bitfield"));
+  }
+  return bitmap;
+}
+
+bool
+PieceAvailability::update(const Name& routablePrefix,
+                          const Name& manifestName,
+                          uint64_t version,
+                          std::vector<bool> bitmap)
+{
+  auto& advertisements = m_advertisements[manifestName];
+  auto it = advertisements.find(routablePrefix);
+  if (advertisements.end() != it) {
+    if (it->second.version > version) {
+      return false;
+    }
+    it->second = Advertisement{version, std::move(bitmap)};
+  }
+  else {
+    advertisements.emplace(routablePrefix, Advertisement{version, std::move(bitmap)});
+  }
+  return true;
+}
+
+bool
+PieceAvailability::has(const Name& routablePrefix, const Name& manifestName, size_t index) const
+{
+  auto manifest = m_advertisements.find(manifestName);
+  if (m_advertisements.end() == manifest) {
+    return false;
+  }
+  auto it = manifest->second.find(routablePrefix);
+  return manifest->second.end() != it &&
+         index < it->second.bitmap.size() && it->second.bitmap[index];
+}
+
+size_t
+PieceAvailability::count(const Name& manifestName, size_t index) const
+{
+  auto manifest = m_advertisements.find(manifestName);
+  if (m_advertisements.end() == manifest) {
+    return 0;
+  }
+  return std::count_if(manifest->second.begin(), manifest->second.end(),
+                       [index] (const std::pair<const Name, Advertisement>& kv) {
+                         return index < kv.second.bitmap.size() && kv.second.bitmap[index];
+                       });
+}
+
+void
+PieceAvailability::erase(const Name& routablePrefix)
+{
+  for (auto manifest = m_advertisements.begin(); manifest != m_advertisements.end();) {
+    manifest->second.erase(routablePrefix);
+    if (manifest->second.empty()) {
+      manifest = m_advertisements.erase(manifest);
+    }
+    else {
+      ++manifest;
+    }
+  }
+}
+
+} // namespace ntorrent
+
+} // namespace ndn
@@ -0,0 +1,256 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef PIECE_AVAILABILITY_HPP
+#define PIECE_AVAILABILITY_HPP
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/name.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ndn {
+
+namespace ntorrent {
+
+/**
+ * @brief The Data packets of each sub-manifest held by the peers behind each routable prefix
+ *
+ * A peer advertises the packets it holds of a sub-manifest as a bitfield, indexed like the
+ * catalog of the sub-manifest, under
+ *
+ *   <full name of the sub-manifest>/AVAILABILITY/<version>
+ *
+ * where the version is the number of packets held. As a peer never drops a packet, the version
+ * only grows, so an advertisement never replaces a newer one of the same peer. The bitfield is
+ * run-length encoded: the lengths of the alternating runs of missing and held packets, starting
+ * with a (possibly empty) run of missing ones, so the bitfield of a sub-manifest that is almost
+ * complete, or almost empty, takes a few bytes whatever its size.
+ *
+ * The advertisements received are kept by sub-manifest name and routable prefix, so that an
+ * Interest for a packet can be sent through a prefix that has it, and the rarity of a packet is
+ * the number of prefixes that have it.
+ */
+class PieceAvailability {
+public:
+  class Error : public tlv::Error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : tlv::Error(what)
+    {
+    }
+  };
+
+  enum {
+    BIT_COUNT_TYPE   = 160,
+    RUN_LENGTHS_TYPE = 161
+  };
+
+  enum {
+    // The largest bitfield accepted, well above the number of packets of any sub-manifest
+    MAX_BIT_COUNT = 1 << 20
+  };
+
+  /**
+   * @brief The run-length encoded bitfield of the packets held of a sub-manifest
+   *
+   * A packet is marked as held by changing the runs around it only, so the advertisement of a
+   * sub-manifest being downloaded is kept up to date without going through its whole bitmap.
+   */
+  class Bitfield {
+  public:
+    /**
+     * @brief Create the bitfield of @p bitmap
+     */
+    explicit
+    Bitfield(const std::vector<bool>& bitmap);
+
+    /**
+     * @brief Mark the packet @p index as held
+     * @return 'false' if the packet was already held
+     *
+     * Behavior is undefined unless @p index is less than size().
+     */
+    bool
+    set(size_t index);
+
+    /**
+     * @brief Return the number of packets of the bitfield
+     */
+    size_t
+    size() const;
+
+    /**
+     * @brief Return the number of packets held
+     */
+    size_t
+    count() const;
+
+    /**
+     * @brief Encode the bitfield as a Content block
+     */
+    Block
+    encode() const;
+
+  private:
+    size_t m_size;
+    size_t m_count;
+    // the lengths of the alternating runs of missing and held packets, starting with a
+    // (possibly empty) run of missing ones and ending with a non-empty run
+    std::vector<uint64_t> m_runs;
+  };
+
+  /**
+   * @brief The name component that follows the full name of a sub-manifest in the name of its
+   *        advertisements
+   */
+  static const char* NAME_MARKER;
+
+  /**
+   * @brief The freshness period of an advertisement, after which it has to be fetched again
+   */
+  static const time::milliseconds FRESHNESS_PERIOD;
+
+  /**
+   * @brief Return the name under which the advertisements of a sub-manifest are served
+   * @param manifestFullName The full name of the sub-manifest
+   */
+  static Name
+  makeName(const Name& manifestFullName);
+
+  /**
+   * @brief Return 'true' if @p name is the name of the advertisements of a sub-manifest,
+   *        without a version
+   */
+  static bool
+  isAvailabilityName(const Name& name);
+
+  /**
+   * @brief Create the (unsigned) advertisement of the packets in @p bitmap
+   * @param manifestFullName The full name of the sub-manifest
+   * @param bitmap Whether each packet of the catalog of the sub-manifest is held
+   */
+  static shared_ptr<Data>
+  makeData(const Name& manifestFullName, const std::vector<bool>& bitmap);
+
+  /**
+   * @brief Create the (unsigned) advertisement of the packets in @p bitfield
+   */
+  static shared_ptr<Data>
+  makeData(const Name& manifestFullName, const Bitfield& bitfield);
+
+  /**
+   * @brief Return the version of the advertisement with the specified name
+   */
+  static uint64_t
+  getVersion(const Name& dataName);
+
+  /**
+   * @brief Encode @p bitmap as a Content block
+   */
+  static Block
+  encode(const std::vector<bool>& bitmap);
+
+  /**
+   * @brief Decode the bitmap of a Content block
+   * @throws Error if the block is malformed, or its bitfield is larger than MAX_BIT_COUNT
+   */
+  static std::vector<bool>
+  decode(const Block& content);
+
+  /**
+   * @brief Keep the bitmap advertised for a sub-manifest through a routable prefix
+   * @param routablePrefix The prefix the advertisement was retrieved through
+   * @param manifestName The name of the sub-manifest (without the implicit digest)
+   * @param version The version of the advertisement
+   * @param bitmap The advertised bitmap
+   * @return 'false' if a newer advertisement is kept for the same prefix and sub-manifest
+   */
+  bool
+  update(const Name& routablePrefix,
+         const Name& manifestName,
+         uint64_t version,
+         std::vector<bool> bitmap);
+
+  /**
+   * @brief Return 'true' if the packet @p index of the specified sub-manifest was advertised
+   *        through @p routablePrefix
+   */
+  bool
+  has(const Name& routablePrefix, const Name& manifestName, size_t index) const;
+
+  /**
+   * @brief Return the number of prefixes through which the packet @p index of the specified
+   *        sub-manifest was advertised
+   */
+  size_t
+  count(const Name& manifestName, size_t index) const;
+
+  /**
+   * @brief Forget the advertisements retrieved through @p routablePrefix
+   */
+  void
+  erase(const Name& routablePrefix);
+
+  /**
+   * @brief Return 'true' if no advertisement is kept
+   */
+  bool
+  empty() const;
+
+private:
+  struct Advertisement {
+    uint64_t version;
+    std::vector<bool> bitmap;
+  };
+
+  // The advertisements of each sub-manifest by routable prefix
+  std::unordered_map<Name, std::unordered_map<Name, Advertisement>> m_advertisements;
+};
+
+inline size_t
+PieceAvailability::Bitfield::size() const
+{
+  return m_size;
+}
+
+inline size_t
+PieceAvailability::Bitfield::count() const
+{
+  return m_count;
+}
+
+inline bool
+PieceAvailability::empty() const
+{
+  return m_advertisements.empty();
+}
+
+} // namespace ntorrent
+
+} // namespace ndn
+
+#endif // PIECE_AVAILABILITY_HPP
@@ -165,7 +165,7 @@ SequentialDataFetcher::onDataRetrievalFailure(const ndn::Interest& interest,
     LOG_ERROR << "Torrent File Segment Downloading Failed: " << interest.getName();
     this->downloadTorrentFile();
   }
-  else if (nameType == IoUtil::FILE_MANIFEST) {
+  else if (nameType == IoUtil::FILE_MANIFEST || nameType == IoUtil::MANIFEST_TREE_NODE) {
     LOG_ERROR << "Manifest File Segment Downloading Failed: " << interest.getName();
     this->downloadManifestFiles({ interest.getName() });
   }
@@ -21,16 +21,42 @@
 
 #include "stats-table-record.hpp"
 
-#include <boost/throw_exception.hpp>
+#include <algorithm>
+#include <cmath>
 
 namespace ndn {
 namespace ntorrent {
 
+const time::milliseconds StatsTableRecord::SUCCESS_RATE_TIME_CONSTANT = time::seconds(10);
+const time::milliseconds StatsTableRecord::THROUGHPUT_TIME_CONSTANT = time::seconds(2);
+
+// The factor by which a weight decays over @p elapsed, e^(-elapsed/timeConstant)
+static double
+decayFactor(const time::steady_clock::Duration& elapsed, const time::milliseconds& timeConstant)
+{
+  double tau = time::duration_cast<time::duration<double>>(timeConstant).count();
+  double dt = time::duration_cast<time::duration<double>>(elapsed).count();
+  return std::exp(-std::max(dt, 0.0) / tau);
+}
+
 StatsTableRecord::StatsTableRecord(const Name& recordName)
   : m_recordName(recordName)
   , m_sentInterests(0)
   , m_receivedData(0)
+  , m_pendingInterests(0)
   , m_successRate(0)
+  , m_timeouts(0)
+  , m_nacks(0)
+  , m_hasSuccessSample(false)
+  , m_ewmaSuccessRate(0)
+  , m_successWeight(0)
+  , m_lastSuccessUpdate(time::steady_clock::now())
+  , m_srtt(0)
+  , m_rttVar(0)
+  , m_throughput(0)
+  , m_lastThroughputUpdate(m_lastSuccessUpdate)
+  , m_lastSeen(m_lastSuccessUpdate)
+  , m_advertisedSuccessRate(0)
 {
 }
 
@@ -38,7 +64,20 @@ StatsTableRecord::StatsTableRecord(const StatsTableRecord& record)
   : m_recordName(record.getRecordName())
   , m_sentInterests(record.getRecordSentInterests())
   , m_receivedData(record.getRecordReceivedData())
+  , m_pendingInterests(record.getRecordPendingInterests())
   , m_successRate(record.getRecordSuccessRate())
+  , m_timeouts(record.getRecordTimeouts())
+  , m_nacks(record.getRecordNacks())
+  , m_hasSuccessSample(record.m_hasSuccessSample)
+  , m_ewmaSuccessRate(record.getRecordEwmaSuccessRate())
+  , m_successWeight(record.m_successWeight)
+  , m_lastSuccessUpdate(record.m_lastSuccessUpdate)
+  , m_srtt(record.getRecordSmoothedRtt())
+  , m_rttVar(record.getRecordRttVariance())
+  , m_throughput(record.getRecordThroughput())
+  , m_lastThroughputUpdate(record.m_lastThroughputUpdate)
+  , m_lastSeen(record.getRecordLastSeen())
+  , m_advertisedSuccessRate(record.getRecordAdvertisedSuccessRate())
 {
 }
 
@@ -46,6 +85,7 @@ void
 StatsTableRecord::incrementSentInterests()
 {
   ++m_sentInterests;
+  ++m_pendingInterests;
   m_successRate = m_receivedData / float(m_sentInterests);
 }
 
@@ -53,10 +93,92 @@ void
 StatsTableRecord::incrementReceivedData()
 {
   if (m_sentInterests == 0) {
-    BOOST_THROW_EXCEPTION(Error("Computing success rate while having sent no Interests"));
+    // there is no Interest this data packet can answer
+    return;
   }
   ++m_receivedData;
+  decrementPendingInterests();
   m_successRate = m_receivedData / float(m_sentInterests);
+  addSuccessSample(true);
+  refresh(time::steady_clock::now());
+}
+
+void
+StatsTableRecord::incrementReceivedData(size_t dataSize, const time::nanoseconds& rtt)
+{
+  if (m_sentInterests == 0) {
+    return;
+  }
+  incrementReceivedData();
+  // RFC 6298: RTTVAR <- 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT <- 7/8 SRTT + 1/8 R
+  if (m_srtt == time::nanoseconds::zero()) {
+    m_srtt = rtt;
+    m_rttVar = rtt / 2;
+  }
+  else {
+    auto deviation = m_srtt > rtt ? m_srtt - rtt : rtt - m_srtt;
+    m_rttVar = (3 * m_rttVar + deviation) / 4;
+    m_srtt = (7 * m_srtt + rtt) / 8;
+  }
+  addThroughputSample(dataSize);
+}
+
+void
+StatsTableRecord::incrementTimeouts()
+{
+  ++m_timeouts;
+  decrementPendingInterests();
+  addSuccessSample(false);
+  addThroughputSample(0);
+}
+
+void
+StatsTableRecord::incrementNacks()
+{
+  ++m_nacks;
+  decrementPendingInterests();
+  addSuccessSample(false);
+  addThroughputSample(0);
+}
+
+void
+StatsTableRecord::decrementPendingInterests()
+{
+  if (m_pendingInterests > 0) {
+    --m_pendingInterests;
+  }
+}
+
+void
+StatsTableRecord::addSuccessSample(bool isSuccess)
+{
+  // The outcomes are averaged with weights that decay by e^(-dt/tau), so that the old ones are
+  // forgotten as time passes, however many Interests are sent in the meantime
+  auto now = time::steady_clock::now();
+  double sample = isSuccess ? 1 : 0;
+  double weight = m_successWeight * decayFactor(now - m_lastSuccessUpdate,
+                                                SUCCESS_RATE_TIME_CONSTANT);
+  m_ewmaSuccessRate = (m_ewmaSuccessRate * weight + sample) / (weight + 1);
+  m_successWeight = weight + 1;
+  m_lastSuccessUpdate = now;
+  m_hasSuccessSample = true;
+}
+
+void
+StatsTableRecord::addThroughputSample(size_t dataSize)
+{
+  // Each byte counts 1/tau at its arrival and decays by e^(-dt/tau), so that the sum is the
+  // throughput over the last tau or so, whatever the spacing of the samples
+  auto now = time::steady_clock::now();
+  double tau = time::duration_cast<time::duration<double>>(THROUGHPUT_TIME_CONSTANT).count();
+  m_throughput = getRecordThroughput(now) + dataSize / tau;
+  m_lastThroughputUpdate = now;
+}
+
+double
+StatsTableRecord::getRecordThroughput(const time::steady_clock::TimePoint& now) const
+{
+  return m_throughput * decayFactor(now - m_lastThroughputUpdate, THROUGHPUT_TIME_CONSTANT);
 }
 
 StatsTableRecord&
@@ -65,7 +187,20 @@ StatsTableRecord::operator=(const StatsTableRecord& other)
   m_recordName = other.getRecordName();
   m_sentInterests = other.getRecordSentInterests();
   m_receivedData = other.getRecordReceivedData();
+  m_pendingInterests = other.getRecordPendingInterests();
   m_successRate = other.getRecordSuccessRate();
+  m_timeouts = other.getRecordTimeouts();
+  m_nacks = other.getRecordNacks();
+  m_hasSuccessSample = other.m_hasSuccessSample;
+  m_ewmaSuccessRate = other.getRecordEwmaSuccessRate();
+  m_successWeight = other.m_successWeight;
+  m_lastSuccessUpdate = other.m_lastSuccessUpdate;
+  m_srtt = other.getRecordSmoothedRtt();
+  m_rttVar = other.getRecordRttVariance();
+  m_throughput = other.getRecordThroughput();
+  m_lastThroughputUpdate = other.m_lastThroughputUpdate;
+  m_lastSeen = other.getRecordLastSeen();
+  m_advertisedSuccessRate = other.getRecordAdvertisedSuccessRate();
   return (*this);
 }
 
@@ -20,12 +20,24 @@
 */
 
 #include <ndn-cxx/name.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <algorithm>
 
 namespace ndn {
 namespace ntorrent {
 
 /**
  * @brief Represents a record of the stats table
+ *
+ * Besides the lifetime counters, a record keeps estimates that weigh recent outcomes more than
+ * old ones, so that a prefix that stops performing well loses its rank: a success rate in which
+ * the weight of each outcome decays with time, the smoothed round-trip time and its variance (as
+ * in RFC 6298), and the throughput of the data packets received, also decaying with time.
+ *
+ * A record also keeps when its prefix was last seen alive, either by a data packet received
+ * through it or by a peer advertising it, and the success rate that peer advertised for it,
+ * which stands in for the own estimates until the prefix has been tried.
  */
 class StatsTableRecord {
 public:
@@ -39,6 +51,17 @@ public:
     }
   };
 
+  /**
+   * @brief The time for the weight of the outcome of an Interest in the smoothed success rate to
+   *        decay by 1/e
+   */
+  static const time::milliseconds SUCCESS_RATE_TIME_CONSTANT;
+
+  /**
+   * @brief The time for the contribution of a data packet to the throughput to decay by 1/e
+   */
+  static const time::milliseconds THROUGHPUT_TIME_CONSTANT;
+
   /**
    * @brief Create a new empty record
    */
@@ -76,12 +99,97 @@ public:
   uint64_t
   getRecordReceivedData() const;
 
+  /**
+   * @brief Get the number of Interests sent for a record that are still outstanding
+   */
+  uint64_t
+  getRecordPendingInterests() const;
+
   /**
    * @brief Get the success rate of a record
    */
   double
   getRecordSuccessRate() const;
 
+  /**
+   * @brief Get the success rate of a record, weighing the outcomes of the Interests less as
+   *        time passes since they were known
+   */
+  double
+  getRecordEwmaSuccessRate() const;
+
+  /**
+   * @brief Get the smoothed round-trip time of a record, zero until a round trip is measured
+   */
+  time::nanoseconds
+  getRecordSmoothedRtt() const;
+
+  /**
+   * @brief Get the variance of the round-trip time of a record
+   */
+  time::nanoseconds
+  getRecordRttVariance() const;
+
+  /**
+   * @brief Get the throughput of a record in bytes per second, as of its last update
+   */
+  double
+  getRecordThroughput() const;
+
+  /**
+   * @brief Get the throughput of a record in bytes per second, decayed to @p now
+   */
+  double
+  getRecordThroughput(const time::steady_clock::TimePoint& now) const;
+
+  /**
+   * @brief Get the number of Interests of a record that timed out
+   */
+  uint64_t
+  getRecordTimeouts() const;
+
+  /**
+   * @brief Get the number of Interests of a record that were Nacked
+   */
+  uint64_t
+  getRecordNacks() const;
+
+  /**
+   * @brief Get the last time the prefix of a record was seen alive
+   */
+  const time::steady_clock::TimePoint&
+  getRecordLastSeen() const;
+
+  /**
+   * @brief Get the success rate advertised for a record by the peer it was learned from
+   */
+  double
+  getRecordAdvertisedSuccessRate() const;
+
+  /**
+   * @brief Check whether any Interest sent for a record has been answered or has failed
+   */
+  bool
+  isRecordMeasured() const;
+
+  /**
+   * @brief Set the success rate advertised for a record by a peer
+   */
+  void
+  setRecordAdvertisedSuccessRate(double successRate);
+
+  /**
+   * @brief Set the last time the prefix of a record was seen alive
+   */
+  void
+  setRecordLastSeen(const time::steady_clock::TimePoint& lastSeen);
+
+  /**
+   * @brief Mark the prefix of a record as seen alive at @p lastSeen, unless it was seen later
+   */
+  void
+  refresh(const time::steady_clock::TimePoint& lastSeen);
+
   /**
    * @brief Increment the number of sent interests for a record
    */
@@ -90,21 +198,81 @@ public:
 
   /**
    * @brief Increment the number of received data packets for a record
+   *
+   * The Interest that brought the data packet is no longer outstanding, and the prefix of the
+   * record is seen alive. Does nothing if no Interest has been sent for the record.
    */
   void
   incrementReceivedData();
 
+  /**
+   * @brief Increment the number of received data packets for a record, and update its
+   *        round-trip time and throughput estimates
+   * @param dataSize The size of the data packet in bytes
+   * @param rtt The time from sending the Interest to receiving the data packet
+   *
+   * Does nothing if no Interest has been sent for the record.
+   */
+  void
+  incrementReceivedData(size_t dataSize, const time::nanoseconds& rtt);
+
+  /**
+   * @brief Increment the number of timed out Interests for a record
+   */
+  void
+  incrementTimeouts();
+
+  /**
+   * @brief Increment the number of Nacked Interests for a record
+   */
+  void
+  incrementNacks();
+
+  /**
+   * @brief Decrement the number of outstanding Interests of a record after one of them failed
+   */
+  void
+  decrementPendingInterests();
+
   /**
    * @brief Assignment operator
    */
   StatsTableRecord&
   operator=(const StatsTableRecord& other);
 
+private:
+  /**
+   * @brief Add the outcome of an Interest to the smoothed success rate
+   */
+  void
+  addSuccessSample(bool isSuccess);
+
+  /**
+   * @brief Decay the throughput to now and add @p dataSize bytes to it
+   */
+  void
+  addThroughputSample(size_t dataSize);
+
 private:
   Name m_recordName;
   uint64_t m_sentInterests;
   uint64_t m_receivedData;
+  uint64_t m_pendingInterests;
   double m_successRate;
+  uint64_t m_timeouts;
+  uint64_t m_nacks;
+  // whether the smoothed estimates have a sample
+  bool m_hasSuccessSample;
+  double m_ewmaSuccessRate;
+  // the sum of the decayed weights of the outcomes in the smoothed success rate
+  double m_successWeight;
+  time::steady_clock::TimePoint m_lastSuccessUpdate;
+  time::nanoseconds m_srtt;
+  time::nanoseconds m_rttVar;
+  double m_throughput;
+  time::steady_clock::TimePoint m_lastThroughputUpdate;
+  time::steady_clock::TimePoint m_lastSeen;
+  double m_advertisedSuccessRate;
 };
 
 /**
@@ -137,12 +305,90 @@ StatsTableRecord::getRecordReceivedData() const
   return m_receivedData;
 }
 
+inline uint64_t
+StatsTableRecord::getRecordPendingInterests() const
+{
+  return m_pendingInterests;
+}
+
 inline double
 StatsTableRecord::getRecordSuccessRate() const
 {
   return m_successRate;
 }
 
+inline double
+StatsTableRecord::getRecordEwmaSuccessRate() const
+{
+  return m_ewmaSuccessRate;
+}
+
+inline time::nanoseconds
+StatsTableRecord::getRecordSmoothedRtt() const
+{
+  return m_srtt;
+}
+
+inline time::nanoseconds
+StatsTableRecord::getRecordRttVariance() const
+{
+  return m_rttVar;
+}
+
+inline double
+StatsTableRecord::getRecordThroughput() const
+{
+  return m_throughput;
+}
+
+inline uint64_t
+StatsTableRecord::getRecordTimeouts() const
+{
+  return m_timeouts;
+}
+
+inline uint64_t
+StatsTableRecord::getRecordNacks() const
+{
+  return m_nacks;
+}
+
+inline const time::steady_clock::TimePoint&
+StatsTableRecord::getRecordLastSeen() const
+{
+  return m_lastSeen;
+}
+
+inline double
+StatsTableRecord::getRecordAdvertisedSuccessRate() const
+{
+  return m_advertisedSuccessRate;
+}
+
+inline bool
+StatsTableRecord::isRecordMeasured() const
+{
+  return m_hasSuccessSample;
+}
+
+inline void
+StatsTableRecord::setRecordAdvertisedSuccessRate(double successRate)
+{
+  m_advertisedSuccessRate = successRate;
+}
+
+inline void
+StatsTableRecord::setRecordLastSeen(const time::steady_clock::TimePoint& lastSeen)
+{
+  m_lastSeen = lastSeen;
+}
+
+inline void
+StatsTableRecord::refresh(const time::steady_clock::TimePoint& lastSeen)
+{
+  m_lastSeen = std::max(m_lastSeen, lastSeen);
+}
+
 
 }  // namespace ntorrent
 }  // namespace ndn
@@ -21,52 +21,179 @@
 
 #include "stats-table.hpp"
 
+#include <algorithm>
+#include <iterator>
+
+#include <boost/assert.hpp>
+
 namespace ndn {
 namespace ntorrent {
 
+// The share of the outstanding Interests kept by a record whose recent Interests all failed
+static const double MIN_RECORD_WEIGHT = 0.05;
+
+// The round-trip time assumed for a record until one is measured, the initial RTO of RFC 6298
+static const time::seconds DEFAULT_RTT(1);
+
+// The success rate assumed for a record that has not been tried, unless a peer advertised one
+static const double DEFAULT_SUCCESS_RATE = 1.0;
+
+// The success rate of @p record, the one advertised for it, if any, until it has been tried
+static double
+getSuccessRate(const StatsTableRecord& record)
+{
+  if (record.isRecordMeasured()) {
+    return record.getRecordEwmaSuccessRate();
+  }
+  double advertised = record.getRecordAdvertisedSuccessRate();
+  return advertised > 0 ? advertised : DEFAULT_SUCCESS_RATE;
+}
+
+// The time for the outstanding Interests of @p record, counting the next one, to be answered at
+// the goodput of the record, i.e., its smoothed success rate per smoothed round-trip time
+static double
+getLoad(const StatsTableRecord& record)
+{
+  time::nanoseconds rtt = record.getRecordSmoothedRtt();
+  if (time::nanoseconds::zero() == rtt) {
+    rtt = DEFAULT_RTT;
+  }
+  double seconds = time::duration_cast<time::duration<double>>(rtt).count();
+  double successRate = std::max(getSuccessRate(record), MIN_RECORD_WEIGHT);
+  return (record.getRecordPendingInterests() + 1) * seconds / successRate;
+}
+
+StatsTable::StatsTable()
+  : m_nextSequence(0)
+{
+}
+
 StatsTable::StatsTable(const Name& torrentName)
   : m_torrentName(torrentName)
+  , m_nextSequence(0)
+{
+}
+
+StatsTable::StatsTable(const StatsTable& other)
+  : m_statsTable(other.m_statsTable)
+  , m_torrentName(other.m_torrentName)
+  , m_nextSequence(0)
+{
+  // the ranks of the other table point to its own records
+  rankAll();
+}
+
+StatsTable&
+StatsTable::operator=(const StatsTable& other)
 {
+  if (this != &other) {
+    m_statsTable = other.m_statsTable;
+    m_torrentName = other.m_torrentName;
+    rankAll();
+  }
+  return *this;
 }
 
 void
 StatsTable::insert(const Name& prefix)
 {
+  if (m_index.count(prefix) > 0) {
+    return;
+  }
   m_statsTable.push_back(StatsTableRecord(prefix));
+  rank(std::prev(m_statsTable.end()));
 }
 
-StatsTable::const_iterator
-StatsTable::find(const Name& prefix) const
+void
+StatsTable::rank(iterator record)
+{
+  auto entry = m_ranks.insert(RankEntry{getLoad(*record), m_nextSequence++, record});
+  m_index[record->getRecordName()] = IndexEntry{record, entry.first};
+}
+
+void
+StatsTable::rankAll()
 {
+  m_ranks.clear();
+  m_index.clear();
+  m_index.reserve(m_statsTable.size());
+  m_nextSequence = 0;
   for (auto i = m_statsTable.begin(); i != m_statsTable.end(); ++i) {
-    if (i->getRecordName() == prefix) {
-      return i;
-    }
+    rank(i);
+  }
+}
+
+void
+StatsTable::update(iterator record)
+{
+  auto it = m_index.find(record->getRecordName());
+  BOOST_ASSERT(m_index.end() != it);
+  RankEntry entry = *it->second.rank;
+  double load = getLoad(*record);
+  if (entry.load == load) {
+    return;
   }
-  return StatsTable::end();
+  // the record keeps its sequence number, so it stays ahead of the ties inserted after it
+  m_ranks.erase(it->second.rank);
+  entry.load = load;
+  it->second.rank = m_ranks.insert(entry).first;
+}
+
+StatsTable::const_iterator
+StatsTable::find(const Name& prefix) const
+{
+  auto it = m_index.find(prefix);
+  return m_index.end() == it ? StatsTable::end() : const_iterator(it->second.record);
 }
 
 StatsTable::iterator
 StatsTable::find(const Name& prefix)
 {
-  for (auto i = m_statsTable.begin(); i != m_statsTable.end(); ++i) {
-    if (i->getRecordName() == prefix) {
-      return i;
-    }
-  }
-  return StatsTable::end();
+  auto it = m_index.find(prefix);
+  return m_index.end() == it ? StatsTable::end() : it->second.record;
 }
 
 bool
 StatsTable::erase(const Name& prefix)
 {
-  for (auto i = m_statsTable.begin(); i != m_statsTable.end(); ++i) {
-    if (i->getRecordName() == prefix) {
-        m_statsTable.erase(i);
-        return true;
+  auto it = m_index.find(prefix);
+  if (m_index.end() == it) {
+    return false;
+  }
+  m_ranks.erase(it->second.rank);
+  m_statsTable.erase(it->second.record);
+  m_index.erase(it);
+  return true;
+}
+
+size_t
+StatsTable::eraseStale(const time::steady_clock::TimePoint& cutoff,
+                       const EraseCallback& onErase)
+{
+  size_t nErased = 0;
+  for (auto i = m_statsTable.begin(); i != m_statsTable.end();) {
+    auto record = i++;
+    if (record->getRecordLastSeen() < cutoff && 0 == record->getRecordPendingInterests()) {
+      Name prefix = record->getRecordName();
+      erase(prefix);
+      ++nErased;
+      if (onErase) {
+        onErase(prefix);
+      }
+    }
+  }
+  return nErased;
+}
+
+StatsTable::iterator
+StatsTable::selectRecord(const RecordFilter& filter)
+{
+  for (const auto& entry : m_ranks) {
+    if (!filter || filter(*entry.record)) {
+      return entry.record;
     }
   }
-  return false;
+  return m_statsTable.end();
 }
 
 }  // namespace ntorrent
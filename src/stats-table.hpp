@@ -21,20 +21,36 @@
 
 #include "stats-table-record.hpp"
 
-#include <vector>
+#include <functional>
+#include <list>
+#include <set>
+#include <unordered_map>
+
+#include <boost/iterator/transform_iterator.hpp>
 
 namespace ndn {
 namespace ntorrent {
 
 /**
  * @brief Represents a stats table
+ *
+ * The records are kept in a list, so that an iterator to a record stays valid until the record
+ * is erased, whatever is inserted, erased or sorted in the meantime, and indexed by prefix in a
+ * hash table, so that find, insert and erase do not depend on the size of the table. Alongside
+ * the list, the table keeps the records ranked in the order in which selectRecord() considers
+ * them, the least loaded first, records with the same load in the order they were inserted. A
+ * record is re-ranked in O(log n) by update() after its stats change, so the ranks are never
+ * recomputed all at once and a record is selected without scanning the table.
  */
 class StatsTable {
+private:
+  typedef std::list<StatsTableRecord> RecordList;
+
 public:
   /**
    * @brief Create an empty stats table
    */
-  StatsTable() = default;
+  StatsTable();
 
   /**
    * @brief Create a stats table for a specific torrent
@@ -42,10 +58,21 @@ public:
    */
   StatsTable(const Name& torrentName);
 
+  /**
+   * @brief Copy constructor
+   */
+  StatsTable(const StatsTable& other);
+
   ~StatsTable() = default;
 
   /**
-   * @brief Insert a routable prefix to the stats table
+   * @brief Assignment operator
+   */
+  StatsTable&
+  operator=(const StatsTable& other);
+
+  /**
+   * @brief Insert a routable prefix to the stats table, unless it is already there
    * @param prefix The prefix to be inserted
    */
   void
@@ -59,6 +86,20 @@ public:
   bool
   erase(const Name& prefix);
 
+  typedef std::function<void(const Name& prefix)> EraseCallback;
+
+  /**
+   * @brief Erase the records last seen alive before @p cutoff
+   * @param onErase If set, called with the prefix of each erased record
+   * @return The number of records erased
+   *
+   * The records with outstanding Interests are kept, their outcome decides whether the prefix
+   * is alive.
+   */
+  size_t
+  eraseStale(const time::steady_clock::TimePoint& cutoff,
+             const EraseCallback& onErase = nullptr);
+
   /**
    * @brief Clear the stats table
    */
@@ -71,8 +112,8 @@ public:
   size_t
   size() const;
 
-  typedef std::vector<StatsTableRecord>::const_iterator const_iterator;
-  typedef std::vector<StatsTableRecord>::iterator iterator;
+  typedef RecordList::const_iterator const_iterator;
+  typedef RecordList::iterator iterator;
 
   /**
    * @brief Constant iterator to the beginning of the stats table
@@ -114,12 +155,90 @@ public:
   iterator
   find(const Name& prefix);
 
+  typedef std::function<bool(const StatsTableRecord&)> RecordFilter;
+
+  /**
+   * @brief Select the record through which to send the next Interest
+   * @param filter Optional predicate the selected record has to satisfy, e.g., that the packet
+   *        requested is available through its prefix
+   * @return An iterator to the selected record, or StatsTable::end() if no record satisfies the
+   *         filter
+   *
+   * The outstanding Interests are spread over all the records in proportion to the goodput of
+   * each one, its smoothed success rate over its smoothed round-trip time: the selected record
+   * is the one that would answer its outstanding Interests, counting the next one, the soonest.
+   * Until its round-trip time is measured, a record is assumed to answer in a second, and until
+   * it has been tried, at the success rate advertised for it or at every Interest if none was,
+   * so that a newly learned prefix is tried at once. Records whose recent Interests all failed
+   * keep a small share, so that they are still probed and can recover.
+   *
+   * The records are taken in the order of their ranks, so only the records ranked ahead of the
+   * selected one are passed to @p filter. The ranks follow the stats of a record once update()
+   * is called for it.
+   */
+  iterator
+  selectRecord(const RecordFilter& filter = nullptr);
+
+  /**
+   * @brief Re-rank a record after its stats changed
+   * @param record An iterator to a record of this table
+   *
+   * The stats of a record can be changed through its iterator, but its rank only follows them
+   * once this method is called.
+   */
+  void
+  update(iterator record);
+
+private:
+  struct RankEntry {
+    // the time for the outstanding Interests of the record, counting the next one, to be answered
+    double load;
+    // the order of insertion, which breaks ties between equal loads
+    uint64_t sequence;
+    iterator record;
+  };
+
+  struct RankOrder {
+    bool operator() (const RankEntry& left, const RankEntry& right) const
+    {
+      return left.load < right.load ||
+             (left.load == right.load && left.sequence < right.sequence);
+    }
+  };
+
+  typedef std::set<RankEntry, RankOrder> RankIndex;
+
+  struct RankedRecord {
+    typedef const StatsTableRecord& result_type;
+
+    const StatsTableRecord&
+    operator() (const RankEntry& entry) const
+    {
+      return *entry.record;
+    }
+  };
+
+public:
+  typedef boost::transform_iterator<RankedRecord, RankIndex::const_iterator> rank_iterator;
+
+  /**
+   * @brief Iterator to the record selectRecord() considers first, the least loaded one
+   */
+  rank_iterator
+  rank_begin() const;
+
+  /**
+   * @brief Iterator past the most loaded record
+   */
+  rank_iterator
+  rank_end() const;
+
   /**
    * @brief Comparator used for sorting the records of the stats table
    */
   struct comparator {
     bool operator() (const StatsTableRecord& left, const StatsTableRecord& right) const
-    {return left.getRecordSuccessRate() >= right.getRecordSuccessRate();}
+    {return left.getRecordSuccessRate() > right.getRecordSuccessRate();}
   };
 
   /**
@@ -127,22 +246,47 @@ public:
    * @param comp Optional comparator function to be used for sorting.
    *             The default value is the provided comparator struct
    *
-   * This method has to be called manually by the application to sort the
-   * stats table.
+   * The sort is stable and only changes the order of iteration from begin() to end(): the
+   * iterators to the records stay valid, and the ranks are kept up to date by update().
    */
   void
   sort(std::function<bool(const StatsTableRecord&, const StatsTableRecord&)> comp = comparator());
 
+private:
+  /**
+   * @brief Rank @p record, which is not ranked yet
+   */
+  void
+  rank(iterator record);
+
+  /**
+   * @brief Rank all the records in the order of the list
+   */
+  void
+  rankAll();
+
 private:
   // Set of StatsTableRecords
-  std::vector<StatsTableRecord> m_statsTable;
+  RecordList m_statsTable;
   Name m_torrentName;
+  // The records ranked by ascending load
+  RankIndex m_ranks;
+  struct IndexEntry {
+    iterator record;
+    RankIndex::iterator rank;
+  };
+
+  // The record of each prefix and its entry in m_ranks
+  std::unordered_map<Name, IndexEntry> m_index;
+  uint64_t m_nextSequence;
 };
 
 inline void
 StatsTable::clear()
 {
   m_statsTable.clear();
+  m_ranks.clear();
+  m_index.clear();
 }
 
 inline size_t
@@ -175,10 +319,22 @@ StatsTable::end()
   return m_statsTable.end();
 }
 
+inline StatsTable::rank_iterator
+StatsTable::rank_begin() const
+{
+  return rank_iterator(m_ranks.begin(), RankedRecord());
+}
+
+inline StatsTable::rank_iterator
+StatsTable::rank_end() const
+{
+  return rank_iterator(m_ranks.end(), RankedRecord());
+}
+
 inline void
 StatsTable::sort(std::function<bool(const StatsTableRecord&, const StatsTableRecord&)> comp)
 {
-  std::sort(m_statsTable.begin(), m_statsTable.end(), comp);
+  m_statsTable.sort(comp);
 }
 
 }  // namespace ntorrent
@@ -20,11 +20,12 @@
 */
 
 #include "torrent-file.hpp"
-
-#include <ndn-cxx/security/key-chain.hpp>
-#include <ndn-cxx/security/signing-helpers.hpp>
+#include "util/chain-builder.hpp"
+#include "util/signer.hpp"
 
 #include <algorithm>
+#include <iterator>
+#include <set>
 
 #include <boost/range/adaptors.hpp>
 #include <boost/filesystem.hpp>
@@ -66,14 +67,6 @@ TorrentFile::TorrentFile(const Block& block)
   this->wireDecode(block);
 }
 
-void
-TorrentFile::createSuffixCatalog()
-{
-  for (auto i = m_catalog.begin() ; i != m_catalog.end(); ++i) {
-    m_suffixCatalog.push_back((*i).getSubName(m_commonPrefix.size()));
-  }
-}
-
 shared_ptr<Name>
 TorrentFile::getTorrentFilePtr() const
 {
@@ -83,15 +76,6 @@ TorrentFile::getTorrentFilePtr() const
   return nullptr;
 }
 
-void
-TorrentFile::constructLongNames()
-{
-  for (auto i = m_suffixCatalog.begin(); i != m_suffixCatalog.end(); ++i) {
-      Name commonPrefix = m_commonPrefix;
-      m_catalog.push_back(commonPrefix.append((*i)));
-  }
-}
-
 template<encoding::Tag TAG>
 size_t
 TorrentFile::encodeContent(EncodingImpl<TAG>& encoder) const
@@ -111,9 +95,14 @@ TorrentFile::encodeContent(EncodingImpl<TAG>& encoder) const
   //                  Name
 
   size_t totalLength = 0;
-  for (const auto& name : m_suffixCatalog |  boost::adaptors::reversed) {
+  for (const auto& name : m_catalog | boost::adaptors::reversed) {
+    // encode the components that follow the common prefix in place of a copy of the suffix
     size_t fileManifestSuffixLength = 0;
-    fileManifestSuffixLength += name.wireEncode(encoder);
+    for (size_t i = name.size(); i > m_commonPrefix.size(); --i) {
+      fileManifestSuffixLength += name.get(i - 1).wireEncode(encoder);
+    }
+    fileManifestSuffixLength += encoder.prependVarNumber(fileManifestSuffixLength);
+    fileManifestSuffixLength += encoder.prependVarNumber(tlv::Name);
     totalLength += fileManifestSuffixLength;
   }
   totalLength += m_commonPrefix.wireEncode(encoder);
@@ -200,14 +189,19 @@ TorrentFile::decodeContent()
     m_commonPrefix = name;
   }
   element++;
+  // build the long names straight from the common prefix and the suffix TLVs
+  m_catalog.reserve(std::distance(element, content.elements_end()));
   for (; element != content.elements_end(); ++element) {
     element->parse();
-    Name fileManifestSuffix(*element);
-    if (fileManifestSuffix.empty())
+    if (element->elements().empty())
       BOOST_THROW_EXCEPTION(Error("Empty manifest file name included in the torrent-file"));
-    this->insertToSuffixCatalog(fileManifestSuffix);
+    Name fileManifestName = m_commonPrefix;
+    for (const auto& component : element->elements()) {
+      fileManifestName.append(name::Component(component));
+    }
+    m_catalog.push_back(fileManifestName);
   }
-  if (m_suffixCatalog.size() == 0) {
+  if (m_catalog.empty()) {
     BOOST_THROW_EXCEPTION(Error("Torrent-file with empty catalog of file manifest names"));
   }
 }
@@ -216,18 +210,39 @@ void
 TorrentFile::wireDecode(const Block& wire)
 {
   m_catalog.clear();
-  m_suffixCatalog.clear();
   Data::wireDecode(wire);
   this->decodeContent();
-  this->constructLongNames();
 }
 
 void
 TorrentFile::finalize()
 {
-  this->createSuffixCatalog();
   this->encodeContent();
-  m_suffixCatalog.clear();
+}
+
+// Return the paths of the files of the directory, sorted lexicographically, and set
+// 'commonPrefix' to the common prefix of the names of their manifests
+static std::set<std::string>
+listDirectory(const std::string& directoryPath, Name& commonPrefix)
+{
+  //TODO(spyros) Adapt this support subdirectories in 'directoryPath'
+  fs::path path(directoryPath);
+  if (!fs::exists(path)) {
+    BOOST_THROW_EXCEPTION(TorrentFile::Error(directoryPath + ": no such directory."));
+  }
+
+  Name directoryPathName(directoryPath);
+  fs::recursive_directory_iterator directoryPtr(fs::system_complete(directoryPath).string());
+
+  std::string prefix = std::string(SharedConstants::commonPrefix) + "/NTORRENT";
+  commonPrefix = Name(prefix +
+                      directoryPathName.getSubName(directoryPathName.size() - 1).toUri());
+
+  std::set<std::string> fileNames;
+  for (auto i = directoryPtr; i != fs::recursive_directory_iterator(); ++i) {
+    fileNames.insert(i->path().string());
+  }
+  return fileNames;
 }
 
 std::pair<std::vector<TorrentFile>,
@@ -239,42 +254,26 @@ TorrentFile::generate(const std::string& directoryPath,
                       size_t dataPacketSize,
                       bool returnData)
 {
-  //TODO(spyros) Adapt this support subdirectories in 'directoryPath'
   BOOST_ASSERT(0 < namesPerSegment);
 
   std::vector<TorrentFile> torrentSegments;
 
-  fs::path path(directoryPath);
-  if (!fs::exists(path)) {
-    BOOST_THROW_EXCEPTION(Error(directoryPath + ": no such directory."));
-  }
-
-  Name directoryPathName(directoryPath);
-  fs::recursive_directory_iterator directoryPtr(fs::system_complete(directoryPath).string());
-
-  std::string prefix = std::string(SharedConstants::commonPrefix) + "/NTORRENT";
-  Name commonPrefix(prefix +
-                    directoryPathName.getSubName(directoryPathName.size() - 1).toUri());
+  Name commonPrefix;
+  auto fileNames = listDirectory(directoryPath, commonPrefix);
 
   Name torrentName(commonPrefix.toUri() + "/torrent-file");
   TorrentFile currentTorrentFile(torrentName, commonPrefix, {});
   std::vector<std::pair<std::vector<FileManifest>, std::vector<Data>>> manifestPairs;
-  // sort all the file names lexicographically
-  std::set<std::string> fileNames;
-  for (auto i = directoryPtr; i != fs::recursive_directory_iterator(); ++i) {
-    fileNames.insert(i->path().string());
-  }
+  manifestPairs.reserve(fileNames.size());
   size_t manifestFileCounter = 0u;
   for (const auto& fileName : fileNames) {
-    Name manifestPrefix(prefix +
-                        directoryPathName.getSubName(directoryPathName.size() - 1).toUri());
     std::pair<std::vector<FileManifest>, std::vector<Data>> currentManifestPair =
                                                     FileManifest::generate(fileName,
-                                                    manifestPrefix, subManifestSize,
+                                                    commonPrefix, subManifestSize,
                                                     dataPacketSize, returnData);
 
     if (manifestFileCounter != 0 && 0 == manifestFileCounter % namesPerSegment) {
-      torrentSegments.push_back(currentTorrentFile);
+      torrentSegments.push_back(std::move(currentTorrentFile));
       Name currentTorrentName = torrentName;
       currentTorrentName.appendSequenceNumber(static_cast<int>(manifestFileCounter));
       currentTorrentFile = TorrentFile(currentTorrentName, commonPrefix, {});
@@ -282,26 +281,66 @@ TorrentFile::generate(const std::string& directoryPath,
     currentTorrentFile.insert(currentManifestPair.first[0].getFullName());
     currentManifestPair.first.shrink_to_fit();
     currentManifestPair.second.shrink_to_fit();
-    manifestPairs.push_back(currentManifestPair);
+    manifestPairs.push_back(std::move(currentManifestPair));
     ++manifestFileCounter;
   }
 
   // Sign and append the last torrent-file
-  security::KeyChain keyChain;
+  auto& signer = Signer::getDefault();
   currentTorrentFile.finalize();
-  keyChain.sign(currentTorrentFile, signingWithSha256());
-  torrentSegments.push_back(currentTorrentFile);
+  signer.sign(currentTorrentFile);
+  torrentSegments.push_back(std::move(currentTorrentFile));
 
   for (auto it = torrentSegments.rbegin() + 1; it != torrentSegments.rend(); ++it) {
     auto next = it - 1;
     it->setTorrentFilePtr(next->getFullName());
     it->finalize();
-    keyChain.sign(*it, signingWithSha256());
+    signer.sign(*it);
   }
 
   torrentSegments.shrink_to_fit();
-  manifestPairs.shrink_to_fit();
-  return std::make_pair(torrentSegments, manifestPairs);
+  return std::make_pair(std::move(torrentSegments), std::move(manifestPairs));
+}
+
+size_t
+TorrentFile::generateStreaming(const std::string& directoryPath,
+                               size_t namesPerSegment,
+                               size_t subManifestSize,
+                               size_t dataPacketSize,
+                               const SegmentSink& sink,
+                               size_t fanout)
+{
+  BOOST_ASSERT(0 < namesPerSegment);
+
+  Name commonPrefix;
+  auto fileNames = listDirectory(directoryPath, commonPrefix);
+
+  // Each segment points to the full name of the next one, so the segments are spilled until
+  // the last one is known, and signed from the last one
+  ChainBuilder<TorrentFile> chain([] (TorrentFile& t, const Name& next) {
+    t.setTorrentFilePtr(next);
+  });
+  Name torrentName(commonPrefix.toUri() + "/torrent-file");
+  TorrentFile currentTorrentFile(torrentName, commonPrefix, {});
+  size_t manifestFileCounter = 0u;
+  for (const auto& fileName : fileNames) {
+    // the full name of the initial sub-manifest, or of the root of the tree over them
+    auto initialManifestName = FileManifest::generateStreaming(fileName, commonPrefix,
+                                                               subManifestSize, dataPacketSize,
+                                                               sink, fanout);
+    if (manifestFileCounter != 0 && 0 == manifestFileCounter % namesPerSegment) {
+      chain.append(std::move(currentTorrentFile));
+      Name currentTorrentName = torrentName;
+      currentTorrentName.appendSequenceNumber(static_cast<int>(manifestFileCounter));
+      currentTorrentFile = TorrentFile(currentTorrentName, commonPrefix, {});
+    }
+    currentTorrentFile.insert(initialManifestName);
+    ++manifestFileCounter;
+  }
+  chain.append(std::move(currentTorrentFile));
+  size_t numSegments = chain.size();
+  chain.build(sink);
+  return numSegments;
 }
 
 } // namespace ntorrent
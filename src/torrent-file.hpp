@@ -28,6 +28,7 @@
 #include <ndn-cxx/encoding/block.hpp>
 #include <ndn-cxx/data.hpp>
 
+#include <functional>
 #include <memory>
 
 namespace ndn {
@@ -51,6 +52,11 @@ public:
    */
   TorrentFile() = default;
 
+  /**
+   * @brief Callback that receives each segment of a torrent as soon as it is signed
+   */
+  typedef std::function<void(const Data&)> SegmentSink;
+
   /**
    * @brief Create a new TorrentFile.
    * @param torrentFileName The name of the torrent-file
@@ -175,6 +181,36 @@ public:
            size_t dataPacketSize,
            bool returnData = false);
 
+  /**
+   * @brief Given a directory path, it generates the torrent-file and file manifests, handing
+   *        each segment to @p sink as soon as it is finalized and signed
+   *
+   * @param directoryPath The path to the directory for which we are to create a torrent-file
+   * @param namesPerSegment The number of manifest names to be included in each segment of the
+   *        torrent-file
+   * @param subManifestSize The maximum number of data packets to be included in a sub-manifest
+   * @param dataPacketSize The maximum number of bytes per Data packet
+   * @param sink The callback that receives every file manifest and torrent-file segment
+   * @param fanout The maximum number of children of each node of the Merkle tree over the
+   *        sub-manifests of each file, or 0 to chain the sub-manifests
+   * @return The number of torrent-file segments
+   *
+   * Unlike generate(), neither the manifests nor the torrent-file segments are kept in memory:
+   * the segments of each chain are spilled, unsigned, to a temporary file until the last one is
+   * known, and then signed and passed to @p sink from the last one to the initial one. The
+   * manifests of each file are passed first, followed by the torrent-file segments. With a
+   * non-zero @p fanout, the manifests of each file are passed along with the nodes of their tree,
+   * and the catalog holds the full name of the root of the tree of each file instead of the full
+   * name of its initial sub-manifest.
+   */
+  static size_t
+  generateStreaming(const std::string& directoryPath,
+                    size_t namesPerSegment,
+                    size_t subManifestSize,
+                    size_t dataPacketSize,
+                    const SegmentSink& sink,
+                    size_t fanout = 0);
+
 protected:
   /**
    * @brief prepend torrent file as a Content block to the encoder
@@ -196,33 +232,6 @@ private:
   bool
   hasTorrentFilePtr() const;
 
-  /**
-   * @brief Create a catalog of suffixes for the names of the file manifests
-   *
-   * To optimize encoding and decoding, we encode the name of the file manifests
-   * as suffixes along with their common prefix.
-   *
-   */
-  void
-  createSuffixCatalog();
-
-  /**
-   * @brief Construct the catalog of long names from a catalog of suffixes for the file
-   *        manifests' name
-   *
-   * After decoding a torrent-file from its wire format, we construct the catalog of
-   * long names from the decoded common prefix and suffixes
-   *
-   */
-  void
-  constructLongNames();
-
-  /**
-   * @brief Insert a suffix to the suffix catalog
-   */
-  void
-  insertToSuffixCatalog(const PartialName& suffix);
-
   /**
    * @brief Set the pointer of the current torrent-file segment to the next segment
    */
@@ -232,7 +241,6 @@ private:
 private:
   Name m_commonPrefix;
   Name m_torrentFilePtr;
-  std::vector<ndn::Name> m_suffixCatalog;
   std::vector<ndn::Name> m_catalog;
 };
 
@@ -260,12 +268,6 @@ TorrentFile::insert(const Name& name)
   m_catalog.push_back(name);
 }
 
-inline void
-TorrentFile::insertToSuffixCatalog(const PartialName& suffix)
-{
-  m_suffixCatalog.push_back(suffix);
-}
-
 inline void
 TorrentFile::setTorrentFilePtr(const Name& ptrName)
 {
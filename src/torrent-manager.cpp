@@ -22,18 +22,21 @@
 #include "torrent-manager.hpp"
 
 #include "file-manifest.hpp"
+#include "manifest-tree-node.hpp"
 #include "torrent-file.hpp"
 #include "util/io-util.hpp"
 #include "util/logging.hpp"
+#include "util/metadata-store.hpp"
+#include "util/signer.hpp"
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 
 #include <ndn-cxx/data.hpp>
-#include <ndn-cxx/security/key-chain.hpp>
-#include <ndn-cxx/security/signing-helpers.hpp>
 #include <ndn-cxx/util/io.hpp>
 
+#include <algorithm>
+#include <limits>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -49,15 +52,14 @@ namespace ndn {
 namespace ntorrent {
 
 static vector<TorrentFile>
-intializeTorrentSegments(const string& torrentFilePath, const Name& initialSegmentName)
+validateTorrentSegments(vector<TorrentFile> torrentSegments, const Name& initialSegmentName)
 {
-  security::KeyChain key_chain;
+  auto& signer = Signer::getDefault();
   Name currSegmentFullName = initialSegmentName;
-  vector<TorrentFile> torrentSegments = IoUtil::load_directory<TorrentFile>(torrentFilePath);
   // Starting with the initial segment name, verify the names, loading next name from torrentSegment
   for (auto it = torrentSegments.begin(); it != torrentSegments.end(); ++it) {
     TorrentFile& segment = *it;
-    key_chain.sign(segment, signingWithSha256());
+    signer.sign(segment);
     if (segment.getFullName() != currSegmentFullName) {
       vector<TorrentFile> correctSegments(torrentSegments.begin(), it);
       torrentSegments.swap(correctSegments);
@@ -72,84 +74,140 @@ intializeTorrentSegments(const string& torrentFilePath, const Name& initialSegme
   return torrentSegments;
 }
 
-static vector<FileManifest>
-intializeFileManifests(const string& manifestPath, const vector<TorrentFile>& torrentSegments)
+static vector<TorrentFile>
+intializeTorrentSegments(const string& torrentFilePath, const Name& initialSegmentName)
 {
-  security::KeyChain key_chain;
+  return validateTorrentSegments(IoUtil::load_directory<TorrentFile>(torrentFilePath),
+                                 initialSegmentName);
+}
 
-  vector<FileManifest> manifests = IoUtil::load_directory<FileManifest>(manifestPath);
-  if (manifests.empty()) {
-    return manifests;
+static vector<TorrentFile>
+intializeTorrentSegments(const MetadataStore& metadataStore,
+                         ManifestStore& manifestStore,
+                         std::unordered_map<Name, uint64_t>& nodeOffsets,
+                         const Name& initialSegmentName)
+{
+  // the index of the store tells the type of every record, only torrent segments are decoded
+  vector<TorrentFile> torrentSegments;
+  for (const auto& entry : metadataStore.entries()) {
+    switch (IoUtil::findType(entry.fullName)) {
+      case IoUtil::TORRENT_FILE:
+        torrentSegments.push_back(TorrentFile(metadataStore.read(entry.offset)));
+        break;
+      case IoUtil::FILE_MANIFEST:
+        manifestStore.insert(ManifestStore::makeKey(entry.fullName),
+                             ManifestStore::Location{metadataStore.path(),
+                                                     entry.offset,
+                                                     io::NO_ENCODING});
+        break;
+      case IoUtil::MANIFEST_TREE_NODE:
+        nodeOffsets[entry.fullName] = entry.offset;
+        break;
+      default:
+        break;
+    }
   }
+  std::stable_sort(torrentSegments.begin(), torrentSegments.end(),
+                   [](const TorrentFile& lhs, const TorrentFile& rhs) {
+                     return lhs.getSegmentNumber() < rhs.getSegmentNumber();
+                   });
+  return validateTorrentSegments(std::move(torrentSegments), initialSegmentName);
+}
 
-  // sign the manifests
-  std::for_each(manifests.begin(), manifests.end(),
-                [&key_chain](FileManifest& m){
-                  key_chain.sign(m,signingWithSha256());
-                });
+typedef std::function<shared_ptr<ManifestTreeNode>(const Name&)> ManifestTreeNodeLoader;
 
-  // put all names of initial manifests from the valid torrent files into a set
-  std::vector<ndn::Name> validInitialManifestNames;
-  for (const auto& segment : torrentSegments) {
-    const auto& catalog = segment.getCatalog();
-    validInitialManifestNames.insert(validInitialManifestNames.end(),
-                                    catalog.begin(),
-                                    catalog.end());
-  }
-  auto manifest_it =  manifests.begin();
-  std::vector<FileManifest> output;
-  output.reserve(manifests.size());
-
-  for (auto& initialName : validInitialManifestNames) {
-    // starting from the initial segment
-    auto& validName = initialName;
-    if (manifests.end() == manifest_it) {
-      break;
+static void
+intializeManifestTree(ManifestStore& store,
+                      const Name& rootFullName,
+                      const ManifestTreeNodeLoader& loadNode,
+                      const std::function<void(shared_ptr<const ManifestTreeNode>)>& visitNode,
+                      const std::function<void(shared_ptr<const FileManifest>)>& visit)
+{
+  // starting from the root, visit the nodes that are on disk and match the full name their
+  // parent holds, depth first, and the sub-manifests below each node of level 1, so that the
+  // sub-manifests are visited in order and only the nodes on the current path are pending
+  vector<Name> pending{rootFullName};
+  while (!pending.empty()) {
+    Name nodeFullName = std::move(pending.back());
+    pending.pop_back();
+    shared_ptr<const ManifestTreeNode> node = loadNode(nodeFullName);
+    if (nullptr == node || node->getFullName() != nodeFullName) {
+      continue;
     }
-    auto fileName = manifest_it->file_name();
-    // sequential collect all valid segments
-    while (manifest_it != manifests.end() && manifest_it->getFullName() == validName) {
-      output.push_back(*manifest_it);
-      if (manifest_it->submanifest_ptr() != nullptr) {
-        validName = *manifest_it->submanifest_ptr();
-        ++manifest_it;
+    visitNode(node);
+    if (1 < node->getLevel()) {
+      for (size_t i = node->childCount(); i > 0; --i) {
+        pending.push_back(node->getChildName(i - 1));
       }
-      else {
-        ++manifest_it;
-        break;
+      continue;
+    }
+    for (size_t i = 0; i < node->childCount(); ++i) {
+      Name validName = node->getChildName(i);
+      auto manifest = store.get(ManifestStore::makeKey(validName));
+      if (nullptr != manifest && manifest->getFullName() == validName) {
+        visit(manifest);
       }
     }
-    // skip the remain segments for this file (all invalid)
-    while (manifests.end() != manifest_it && manifest_it->file_name() == fileName) {
-      ++manifest_it;
+  }
+}
+
+static void
+intializeFileManifests(ManifestStore& store,
+                       const vector<TorrentFile>& torrentSegments,
+                       const ManifestTreeNodeLoader& loadNode,
+                       const std::function<void(shared_ptr<const ManifestTreeNode>)>& visitNode,
+                       const std::function<void(shared_ptr<const FileManifest>)>& visit)
+{
+  // starting from the initial segment of each file in the valid torrent segments, follow the
+  // sub-manifest pointers and visit the segments that are on disk and match their full name, one
+  // at a time, so that only the ones in the cache of the store stay decoded
+  for (const auto& segment : torrentSegments) {
+    for (const auto& initialName : segment.getCatalog()) {
+      // the catalog holds the root of the manifest tree of the file instead, if it has one
+      if (IoUtil::MANIFEST_TREE_NODE == IoUtil::findType(initialName)) {
+        intializeManifestTree(store, initialName, loadNode, visitNode, visit);
+        continue;
+      }
+      Name validName = initialName;
+      while (true) {
+        auto manifest = store.get(ManifestStore::makeKey(validName));
+        if (nullptr == manifest || manifest->getFullName() != validName) {
+          break;
+        }
+        visit(manifest);
+        if (nullptr == manifest->submanifest_ptr()) {
+          break;
+        }
+        validName = *manifest->submanifest_ptr();
+      }
     }
   }
-  return output;
 }
 
-static vector<Data>
-initializeDataPackets(const string&      filePath,
-                      const FileManifest manifest,
-                      size_t             subManifestSize)
+// Return the numbers of the packets of the specified 'manifest' that are valid in the file at the
+// specified 'filePath'
+static vector<size_t>
+initializeDataPackets(const string&       filePath,
+                      const FileManifest& manifest,
+                      size_t              subManifestSize)
 {
-  vector<Data> packets;
   auto subManifestNum = manifest.submanifest_number();
 
-  packets =  IoUtil::packetize_file(filePath,
-                                    manifest.name(),
-                                    manifest.data_packet_size(),
-                                    subManifestSize,
-                                    subManifestNum);
-
-  auto catalog = manifest.catalog();
-  // Filter out invalid packet names
-  std::remove_if(packets.begin(), packets.end(),
-                [&packets, &catalog](const Data& p) {
-                  return catalog.end() == std::find(catalog.begin(),
-                                                     catalog.end(),
-                                                     p.getFullName());
-                });
-  return packets;
+  auto packets =  IoUtil::packetize_file(filePath,
+                                         manifest.name(),
+                                         manifest.data_packet_size(),
+                                         subManifestSize,
+                                         subManifestNum);
+
+  // Filter out invalid packet names, the i-th packet must match the i-th catalog entry
+  vector<size_t> packetNums;
+  for (size_t packetNum = 0; packetNum < packets.size(); ++packetNum) {
+    if (packetNum < manifest.catalog_size()
+        && manifest.catalog_entry(packetNum) == packets[packetNum].fullName) {
+      packetNums.push_back(packetNum);
+    }
+  }
+  return packetNums;
 }
 
 static std::pair<std::shared_ptr<fs::fstream>, std::vector<bool>>
@@ -160,7 +218,7 @@ initializeFileState(const string&       dataPath,
   // construct the file name
   auto fileName = manifest.file_name();
   auto filePath = dataPath + fileName;
-  vector<bool> fileBitMap(manifest.catalog().size());
+  vector<bool> fileBitMap(manifest.catalog_size());
   // if the file does not exist, create an empty placeholder (otherwise cannot set read-bit)
   if (!fs::exists(filePath)) {
     fs::ofstream fs(filePath);
@@ -179,10 +237,50 @@ initializeFileState(const string&       dataPath,
   return std::make_pair(s, fileBitMap);
 }
 
+// Return the routable prefix of the forwarding hint of the specified 'interest', or an empty
+// name if it has none
+static Name
+getRoutablePrefix(const Interest& interest)
+{
+  if (!interest.hasLink()) {
+    return Name();
+  }
+  const auto& delegations = interest.getLink().getDelegations();
+  return delegations.empty() ? Name() : delegations.begin()->second;
+}
+
+// Point the specified 'interest' through a forwarding hint to the specified 'routablePrefix'
+static void
+setLink(Interest& interest, const Name& routablePrefix)
+{
+  Link link(interest.getName(), { {1, routablePrefix} });
+  Signer::getDefault().sign(link);
+  interest.setLink(link.wireEncode());
+}
+
+// Return whether the value of the implicit digest component 'digest' equals the
+// CompactCatalog::DIGEST_SIZE bytes at 'expected'. Every byte is compared, so that the time taken
+// does not tell how much of a forged digest is right.
+static bool
+isDigestEqual(const name::Component& digest, const uint8_t* expected)
+{
+  if (CompactCatalog::DIGEST_SIZE != digest.value_size()) {
+    return false;
+  }
+  const uint8_t* value = digest.value();
+  uint8_t difference = 0;
+  for (size_t i = 0; i < CompactCatalog::DIGEST_SIZE; ++i) {
+    difference |= value[i] ^ expected[i];
+  }
+  return 0 == difference;
+}
+
 //==================================================================================================
 //                                    TorrentManager Implementation
 //==================================================================================================
 
+const time::milliseconds TorrentManager::INITIAL_CONGESTION_BACKOFF = time::milliseconds(100);
+
 void TorrentManager::Initialize()
 {
   // initialize the update handler
@@ -197,72 +295,129 @@ void TorrentManager::Initialize()
     torrentName = m_torrentFileName.getSubName(1 + scheme.size(), m_torrentFileName.size() - (3 + scheme.size()));
   }
 
-  // TODO(spyros) Get update manager working
-  // m_updateHandler = make_shared<UpdateHandler>(torrentName, m_keyChain,
-  //                                              make_shared<StatsTable>(m_statsTable), m_face);
+  // the handler shares the stats table and the face of the manager and never blocks on them
+  if (nullptr == m_updateHandler) {
+    m_updateHandler = make_shared<UpdateHandler>(torrentName, m_statsTable, m_face);
+  }
+  // ask the peers we learn about for the packets they hold, and forget them along with the peers
+  m_updateHandler->setPeerCallbacks([this] (const Name& routablePrefix) {
+                                      this->fetchPieceAvailability(routablePrefix);
+                                    },
+                                    [this] (const Name& routablePrefix) {
+                                      m_pieceAvailability.erase(routablePrefix);
+                                    });
 
   // .../<torrent_name>/torrent-file/<implicit_digest>
   string dataPath = ".appdata/" + m_torrentFileName.get(-3).toUri();
   string manifestPath = dataPath +"/manifests";
   string torrentFilePath = dataPath +"/torrent_files";
 
-  // get the torrent file segments and manifests that we have.
-  if (!fs::exists(torrentFilePath)) {
-    return;
+  // get the torrent file segments and manifests that we have, preferring the binary store
+  m_torrentSegments.clear();
+  m_fileManifests.clear();
+  m_fileManifestsByName.clear();
+  m_manifestTreeNodes.clear();
+  m_manifestTreeRoots.clear();
+  m_deferredManifests.clear();
+  m_metadataNames.clear();
+  m_uncheckedFileStates.clear();
+  m_availabilityData.clear();
+  m_metadataStore.reset();
+  m_manifestStore.clear();
+  string metadataPath = MetadataStore::pathFor(dataPath);
+  vector<TorrentFile> torrentSegments;
+  // the nodes of the manifest trees are read from the same place as the manifests, when visited
+  ManifestTreeNodeLoader loadNode;
+  // a torrent we have no metadata of yet gets a new store, the legacy directories are kept for
+  // the torrents that have them until they are migrated (see MetadataStore::migrate)
+  if (MetadataStore::exists(metadataPath) || !fs::exists(torrentFilePath)) {
+    try {
+      m_metadataStore = make_shared<MetadataStore>(metadataPath);
+    }
+    catch (const MetadataStore::Error& e) {
+      LOG_ERROR << "Cannot open " << metadataPath << ", reading the legacy directories: "
+                << e.what() << std::endl;
+    }
   }
-  m_torrentSegments = intializeTorrentSegments(torrentFilePath, m_torrentFileName);
-  if (m_torrentSegments.empty()) {
-    return;
+  if (m_metadataStore) {
+    auto nodeOffsets = make_shared<std::unordered_map<Name, uint64_t>>();
+    torrentSegments = intializeTorrentSegments(*m_metadataStore,
+                                               m_manifestStore,
+                                               *nodeOffsets,
+                                               m_torrentFileName);
+    loadNode = [nodeOffsets, this] (const Name& nodeFullName) -> shared_ptr<ManifestTreeNode> {
+      auto it = nodeOffsets->find(nodeFullName);
+      if (nodeOffsets->end() == it) {
+        return nullptr;
+      }
+      try {
+        return make_shared<ManifestTreeNode>(m_metadataStore->read(it->second));
+      }
+      catch (const std::exception& e) {
+        LOG_ERROR << "Cannot load the manifest tree node " << nodeFullName << ": " << e.what()
+                  << std::endl;
+        return nullptr;
+      }
+    };
   }
-  m_fileManifests   = intializeFileManifests(manifestPath, m_torrentSegments);
-
-  // get the submanifest sizes
-  for (const auto& m : m_fileManifests) {
-    if (m.submanifest_number() == 0) {
-      auto manifestFileName = m.file_name();
-      m_subManifestSizes[manifestFileName] = m.catalog().size();
+  else {
+    if (!fs::exists(torrentFilePath)) {
+      return;
     }
+    torrentSegments = intializeTorrentSegments(torrentFilePath, m_torrentFileName);
+    // index the manifests on disk, they are decoded only when validated
+    if (!torrentSegments.empty()) {
+      m_manifestStore.indexDirectory(manifestPath);
+    }
+    loadNode = [manifestPath] (const Name& nodeFullName) {
+      return io::load<ManifestTreeNode>(IoUtil::manifestTreeNodePath(nodeFullName.getPrefix(-1),
+                                                                     manifestPath + "/"));
+    };
+  }
+  if (torrentSegments.empty()) {
+    return;
+  }
+  for (auto& t : torrentSegments) {
+    m_metadataNames.insert(t.getFullName());
+    auto segmentNum = t.getSegmentNumber();
+    m_torrentSegments.emplace(segmentNum, make_shared<const TorrentFile>(std::move(t)));
   }
 
-  for (const auto& m : m_fileManifests) {
+  // the initial segment of each file comes first, so its sub-manifest size is known before the
+  // state of the other segments is built. The root of a manifest tree comes before its
+  // sub-manifests, so the last one is known too.
+  auto visitNode = [this] (shared_ptr<const ManifestTreeNode> node) {
+    m_metadataNames.insert(node->getFullName());
+    if (node->isRoot()) {
+      m_manifestTreeRoots[node->getFilePrefix()] = node;
+    }
+    seed(*node);
+    m_manifestTreeNodes[node->getName()] = std::move(node);
+  };
+  intializeFileManifests(m_manifestStore, torrentSegments, loadNode, visitNode,
+                         [this] (shared_ptr<const FileManifest> manifest) {
+    const auto& m = *manifest;
+    m_metadataNames.insert(m.getFullName());
+    insertFileManifest(manifest);
+    updateSubManifestSize(m);
     // construct the file name
     auto fileName = m.file_name();
     fs::path filePath = m_dataPath + fileName;
-    // If there are any valid packets, add corresponding state to manager
     if (!fs::exists(filePath)) {
       if (!fs::exists(filePath.parent_path())) {
         boost::filesystem::create_directories(filePath.parent_path());
       }
-      continue;
     }
-    auto packets = initializeDataPackets(filePath.string(), m, m_subManifestSizes[m.file_name()]);
-    if (!packets.empty()) {
-      m_fileStates[m.getFullName()] = initializeFileState(m_dataPath,
-                                                          m,
-                                                          m_subManifestSizes[m.file_name()]);
-      auto& fileBitMap = m_fileStates[m.getFullName()].second;
-      auto read_it = packets.begin();
-      size_t i = 0;
-      for (auto name : m.catalog()) {
-        if (read_it == packets.end()) {
-          break;
-        }
-        if (name == read_it->getFullName()) {
-          ++read_it;
-          fileBitMap[i] = true;
-        }
-        ++i;
-      }
-      for (const auto& d : packets) {
-        seed(d);
-      }
+    // the packets on disk are only read the first time the state of the file is needed, so that
+    // startup does not read the data of the torrent
+    else {
+      m_uncheckedFileStates.insert(m.getFullName());
     }
-  }
-  for (const auto& t : m_torrentSegments) {
-    seed(t);
-  }
-  for (const auto& m : m_fileManifests) {
-   seed(m);
+    // the packets are seeded along with their manifest
+    seed(m);
+  });
+  for (const auto& kv : m_torrentSegments) {
+    seed(*kv.second);
   }
 }
 
@@ -274,27 +429,28 @@ TorrentManager::findTorrentFileSegmentToDownload() const
     return make_shared<Name>(m_torrentFileName);
   }
   // otherwise just return the next segment ptr of the last segment we have
-  return m_torrentSegments.back().getTorrentFilePtr();
+  return m_torrentSegments.rbegin()->second->getTorrentFilePtr();
 }
 
 shared_ptr<Name>
 TorrentManager::findManifestSegmentToDownload(const Name& manifestName) const
 {
-  //sequentially find whether we have downloaded any segments of this manifest file
-  Name manifestPrefix = manifestName.getSubName(0, manifestName.size() - 2);
-  auto it = std::find_if(m_fileManifests.rbegin(), m_fileManifests.rend(),
-                      [&manifestPrefix] (const FileManifest& f) {
-                        return manifestPrefix.isPrefixOf(f.getName());
-                      });
+  // find the last segment we have downloaded of this manifest file, if any
+  // .../<file_name>/<sub-manifest number>/<implicit digest>
+  auto fileName = ManifestStore::makeKey(manifestName.getPrefix(-1)).first;
+  auto it = m_fileManifests.upper_bound(std::make_pair(fileName,
+                                                       std::numeric_limits<size_t>::max()));
 
   // if we do not have any segments of the file manifest
-  if (it == m_fileManifests.rend()) {
+  if (it == m_fileManifests.begin() || (--it)->first.first != fileName) {
     return make_shared<Name>(manifestName);
   }
 
   // if we already have the requested segment of the file manifest
-  if (it->submanifest_number() >= manifestName.get(manifestName.size() - 2).toSequenceNumber()) {
-    return it->submanifest_ptr();
+  if (it->first.second >= manifestName.get(manifestName.size() - 2).toSequenceNumber()) {
+    auto manifest = loadFileManifest(*it);
+    // download it again if it can no longer be read
+    return nullptr == manifest ? make_shared<Name>(it->second) : manifest->submanifest_ptr();
   }
   // if we do not have the requested segment
   else {
@@ -308,10 +464,18 @@ TorrentManager::findFileManifestsToDownload(std::vector<Name>& manifestNames) co
   std::vector<Name> manifests;
   // insert the first segment name of all the file manifests to the vector
   for (auto i = m_torrentSegments.begin(); i != m_torrentSegments.end(); i++) {
-    manifests.insert(manifests.end(), i->getCatalog().begin(), i->getCatalog().end());
+    const auto& catalog = i->second->getCatalog();
+    manifests.insert(manifests.end(), catalog.begin(), catalog.end());
   }
   // for each file
   for (const auto& manifestName : manifests) {
+    // the sub-manifests of a file with a manifest tree are all found from its root
+    if (IoUtil::MANIFEST_TREE_NODE == IoUtil::findType(manifestName)) {
+      if (!hasManifestTree(manifestName)) {
+        manifestNames.push_back(manifestName);
+      }
+      continue;
+    }
     // find the first (if any) segment we are missing
     shared_ptr<Name> manifestSegmentName = findManifestSegmentToDownload(manifestName);
     if (nullptr != manifestSegmentName) {
@@ -324,24 +488,25 @@ bool
 TorrentManager::hasDataPacket(const Name& dataName) const
 {
 
-  auto manifest_it = std::find_if(m_fileManifests.begin(), m_fileManifests.end(),
-                                 [&dataName](const FileManifest& m) {
-                                   return m.getName().isPrefixOf(dataName);
-                                 });
+  // <manifest name>/<sequence number>/<implicit digest>
+  if (dataName.size() < 2 || !dataName.get(-2).isSequenceNumber()) {
+    return false;
+  }
+  auto manifest = findFileManifest(dataName.getPrefix(-2));
 
   // if we do not have the file manifest, just return false
-  if (manifest_it == m_fileManifests.end()) {
+  if (nullptr == manifest) {
     return false;
   }
 
   // find the pair of (std::shared_ptr<fs::fstream>, std::vector<bool>)
   // that corresponds to the specific submanifest
-  auto fileState_it = m_fileStates.find(manifest_it->getFullName());
-  if (m_fileStates.end() != fileState_it) {
-    const auto& fileState = fileState_it->second;
+  auto fileState = findFileState(*manifest);
+  if (nullptr != fileState) {
     auto dataNum = dataName.get(dataName.size() - 2).toSequenceNumber();
-    // find whether we have the requested packet from the bitmap
-    return fileState.second[dataNum];
+    // find whether we have the requested packet from the bitmap, the name may be out of the
+    // catalog
+    return dataNum < fileState->second.size() && fileState->second[dataNum];
   }
   return false;
 }
@@ -349,48 +514,80 @@ TorrentManager::hasDataPacket(const Name& dataName) const
 void
 TorrentManager::findDataPacketsToDownload(const Name& manifestName, std::vector<Name>& packetNames) const
 {
-  auto manifest_it = std::find_if(m_fileManifests.begin(), m_fileManifests.end(),
-                                 [&manifestName](const FileManifest& m) {
-                                   return m.name().getSubName(0, m.name().size()
-                                                              - 1).isPrefixOf(manifestName);
-                                 });
-
-  for (auto j = manifest_it; j != m_fileManifests.end(); j++) {
-    auto& fileState = m_fileStates[j->getFullName()];
-    for (size_t dataNum = 0; dataNum < j->catalog().size(); ++dataNum) {
-      if (!fileState.second[dataNum]) {
-        packetNames.push_back(j->catalog()[dataNum]);
-      }
-    }
-
-    // check that the next manifest in the vector refers to the next segment of the same file
-    if ((j + 1) != m_fileManifests.end() && (j+1)->file_name() != manifest_it->file_name()) {
-      break;
-    }
-  }
+  // .../<file_name>/<sub-manifest number>/<implicit digest>
+  MissingPacketCursor cursor(ManifestStore::makeKey(manifestName.getPrefix(-1)).first);
+  nextMissingDataPackets(cursor, packetNames);
 }
 
 void
 TorrentManager::findAllMissingDataPackets(std::vector<Name>& packetNames) const
 {
-  for (auto j = m_fileManifests.begin(); j != m_fileManifests.end(); ++j) {
-    auto fileState_it = m_fileStates.find(j->getFullName());
-    // if we have no packets from this file
-    if (m_fileStates.end() == fileState_it) {
-      packetNames.reserve(packetNames.size() + j->catalog().size());
-      packetNames.insert(packetNames.end(), j->catalog().begin(), j->catalog().end());
+  MissingPacketCursor cursor;
+  nextMissingDataPackets(cursor, packetNames);
+}
+
+size_t
+TorrentManager::visitMissingDataPackets(MissingPacketCursor& cursor,
+                                        size_t limit,
+                                        const MissingPacketVisitor& visit) const
+{
+  size_t count = 0;
+  if (cursor.m_done) {
+    return count;
+  }
+  for (auto it = m_fileManifests.lower_bound(cursor.m_position);
+       it != m_fileManifests.end();
+       ++it)
+  {
+    if (cursor.m_singleFile && it->first.first != cursor.m_position.first) {
+      break;
     }
-    // find the packets that we are missing
-    else {
-      const auto &fileState =  fileState_it->second;
-      for (auto i = j->catalog().begin(); i != j->catalog().end(); i++) {
-        auto dataNum = i->get(i->size() - 2).toSequenceNumber();
-        if (!fileState.second[dataNum]) {
-          packetNames.push_back(*i);
+    // held while its packets are visited, even if the store evicts it
+    auto manifest_ptr = loadFileManifest(*it);
+    if (nullptr == manifest_ptr) {
+      continue;
+    }
+    const auto& manifest = *manifest_ptr;
+    auto fileState = findFileState(manifest);
+    // if we have no packets from this file, all of them are missing
+    const std::vector<bool>* bitmap = nullptr == fileState ? nullptr : &fileState->second;
+    size_t catalogSize = manifest.catalog_size();
+    if (nullptr != bitmap && bitmap->size() < catalogSize) {
+      catalogSize = bitmap->size();
+    }
+    size_t i = it->first == cursor.m_position ? cursor.m_packetIndex : 0;
+    while (i < catalogSize) {
+      if (nullptr != bitmap) {
+        // skip the packets we have
+        i = std::find(bitmap->begin() + i, bitmap->begin() + catalogSize, false)
+          - bitmap->begin();
+        if (i == catalogSize) {
+          break;
         }
       }
+      if (0 != limit && count == limit) {
+        cursor.m_position = it->first;
+        cursor.m_packetIndex = i;
+        return count;
+      }
+      visit(manifest, i);
+      ++count;
+      ++i;
     }
   }
+  cursor.m_done = true;
+  return count;
+}
+
+size_t
+TorrentManager::nextMissingDataPackets(MissingPacketCursor& cursor,
+                                       std::vector<Name>& packetNames,
+                                       size_t limit) const
+{
+  return visitMissingDataPackets(cursor, limit,
+                                 [&packetNames] (const FileManifest& manifest, size_t index) {
+                                   packetNames.push_back(manifest.catalog_entry(index));
+                                 });
 }
 
 void
@@ -403,22 +600,21 @@ TorrentManager::downloadTorrentFileSegment(const ndn::Name& name,
 
   auto dataReceived = [path, onSuccess, onFailed, this]
                                             (const Interest& interest, const Data& data) {
-      m_pendingInterests.erase(interest.getName());
       // Stats Table update here...
-      m_stats_table_iter->incrementReceivedData();
-      m_retries = 0;
+      onInterestSatisfied(interest, data);
       std::vector<Name> manifestNames;
-      TorrentFile file(data.wireEncode());
+      // decoded from the received wire encoding, then shared with the index and the seeding path
+      auto file = make_shared<const TorrentFile>(data.wireEncode());
 
       // Write the torrent file segment to disk...
       if (writeTorrentSegment(file, path)) {
         // if successfully written, seed this data
-        seed(file);
+        seed(*file);
       }
-      const std::vector<Name>& manifestCatalog = file.getCatalog();
+      const std::vector<Name>& manifestCatalog = file->getCatalog();
       manifestNames.insert(manifestNames.end(), manifestCatalog.begin(), manifestCatalog.end());
 
-      shared_ptr<Name> nextSegmentPtr = file.getTorrentFilePtr();
+      shared_ptr<Name> nextSegmentPtr = file->getTorrentFilePtr();
       if (onSuccess) {
         onSuccess(manifestNames);
       }
@@ -433,14 +629,7 @@ TorrentManager::downloadTorrentFileSegment(const ndn::Name& name,
 
   auto dataFailed = [path, name, onSuccess, onFailed, this]
                                                 (const Interest& interest) {
-    m_pendingInterests.erase(interest.getName());
-    ++m_retries;
-    if (m_retries >= MAX_NUM_OF_RETRIES) {
-      ++m_stats_table_iter;
-      if (m_stats_table_iter == m_statsTable.end()) {
-        m_stats_table_iter = m_statsTable.begin();
-      }
-    }
+    onInterestFailed(interest);
     this->sendInterest();
     if (onFailed) {
       onFailed(interest.getName(), "Unknown error");
@@ -477,6 +666,32 @@ TorrentManager::download_file_manifest(const Name&              manifestName,
                                        TorrentManager::ManifestReceivedCallback onSuccess,
                                        TorrentManager::FailedCallback           onFailed)
 {
+  // the sub-manifests of a file with a manifest tree are downloaded from a node of the tree, or
+  // one at a time if they failed to download after their node
+  auto nameType = IoUtil::findType(manifestName);
+  bool isTreeNode = IoUtil::MANIFEST_TREE_NODE == nameType;
+  bool isTreeLeaf = IoUtil::FILE_MANIFEST == nameType
+                    && 0 != m_manifestTreeRoots.count(manifestName.getPrefix(-2));
+  if (isTreeNode && !hasManifestTree(manifestName)) {
+    this->downloadManifestTreeNode(manifestName, path, onSuccess, onFailed);
+    return;
+  }
+  if (isTreeLeaf && 0 == m_metadataNames.count(manifestName)) {
+    this->downloadManifestTreeLeaf(manifestName, path, onSuccess, onFailed);
+    return;
+  }
+  if (isTreeNode || isTreeLeaf) {
+    // .../<file name>/%00manifest-tree/<level>/<index>/<implicit digest>
+    auto fileName = isTreeNode
+                  ? ManifestStore::makeKey(Name(manifestName.getPrefix(-4))
+                                             .appendSequenceNumber(0)).first
+                  : ManifestStore::makeKey(manifestName).first;
+    std::vector<Name> packetNames;
+    MissingPacketCursor cursor(fileName);
+    nextMissingDataPackets(cursor, packetNames);
+    onSuccess(packetNames);
+    return;
+  }
   shared_ptr<Name> searchRes = findManifestSegmentToDownload(manifestName);
   auto packetNames = make_shared<std::vector<Name>>();
   if (searchRes == nullptr) {
@@ -497,36 +712,51 @@ TorrentManager::download_data_packet(const Name& packetName,
     return;
   }
 
+  // the packet is already queued or pending, so wait for the same Interest
+  auto& requests = m_dataPacketRequests[packetName];
+  requests.emplace_back(onSuccess, onFailed);
+  if (requests.size() > 1) {
+    LOG_DEBUG << "Merging with the outstanding request for " << packetName << std::endl;
+    return;
+  }
+
   shared_ptr<Interest> interest = this->createInterest(packetName);
 
-  auto dataReceived = [onSuccess, onFailed, this]
+  // The requests are taken out of the table before their callbacks are called, so that a
+  // callback that requests the packet again sends a new Interest
+  auto takeRequests = [packetName, this] () -> DataPacketRequests {
+    DataPacketRequests taken;
+    auto it = m_dataPacketRequests.find(packetName);
+    if (m_dataPacketRequests.end() != it) {
+      taken.swap(it->second);
+      m_dataPacketRequests.erase(it);
+    }
+    return taken;
+  };
+
+  auto dataReceived = [takeRequests, this]
                                           (const Interest& interest, const Data& data) {
-    m_pendingInterests.erase(interest.getName());
+    // Stats Table update here...
+    onInterestSatisfied(interest, data);
     // Write data to disk...
     if(writeData(data)) {
       seed(data);
     }
-    // Stats Table update here...
-    m_stats_table_iter->incrementReceivedData();
-    m_retries = 0;
-    onSuccess(data.getName());
+    for (const auto& request : takeRequests()) {
+      request.first(data.getName());
+    }
     this->sendInterest();
     if (m_pendingInterests.empty() && m_interestQueue->empty() && !m_seedFlag) {
       shutdown();
     }
   };
 
-  auto dataFailed = [onFailed, this]
+  auto dataFailed = [takeRequests, this]
                              (const Interest& interest) {
-    m_retries++;
-    m_pendingInterests.erase(interest.getName());
-    if (m_retries >= MAX_NUM_OF_RETRIES) {
-      m_stats_table_iter++;
-      if (m_stats_table_iter == m_statsTable.end()) {
-        m_stats_table_iter = m_statsTable.begin();
-      }
+    onInterestFailed(interest);
+    for (const auto& request : takeRequests()) {
+      request.second(interest.getName(), "Unknown failure");
     }
-    onFailed(interest.getName(), "Unknown failure");
     this->sendInterest();
   };
   LOG_DEBUG << "Pushing to the Interest Queue: " << *interest << std::endl;
@@ -534,8 +764,69 @@ TorrentManager::download_data_packet(const Name& packetName,
   this->sendInterest();
 }
 
+void
+TorrentManager::downloadPieceAvailability(const Name&          manifestName,
+                                          DataReceivedCallback onSuccess,
+                                          FailedCallback       onFailed,
+                                          const Name&          routablePrefix)
+{
+  shared_ptr<Interest> interest =
+    this->createInterest(PieceAvailability::makeName(manifestName), routablePrefix);
+  // an advertisement is outdated once it is no longer fresh
+  interest->setMustBeFresh(true);
+
+  auto dataReceived = [manifestName, onSuccess, onFailed, this]
+                                          (const Interest& interest, const Data& data) {
+    // Stats Table update here...
+    onInterestSatisfied(interest, data);
+    try {
+      // kept by the name of the manifest without its digest, the prefix of its packet names
+      m_pieceAvailability.update(getRoutablePrefix(interest),
+                                 manifestName.getPrefix(-1),
+                                 PieceAvailability::getVersion(data.getName()),
+                                 PieceAvailability::decode(data.getContent()));
+      if (onSuccess) {
+        onSuccess(data.getName());
+      }
+    }
+    catch (const tlv::Error& e) {
+      LOG_ERROR << "Malformed availability " << data.getName() << ": " << e.what() << std::endl;
+      if (onFailed) {
+        onFailed(interest.getName(), e.what());
+      }
+    }
+    this->sendInterest();
+  };
+
+  auto dataFailed = [onFailed, this]
+                             (const Interest& interest) {
+    onInterestFailed(interest);
+    if (onFailed) {
+      onFailed(interest.getName(), "Unknown failure");
+    }
+    this->sendInterest();
+  };
+  // ahead of the queued packet Interests, so that the advertisement arrives while they can still
+  // be routed to the peers that hold their packets
+  LOG_DEBUG << "Pushing to the front of the Interest Queue: " << *interest << std::endl;
+  m_interestQueue->pushFront(interest, dataReceived, dataFailed);
+  this->sendInterest();
+}
+
 void TorrentManager::seed(const Data& data) {
-  m_face->setInterestFilter(data.getFullName(),
+  // A manifest is seeded under its name, the prefix of the names of its packets, so that the
+  // Interests for the packets we miss reach us too and are Nacked. Its packets are then served
+  // through the same filter.
+  const auto& name = data.getName();
+  auto manifest = findFileManifest(name);
+  if (nullptr == manifest || manifest->getFullName() != data.getFullName()) {
+    manifest = name.empty() ? nullptr : findFileManifest(name.getPrefix(-1));
+  }
+  Name prefix = nullptr == manifest ? data.getFullName() : manifest->getName();
+  if (!m_seededPrefixes.insert(prefix).second) {
+    return;
+  }
+  m_face->setInterestFilter(prefix,
                            bind(&TorrentManager::onInterestReceived, this, _1, _2),
                            RegisterPrefixSuccessCallback(),
                            bind(&TorrentManager::onRegisterFailed, this, _1, _2));
@@ -555,38 +846,61 @@ bool TorrentManager::writeData(const Data& packet)
 {
   // find correct manifest
   const auto& packetName = packet.getName();
-  auto manifest_it = std::find_if(m_fileManifests.begin(), m_fileManifests.end(),
-                                 [&packetName](const FileManifest& m) {
-                                   return m.getName().isPrefixOf(packetName);
-                                 });
-  if (m_fileManifests.end() == manifest_it) {
+  // <manifest name>/<sequence number>
+  auto manifest_ptr = findFileManifest(packetName.getPrefix(-1));
+  if (nullptr == manifest_ptr) {
+    return false;
+  }
+  const auto& manifest = *manifest_ptr;
+  auto packetNum = packetName.get(packetName.size() - 1).toSequenceNumber();
+  if (packetNum >= manifest.catalog_size()) {
     return false;
   }
-  // get file state out
-  auto& fileState = m_fileStates[manifest_it->getFullName()];
+  // check the packet against the digest in the catalog, the full name of a packet received for a
+  // full name Interest is already computed when the Interest is matched, so this does not hash
+  if (VERIFY_IMPLICIT_DIGEST == m_verificationMode) {
+    const uint8_t* expectedDigest = manifest.catalog_digest(packetNum);
+    const auto& digest = packet.getFullName().get(-1);
+    if (nullptr == expectedDigest || !isDigestEqual(digest, expectedDigest)) {
+      LOG_ERROR << "Implicit digest mismatch for " << packetName << std::endl;
+      return false;
+    }
+  }
+  // the offset of the packets of the last sub-manifest of a file is only known along with the
+  // size of the others
+  auto subManifestSize = getSubManifestSize(manifest);
+  if (0 == subManifestSize && 0 != manifest.submanifest_number()) {
+    LOG_ERROR << "Unknown offset of " << packetName << std::endl;
+    return false;
+  }
+  // get file state out, after the packets on disk are checked
+  findFileState(manifest);
+  auto& fileState = m_fileStates[manifest.getFullName()];
 
   // if there is no open stream to the file
   if (nullptr == fileState.first) {
-    fs::path filePath = m_dataPath + manifest_it->file_name();
+    fs::path filePath = m_dataPath + manifest.file_name();
     if (!fs::exists(filePath)) {
       fs::create_directories(filePath.parent_path());
     }
-    fileState = initializeFileState(m_dataPath,
-                                    *manifest_it,
-                                    m_subManifestSizes[manifest_it->file_name()]);
+    fileState = initializeFileState(m_dataPath, manifest, subManifestSize);
   }
-  auto packetNum = packetName.get(packetName.size() - 1).toSequenceNumber();
   // if we already have the packet, do not rewrite it.
   if (fileState.second[packetNum]) {
     return false;
   }
   // write data to disk
-  // TODO(msweatt) Fix this once code is merged
-  auto subManifestSize = m_subManifestSizes[manifest_it->file_name()];
-  if (IoUtil::writeData(packet, *manifest_it, subManifestSize, *fileState.first)) {
+  if (IoUtil::writeData(packet, manifest, subManifestSize, *fileState.first)) {
     fileState.first->flush();
     // update bitmap
     fileState.second[packetNum] = true;
+    // only the runs around the packet change, the advertisement is signed again on the next
+    // request
+    auto availability = m_availabilityData.find(manifest.getFullName());
+    if (m_availabilityData.end() != availability) {
+      availability->second.bitfield.set(packetNum);
+      availability->second.data = nullptr;
+    }
     return true;
   }
   return false;
@@ -594,49 +908,239 @@ bool TorrentManager::writeData(const Data& packet)
 
 bool
 TorrentManager::writeTorrentSegment(const TorrentFile& segment, const std::string& path)
+{
+  return writeTorrentSegment(make_shared<const TorrentFile>(segment), path);
+}
+
+bool
+TorrentManager::writeTorrentSegment(shared_ptr<const TorrentFile> segment, const std::string& path)
 {
   // validate  the torrent
   auto torrentPrefix = m_torrentFileName.getSubName(0, m_torrentFileName.size() - 1);
-  // check if we already have it
-  if (torrentPrefix.isPrefixOf(segment.getName()) &&
-      m_torrentSegments.end() == std::find(m_torrentSegments.begin(), m_torrentSegments.end(),
-                                           segment))
+  // check if we already have it, the full name holds the digest of the segment
+  if (!torrentPrefix.isPrefixOf(segment->getName()) ||
+      !m_metadataNames.insert(segment->getFullName()).second)
   {
-    if(IoUtil::writeTorrentSegment(segment, path)) {
-      auto it = std::find_if(m_torrentSegments.begin(), m_torrentSegments.end(),
-                             [&segment](const TorrentFile& t){
-                               return segment.getSegmentNumber() < t.getSegmentNumber() ;
-                            });
-      m_torrentSegments.insert(it, segment);
-      return true;
+    return false;
+  }
+  bool written = false;
+  if (nullptr != m_metadataStore) {
+    try {
+      m_metadataStore->append(*segment);
+      written = true;
+    }
+    catch (const MetadataStore::Error& e) {
+      LOG_ERROR << "Cannot store " << segment->getFullName() << ": " << e.what() << std::endl;
     }
   }
-  return false;
+  else {
+    written = IoUtil::writeTorrentSegment(*segment, path);
+  }
+  if (!written) {
+    m_metadataNames.erase(segment->getFullName());
+    return false;
+  }
+  // placed after any segment with the same number
+  m_torrentSegments.emplace(segment->getSegmentNumber(), std::move(segment));
+  return true;
 }
 
 
 bool TorrentManager::writeFileManifest(const FileManifest& manifest, const std::string& path)
 {
-  if (m_fileManifests.end() == std::find(m_fileManifests.begin(), m_fileManifests.end(),
-                                           manifest))
-  {
-    // update the state of the manager
-    if (0 == manifest.submanifest_number()) {
-      m_subManifestSizes[manifest.file_name()] = manifest.catalog().size();
-    }
-    if(IoUtil::writeFileManifest(manifest, path)) {
-      // add to collection
-      auto it = std::find_if(m_fileManifests.begin(), m_fileManifests.end(),
-                             [&manifest](const FileManifest& m){
-                               return m.file_name() >  manifest.file_name()
-                               ||    (m.file_name() == manifest.file_name()
-                                  && (m.submanifest_number() > manifest.submanifest_number()));
-                            });
-      m_fileManifests.insert(it, manifest);
-      return true;
+  return writeFileManifest(make_shared<const FileManifest>(manifest), path);
+}
+
+bool
+TorrentManager::writeFileManifest(shared_ptr<const FileManifest> manifest,
+                                  const std::string& path)
+{
+  auto key = ManifestStore::makeKey(manifest->getName());
+  // check if we already have it, the full name holds the digest of the manifest, and that we do
+  // not have another manifest for the same file and sub-manifest number, which it would overwrite
+  if (0 != m_fileManifests.count(key) || !m_metadataNames.insert(manifest->getFullName()).second) {
+    return false;
+  }
+  bool written = false;
+  if (nullptr != m_metadataStore) {
+    try {
+      auto offset = m_metadataStore->append(*manifest);
+      m_manifestStore.insert(key,
+                             ManifestStore::Location{m_metadataStore->path(),
+                                                     offset,
+                                                     io::NO_ENCODING},
+                             manifest);
+      written = true;
+    }
+    catch (const MetadataStore::Error& e) {
+      LOG_ERROR << "Cannot store " << manifest->getFullName() << ": " << e.what() << std::endl;
     }
   }
-  return false;
+  else {
+    written = IoUtil::writeFileManifest(*manifest, path);
+    if (written) {
+      m_manifestStore.insert(key,
+                             ManifestStore::Location{path + manifest->file_name() + "/" +
+                                                     to_string(manifest->submanifest_number()),
+                                                     0,
+                                                     io::BASE64},
+                             manifest);
+    }
+  }
+  // add to collection
+  if (!written || !insertFileManifest(manifest)) {
+    m_metadataNames.erase(manifest->getFullName());
+    return false;
+  }
+  // update the state of the manager
+  updateSubManifestSize(*manifest);
+  return true;
+}
+
+bool
+TorrentManager::writeManifestTreeNode(shared_ptr<const ManifestTreeNode> node,
+                                      const std::string& path)
+{
+  // check if we already have it, the full name holds the digest of the node
+  if (!m_metadataNames.insert(node->getFullName()).second) {
+    return false;
+  }
+  bool written = false;
+  if (nullptr != m_metadataStore) {
+    try {
+      m_metadataStore->append(*node);
+      written = true;
+    }
+    catch (const MetadataStore::Error& e) {
+      LOG_ERROR << "Cannot store " << node->getFullName() << ": " << e.what() << std::endl;
+    }
+  }
+  else {
+    written = IoUtil::writeManifestTreeNode(*node, path);
+  }
+  if (!written) {
+    m_metadataNames.erase(node->getFullName());
+    return false;
+  }
+  if (node->isRoot()) {
+    m_manifestTreeRoots[node->getFilePrefix()] = node;
+  }
+  m_manifestTreeNodes[node->getName()] = std::move(node);
+  return true;
+}
+
+bool
+TorrentManager::insertFileManifest(shared_ptr<const FileManifest> manifest)
+{
+  auto key = ManifestStore::makeKey(manifest->getName());
+  auto result = m_fileManifests.emplace(key, manifest->getFullName());
+  if (result.second) {
+    m_fileManifestsByName[manifest->getName()] = result.first;
+    // keep the manifest in memory, unless the store reads this very manifest from disk
+    auto stored = m_manifestStore.get(key);
+    if (nullptr == stored || stored->getFullName() != result.first->second) {
+      m_manifestStore.insert(key, std::move(manifest));
+    }
+  }
+  return result.second;
+}
+
+shared_ptr<const FileManifest>
+TorrentManager::findFileManifest(const Name& manifestName) const
+{
+  auto it = m_fileManifestsByName.find(manifestName);
+  return m_fileManifestsByName.end() == it ? nullptr : loadFileManifest(*it->second);
+}
+
+TorrentManager::FileState*
+TorrentManager::findFileState(const FileManifest& manifest) const
+{
+  const auto& manifestFullName = manifest.getFullName();
+  if (0 != m_uncheckedFileStates.erase(manifestFullName)) {
+    auto subManifestSize = getSubManifestSize(manifest);
+    // the packets of the last sub-manifest of a file cannot be found without the size of the
+    // others, they are downloaded again
+    if (0 == manifest.submanifest_number() || 0 != subManifestSize) {
+      try {
+        auto packetNums = initializeDataPackets(m_dataPath + manifest.file_name(),
+                                                manifest,
+                                                subManifestSize);
+        if (!packetNums.empty()) {
+          auto fileState = initializeFileState(m_dataPath, manifest, subManifestSize);
+          // every remaining packet matches the catalog entry for its sequence number
+          for (auto packetNum : packetNums) {
+            fileState.second[packetNum] = true;
+          }
+          m_fileStates[manifestFullName] = std::move(fileState);
+        }
+      }
+      catch (const std::exception& e) {
+        LOG_ERROR << "Cannot check the packets of " << manifestFullName << " on disk: "
+                  << e.what() << std::endl;
+      }
+    }
+  }
+  auto it = m_fileStates.find(manifestFullName);
+  return m_fileStates.end() == it ? nullptr : &it->second;
+}
+
+size_t
+TorrentManager::getSubManifestSize(const FileManifest& manifest) const
+{
+  auto it = m_subManifestSizes.find(manifest.file_name());
+  return m_subManifestSizes.end() == it ? 0 : it->second;
+}
+
+void
+TorrentManager::updateSubManifestSize(const FileManifest& manifest)
+{
+  // every sub-manifest of a file but the last one has the size of the first one, the root of
+  // the manifest tree of the file, if it has one, tells which one is the last
+  auto number = manifest.submanifest_number();
+  auto root = m_manifestTreeRoots.find(manifest.getName().getPrefix(-1));
+  if (0 != number
+      && (m_manifestTreeRoots.end() == root || number + 1 >= root->second->getLeafCount())) {
+    return;
+  }
+  auto fileName = manifest.file_name();
+  m_subManifestSizes[fileName] = manifest.catalog_size();
+  auto deferred = m_deferredManifests.find(fileName);
+  if (m_deferredManifests.end() != deferred) {
+    auto callbacks = std::move(deferred->second);
+    m_deferredManifests.erase(deferred);
+    for (const auto& callback : callbacks) {
+      callback();
+    }
+  }
+}
+
+bool
+TorrentManager::hasManifestTree(const Name& rootFullName) const
+{
+  // .../<file name>/%00manifest-tree/<level>/<index>/<implicit digest>
+  auto root = m_manifestTreeNodes.find(rootFullName.getPrefix(-1));
+  if (m_manifestTreeNodes.end() == root || root->second->getFullName() != rootFullName) {
+    return false;
+  }
+  // the sub-manifests of the file are the first ones of the index with its file name
+  auto leafCount = root->second->getLeafCount();
+  auto fileName = ManifestStore::makeKey(Name(root->second->getFilePrefix())
+                                           .appendSequenceNumber(0)).first;
+  auto first = m_fileManifests.lower_bound(std::make_pair(fileName, size_t(0)));
+  auto last = m_fileManifests.lower_bound(std::make_pair(fileName, leafCount));
+  return static_cast<size_t>(std::distance(first, last)) == leafCount;
+}
+
+shared_ptr<const FileManifest>
+TorrentManager::loadFileManifest(const FileManifestIndex::value_type& entry) const
+{
+  auto manifest = m_manifestStore.get(entry.first);
+  // the copy on disk may have been replaced since it was validated
+  if (nullptr == manifest || manifest->getFullName() != entry.second) {
+    LOG_ERROR << "Cannot load the manifest " << entry.second << std::endl;
+    return nullptr;
+  }
+  return manifest;
 }
 
 void
@@ -650,24 +1154,25 @@ TorrentManager::downloadFileManifestSegment(const Name& manifestName,
 
   auto dataReceived = [packetNames, path, onSuccess, onFailed, this]
                                           (const Interest& interest, const Data& data) {
-    m_pendingInterests.erase(interest.getName());
     // Stats Table update here...
-    m_stats_table_iter->incrementReceivedData();
-    m_retries = 0;
+    onInterestSatisfied(interest, data);
 
-    FileManifest file(data.wireEncode());
+    // decoded from the received wire encoding, then shared with the index and the seeding path
+    auto file = make_shared<const FileManifest>(data.wireEncode());
 
     // Write the file manifest segment to disk...
     if(writeFileManifest(file, path)) {
-      seed(file);
+      seed(*file);
     }
     else {
       onFailed(interest.getName(), "Write Failed");
     }
 
-    const std::vector<Name>& packetsCatalog = file.catalog();
-    packetNames->insert(packetNames->end(), packetsCatalog.begin(), packetsCatalog.end());
-    shared_ptr<Name> nextSegmentPtr = file.submanifest_ptr();
+    packetNames->reserve(packetNames->size() + file->catalog_size());
+    for (size_t i = 0; i < file->catalog_size(); ++i) {
+      packetNames->push_back(file->catalog_entry(i));
+    }
+    shared_ptr<Name> nextSegmentPtr = file->submanifest_ptr();
     if (nextSegmentPtr != nullptr) {
       this->downloadFileManifestSegment(*nextSegmentPtr, path, packetNames, onSuccess, onFailed);
     }
@@ -682,13 +1187,143 @@ TorrentManager::downloadFileManifestSegment(const Name& manifestName,
 
   auto dataFailed = [packetNames, path, manifestName, onFailed, this]
                                                 (const Interest& interest) {
-    m_pendingInterests.erase(interest.getName());
-    m_retries++;
-    if (m_retries >= MAX_NUM_OF_RETRIES) {
-      m_stats_table_iter++;
-      if (m_stats_table_iter == m_statsTable.end())
-        m_stats_table_iter = m_statsTable.begin();
+    onInterestFailed(interest);
+    onFailed(interest.getName(), "Unknown failure");
+    this->sendInterest();
+  };
+  LOG_DEBUG << "Pushing to the Interest Queue: " << *interest << std::endl;
+  m_interestQueue->push(interest, dataReceived, dataFailed);
+  this->sendInterest();
+}
+
+void
+TorrentManager::downloadManifestTreeNode(const Name& nodeFullName,
+                                         const std::string& path,
+                                         TorrentManager::ManifestReceivedCallback onSuccess,
+                                         TorrentManager::FailedCallback onFailed)
+{
+  // the children of a node are all requested at once, so each level takes a single round trip
+  auto descend = [path, onSuccess, onFailed, this] (const ManifestTreeNode& node) {
+    for (size_t i = 0; i < node.childCount(); ++i) {
+      auto childName = node.getChildName(i);
+      if (1 < node.getLevel()) {
+        this->downloadManifestTreeNode(childName, path, onSuccess, onFailed);
+      }
+      else if (0 == m_metadataNames.count(childName)) {
+        this->downloadManifestTreeLeaf(childName, path, onSuccess, onFailed);
+      }
+    }
+  };
+
+  // a node we already have is not downloaded again, only what we miss below it
+  auto node_it = m_manifestTreeNodes.find(nodeFullName.getPrefix(-1));
+  if (m_manifestTreeNodes.end() != node_it && node_it->second->getFullName() == nodeFullName) {
+    descend(*node_it->second);
+    return;
+  }
+
+  shared_ptr<Interest> interest = this->createInterest(nodeFullName);
+
+  auto dataReceived = [nodeFullName, path, descend, onFailed, this]
+                                          (const Interest& interest, const Data& data) {
+    // Stats Table update here...
+    onInterestSatisfied(interest, data);
+
+    // the full name of the node is taken from its parent, or from the catalog for the root, so
+    // the node is verified by its digest before it is decoded
+    shared_ptr<const ManifestTreeNode> node;
+    std::string error = "Implicit digest mismatch";
+    if (data.getFullName() == nodeFullName) {
+      try {
+        node = make_shared<const ManifestTreeNode>(data.wireEncode());
+      }
+      catch (const tlv::Error& e) {
+        error = e.what();
+      }
+    }
+    if (nullptr == node) {
+      LOG_ERROR << "Invalid manifest tree node " << data.getName() << ": " << error
+                << std::endl;
+      onFailed(interest.getName(), error);
+    }
+    else {
+      if (writeManifestTreeNode(node, path)) {
+        seed(*node);
+      }
+      descend(*node);
+    }
+    this->sendInterest();
+    if (m_pendingInterests.empty() && m_interestQueue->empty() && !m_seedFlag) {
+      shutdown();
+    }
+  };
+
+  auto dataFailed = [onFailed, this] (const Interest& interest) {
+    onInterestFailed(interest);
+    onFailed(interest.getName(), "Unknown failure");
+    this->sendInterest();
+  };
+  LOG_DEBUG << "Pushing to the Interest Queue: " << *interest << std::endl;
+  m_interestQueue->push(interest, dataReceived, dataFailed);
+  this->sendInterest();
+}
+
+void
+TorrentManager::downloadManifestTreeLeaf(const Name& manifestFullName,
+                                         const std::string& path,
+                                         TorrentManager::ManifestReceivedCallback onSuccess,
+                                         TorrentManager::FailedCallback onFailed)
+{
+  shared_ptr<Interest> interest = this->createInterest(manifestFullName);
+
+  auto dataReceived = [manifestFullName, path, onSuccess, onFailed, this]
+                                          (const Interest& interest, const Data& data) {
+    // Stats Table update here...
+    onInterestSatisfied(interest, data);
+
+    // verified by the digest its node holds, as for the nodes
+    shared_ptr<const FileManifest> file;
+    std::string error = "Implicit digest mismatch";
+    if (data.getFullName() == manifestFullName) {
+      try {
+        file = make_shared<const FileManifest>(data.wireEncode());
+      }
+      catch (const tlv::Error& e) {
+        error = e.what();
+      }
+    }
+    if (nullptr == file) {
+      LOG_ERROR << "Invalid file manifest " << data.getName() << ": " << error << std::endl;
+      onFailed(interest.getName(), error);
+    }
+    else {
+      if (writeFileManifest(file, path)) {
+        seed(*file);
+      }
+      auto packetNames = make_shared<std::vector<Name>>();
+      packetNames->reserve(file->catalog_size());
+      for (size_t i = 0; i < file->catalog_size(); ++i) {
+        packetNames->push_back(file->catalog_entry(i));
+      }
+      // the packets of the last sub-manifest of a file cannot be written before the size of the
+      // others is known, so they are only requested once another sub-manifest is received
+      if (0 == file->submanifest_number() || 0 != getSubManifestSize(*file)) {
+        onSuccess(*packetNames);
+      }
+      else {
+        m_deferredManifests[file->file_name()].push_back([onSuccess, packetNames] {
+          onSuccess(*packetNames);
+        });
+      }
     }
+    this->sendInterest();
+    if (m_pendingInterests.empty() && m_interestQueue->empty() && !m_seedFlag) {
+      shutdown();
+    }
+  };
+
+  auto dataFailed = [onFailed, this] (const Interest& interest) {
+    onInterestFailed(interest);
     onFailed(interest.getName(), "Unknown failure");
     this->sendInterest();
   };
@@ -703,47 +1338,64 @@ TorrentManager::onInterestReceived(const InterestFilter& filter, const Interest&
   // handle if it is a torrent-file
   LOG_DEBUG << "Interest Received: " << interest << std::endl;
   const auto& interestName = interest.getName();
-  std::shared_ptr<Data> data = nullptr;
-  auto cmp = [&interestName](const Data& t){return t.getFullName() == interestName;};
+  // the metadata is served straight from the shared, already encoded, segments we hold
+  std::shared_ptr<const Data> data = nullptr;
+  // whether it is a data packet of a manifest we have, even if we miss the packet itself
+  bool isKnownPacket = false;
+  // determine if it is the advertisement of the packets of a manifest (that we have)
+  if (PieceAvailability::isAvailabilityName(interestName)) {
+    data = makePieceAvailabilityData(interestName.getPrefix(-1));
+    if (nullptr != data) {
+      m_face->put(*data);
+    }
+    else {
+      LOG_ERROR << "NACK: " << interest << std::endl;
+    }
+    return;
+  }
   // determine if it is torrent file (that we have)
-  auto torrent_it =  std::find_if(m_torrentSegments.begin(), m_torrentSegments.end(), cmp);
+  auto torrent_it =  std::find_if(m_torrentSegments.begin(), m_torrentSegments.end(),
+                                  [&interestName](const TorrentSegmentIndex::value_type& kv) {
+                                    return kv.second->getFullName() == interestName;
+                                  });
+  // determine if it is a manifest tree node (that we have)
+  auto node_it = m_manifestTreeNodes.end();
+  if (!m_manifestTreeNodes.empty()) {
+    node_it = m_manifestTreeNodes.find(interestName.getPrefix(-1));
+  }
   if (m_torrentSegments.end() != torrent_it) {
-    data = std::make_shared<Data>(*torrent_it);
+    data = torrent_it->second;
+  }
+  else if (m_manifestTreeNodes.end() != node_it
+           && node_it->second->getFullName() == interestName) {
+    data = node_it->second;
   }
   else {
     // determine if it is manifest (that we have)
-    auto manifest_it = std::find_if(m_fileManifests.begin(), m_fileManifests.end(), cmp);
-    if (m_fileManifests.end() != manifest_it) {
-      data = std::make_shared<Data>(*manifest_it) ;
+    auto manifest_it = m_fileManifests.find(ManifestStore::makeKey(interestName));
+    if (m_fileManifests.end() != manifest_it && manifest_it->second == interestName) {
+      data = loadFileManifest(*manifest_it);
     }
     else {
       // determine if it is data packet (that we have)
       auto manifestName = interestName.getSubName(0, interestName.size() - 2);
-      auto map_it = std::find_if(m_fileStates.begin(), m_fileStates.end(),
-                                       [&manifestName](const std::pair<Name,
-                                                          std::pair<std::shared_ptr<fs::fstream>,
-                                                                    std::vector<bool>>>& kv){
-                                        return manifestName.isPrefixOf(kv.first);
-                                      });
-      if (m_fileStates.end() != map_it) {
+      auto manifest = findFileManifest(manifestName);
+      isKnownPacket = nullptr != manifest && interestName.get(-2).isSequenceNumber()
+                      && interestName.get(-2).toSequenceNumber() < manifest->catalog_size();
+      auto fileState = isKnownPacket ? findFileState(*manifest) : nullptr;
+      if (nullptr != fileState) {
         auto packetName = interestName.getSubName(0, interestName.size() - 1);
         // get out the bitmap to be sure we have the packet
-        auto& fileState = map_it->second;
-        const auto &bitmap = fileState.second;
+        const auto &bitmap = fileState->second;
         auto packetNum = packetName.get(packetName.size() - 1).toSequenceNumber();
         if (bitmap[packetNum]) {
-          // get the manifest
-          auto manifest_it = std::find_if(m_fileManifests.begin(), m_fileManifests.end(),
-                                          [&manifestName](const FileManifest& m) {
-                                            return manifestName.isPrefixOf(m.name());
-                                          });
-          auto manifestFileName = manifest_it->file_name();
+          auto manifestFileName = manifest->file_name();
           auto filePath = m_dataPath + manifestFileName;
           // TODO(msweatt) Explore why fileState stream does not work
           fs::fstream is (filePath, fs::fstream::in | fs::fstream::binary);
           data = IoUtil::readDataPacket(interestName,
-                                        *manifest_it,
-                                        m_subManifestSizes[manifestFileName],
+                                        *manifest,
+                                        getSubManifestSize(*manifest),
                                         is);
         }
       }
@@ -752,8 +1404,15 @@ TorrentManager::onInterestReceived(const InterestFilter& filter, const Interest&
   if (nullptr != data) {
     m_face->put(*data);
   }
+  else if (isKnownPacket) {
+    // tell the requester at once that we miss the packet, so that it asks another peer instead
+    // of waiting for its Interest to time out
+    LOG_DEBUG << "NACK: " << interest << std::endl;
+    lp::Nack nack(interest);
+    nack.setReason(lp::NackReason::NO_ROUTE);
+    m_face->put(nack);
+  }
   else {
-    // TODO(msweatt) NACK
     LOG_ERROR << "NACK: " << interest << std::endl;
   }
   return;
@@ -768,51 +1427,272 @@ TorrentManager::onRegisterFailed(const Name& prefix, const std::string& reason)
   shutdown();
 }
 
+shared_ptr<const Data>
+TorrentManager::makePieceAvailabilityData(const Name& manifestFullName)
+{
+  auto cached = m_availabilityData.find(manifestFullName);
+  if (m_availabilityData.end() == cached) {
+    auto manifest_it = m_fileManifests.find(ManifestStore::makeKey(manifestFullName));
+    if (m_fileManifests.end() == manifest_it || manifest_it->second != manifestFullName) {
+      return nullptr;
+    }
+    auto manifest = loadFileManifest(*manifest_it);
+    if (nullptr == manifest) {
+      return nullptr;
+    }
+    // the runs are computed from the bitmap once, then kept up to date by writeData
+    auto fileState = findFileState(*manifest);
+    PieceAvailability::Bitfield bitfield(nullptr == fileState
+                                         ? std::vector<bool>(manifest->catalog_size())
+                                         : fileState->second);
+    cached = m_availabilityData.emplace(manifestFullName,
+                                        AvailabilityData{std::move(bitfield), nullptr}).first;
+  }
+  auto& availability = cached->second;
+  if (nullptr == availability.data) {
+    auto data = PieceAvailability::makeData(manifestFullName, availability.bitfield);
+    Signer::getDefault().sign(*data);
+    availability.data = data;
+  }
+  return availability.data;
+}
+
+void
+TorrentManager::fetchPieceAvailability(const Name& routablePrefix)
+{
+  // the manifests of the requested packets, <manifest name>/<sequence number>/<implicit digest>
+  std::unordered_set<Name> manifestNames;
+  for (const auto& request : m_dataPacketRequests) {
+    manifestNames.insert(request.first.getPrefix(-2));
+  }
+  for (const auto& manifestName : manifestNames) {
+    auto it = m_fileManifestsByName.find(manifestName);
+    if (m_fileManifestsByName.end() == it) {
+      continue;
+    }
+    const Name& manifestFullName = it->second->second;
+    // the Interests for an advertisement all have the same name, so a second one would only be
+    // aggregated with the outstanding one
+    Name availabilityName = PieceAvailability::makeName(manifestFullName);
+    if (!m_availabilityRequests.insert(availabilityName).second) {
+      continue;
+    }
+    auto done = [availabilityName, this] {
+      m_availabilityRequests.erase(availabilityName);
+    };
+    downloadPieceAvailability(manifestFullName,
+                              [done] (const Name&) { done(); },
+                              [done] (const Name&, const std::string&) { done(); },
+                              routablePrefix);
+  }
+}
+
 shared_ptr<Interest>
-TorrentManager::createInterest(Name name)
+TorrentManager::createInterest(Name name, const Name& routablePrefix)
 {
   shared_ptr<Interest> interest = make_shared<Interest>(name);
   interest->setInterestLifetime(time::milliseconds(2000));
 
-  // Select routable prefix
-  // TODO(spyros) Fix links
-  // Link link(name, { {1, m_stats_table_iter->getRecordName()} });
-  // m_keyChain->sign(link, signingWithSha256());
-  // Block linkWire = link.wireEncode();
+  // the routable prefix of the other Interests is chosen once they are sent, see 'routeInterest'
+  if (!routablePrefix.empty()) {
+    setLink(*interest, routablePrefix);
+  }
+
+  return interest;
+}
+
+void
+TorrentManager::routeInterest(Interest& interest)
+{
+  if (interest.hasLink()) {
+    auto record = m_statsTable->find(getRoutablePrefix(interest));
+    if (m_statsTable->end() != record) {
+      record->incrementSentInterests();
+      m_statsTable->update(record);
+    }
+  }
+  else {
+    // Point the Interest to the routable prefix with the most room for another outstanding
+    // Interest, so several prefixes are used at once
+    selectRoutablePrefix(interest, {});
+  }
+
+  // the stats table keeps its records ranked as they change, so the interval is only used to
+  // check whether we should send out an "ALIVE" Interest
+  m_updateCounter++;
+  if (m_updateCounter >= UPDATE_INTERVAL) {
+    if (nullptr != m_updateHandler && m_updateHandler->needsUpdate()) {
+      m_updateHandler->sendAliveInterest(m_updateHandler->selectPeer());
+    }
+    m_updateCounter = 0;
+  }
+}
+
+bool
+TorrentManager::selectRoutablePrefix(Interest& interest,
+                                     const std::unordered_set<Name>& excludedPrefixes)
+{
+  StatsTable::RecordFilter notExcluded;
+  if (!excludedPrefixes.empty()) {
+    notExcluded = [&excludedPrefixes] (const StatsTableRecord& record) {
+      return 0 == excludedPrefixes.count(record.getRecordName());
+    };
+  }
+
+  // Prefer the prefixes that advertised the packet, if it is one
+  // <manifest name>/<sequence number>/<implicit digest>
+  const auto& name = interest.getName();
+  StatsTable::RecordFilter hasPacket;
+  if (!m_pieceAvailability.empty() && name.size() >= 2 && name.get(-2).isSequenceNumber()) {
+    auto manifestName = name.getPrefix(-2);
+    auto packetNum = name.get(-2).toSequenceNumber();
+    if (m_pieceAvailability.count(manifestName, packetNum) > 0) {
+      hasPacket = [this, manifestName, packetNum, notExcluded] (const StatsTableRecord& record) {
+        return (!notExcluded || notExcluded(record))
+               && m_pieceAvailability.has(record.getRecordName(), manifestName, packetNum);
+      };
+    }
+  }
+
+  auto record = m_statsTable->end();
+  if (hasPacket) {
+    record = m_statsTable->selectRecord(hasPacket);
+  }
+  if (m_statsTable->end() == record) {
+    record = m_statsTable->selectRecord(notExcluded);
+  }
+  if (m_statsTable->end() == record) {
+    return false;
+  }
+  setRoutablePrefix(interest, record);
+  return true;
+}
+
+void
+TorrentManager::setRoutablePrefix(Interest& interest, StatsTable::iterator record)
+{
+  setLink(interest, record->getRecordName());
 
   // Stats Table update here...
-  m_stats_table_iter->incrementSentInterests();
+  record->incrementSentInterests();
+  m_statsTable->update(record);
+}
+
+void
+TorrentManager::onInterestSatisfied(const Interest& interest, const Data& data)
+{
+  auto pending = m_pendingInterests.find(interest.getName());
+  auto record = m_statsTable->find(getRoutablePrefix(interest));
+  if (m_statsTable->end() != record) {
+    if (m_pendingInterests.end() != pending) {
+      record->incrementReceivedData(data.wireEncode().size(),
+                                    time::steady_clock::now() - pending->second);
+    }
+    else {
+      record->incrementReceivedData();
+    }
+    m_statsTable->update(record);
+  }
+  if (m_pendingInterests.end() != pending) {
+    m_pendingInterests.erase(pending);
+  }
+}
 
-  m_sortingCounter++;
-  if (m_sortingCounter >= SORTING_INTERVAL) {
-    // Use the sorting interval to send out "ALIVE" Interests as well
-    // check whether we should send out an "ALIVE" Interest
-    // if (m_updateHandler->needsUpdate()) {
-    //   m_updateHandler->sendAliveInterest(m_stats_table_iter);
-    // }
-    // Do the actual sorting related stuff
-    m_sortingCounter = 0;
-    m_statsTable.sort();
-    m_stats_table_iter = m_statsTable.begin();
-    m_retries = 0;
+void
+TorrentManager::onInterestFailed(const Interest& interest)
+{
+  // an Interest given up after its Nacks is no longer pending, and was counted as Nacked
+  if (0 == m_pendingInterests.erase(interest.getName())) {
+    return;
   }
+  auto record = m_statsTable->find(getRoutablePrefix(interest));
+  if (m_statsTable->end() != record) {
+    record->incrementTimeouts();
+    m_statsTable->update(record);
+  }
+}
 
-  // interest->setLink(linkWire);
+void
+TorrentManager::onInterestNacked(const Interest& interest,
+                                 const lp::Nack& nack,
+                                 const DataCallback& onData,
+                                 const TimeoutCallback& onFailed,
+                                 shared_ptr<NackState> nackState)
+{
+  LOG_ERROR << "Nack received: " << nack.getReason() << ": " << interest << std::endl;
+  auto prefix = getRoutablePrefix(interest);
+  auto record = m_statsTable->find(prefix);
+  if (m_statsTable->end() != record) {
+    record->incrementNacks();
+    m_statsTable->update(record);
+  }
 
-  return interest;
+  auto retry = make_shared<Interest>(interest);
+  retry->refreshNonce();
+  if (lp::NackReason::CONGESTION == nack.getReason()
+      && nackState->congestionNacks < MAX_CONGESTION_RETRIES) {
+    // the path is congested, so wait before asking again, through the prefix with the most room
+    // by then. The Interest keeps its slot in the window meanwhile, so that fewer Interests are
+    // outstanding while the congestion lasts.
+    auto backoff = INITIAL_CONGESTION_BACKOFF * (1 << nackState->congestionNacks);
+    ++nackState->congestionNacks;
+    m_scheduler->scheduleEvent(backoff, [retry, onData, onFailed, nackState, this] {
+      if (selectRoutablePrefix(*retry, nackState->nackedPrefixes)) {
+        expressInterest(retry, onData, onFailed, nackState);
+        return;
+      }
+      // no prefix is left to ask, so the Interest fails and gives up its slot in the window
+      m_pendingInterests.erase(retry->getName());
+      if (onFailed) {
+        onFailed(*retry);
+      }
+    });
+    return;
+  }
+
+  // the slot of the Interest in the window is free again
+  m_pendingInterests.erase(interest.getName());
+  if (lp::NackReason::CONGESTION != nack.getReason()) {
+    // a peer that lacks the packet, or a forwarder with no route to it, answers at once, so ask
+    // another prefix right away rather than wait for the Interest to time out
+    nackState->nackedPrefixes.insert(prefix);
+    if (selectRoutablePrefix(*retry, nackState->nackedPrefixes)) {
+      expressInterest(retry, onData, onFailed, nackState);
+      return;
+    }
+  }
+  if (onFailed) {
+    onFailed(interest);
+  }
+}
+
+void
+TorrentManager::expressInterest(shared_ptr<Interest> interest,
+                                const DataCallback& onData,
+                                const TimeoutCallback& onFailed,
+                                shared_ptr<NackState> nackState)
+{
+  m_pendingInterests[interest->getName()] = time::steady_clock::now();
+  LOG_DEBUG << "Sending: " << *interest << std::endl;
+  m_face->expressInterest(*interest,
+                          onData,
+                          [onData, onFailed, nackState, this]
+                                            (const Interest& nacked, const lp::Nack& nack) {
+                            onInterestNacked(nacked, nack, onData, onFailed, nackState);
+                          },
+                          onFailed);
 }
 
 void
 TorrentManager::sendInterest()
 {
-  auto nackCallBack = [](const Interest& i, const lp::Nack& n) {
-    LOG_ERROR << "Nack received: " << n.getReason() << ": " << i << std::endl;
-   };
   while (m_pendingInterests.size() < WINDOW_SIZE && !m_interestQueue->empty()) {
     queueTuple tup = m_interestQueue->pop();
-    m_pendingInterests.insert(std::get<0>(tup)->getName());
-    LOG_DEBUG << "Sending: " <<  *(std::get<0>(tup)) << std::endl;
-    m_face->expressInterest(*std::get<0>(tup), std::get<1>(tup), nackCallBack, std::get<2>(tup));
+    // routed as it is sent, so that it follows the measurements and the advertisements received
+    // while it was queued
+    routeInterest(*std::get<0>(tup));
+    expressInterest(std::get<0>(tup), std::get<1>(tup), std::get<2>(tup),
+                    make_shared<NackState>());
   }
 }
 
@@ -24,19 +24,24 @@
 
 #include "file-manifest.hpp"
 #include "interest-queue.hpp"
+#include "manifest-store.hpp"
+#include "manifest-tree-node.hpp"
+#include "piece-availability.hpp"
 #include "torrent-file.hpp"
 #include "update-handler.hpp"
+#include "util/metadata-store.hpp"
 
 #include <ndn-cxx/data.hpp>
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/interest.hpp>
 #include <ndn-cxx/link.hpp>
 #include <ndn-cxx/name.hpp>
-#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
 
 #include <boost/filesystem/fstream.hpp>
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -59,6 +64,55 @@ class TorrentManager : noncopyable {
    typedef std::function<void(const std::vector<ndn::Name>&)>        ManifestReceivedCallback;
    typedef std::function<void(const std::vector<ndn::Name>&)>        TorrentFileReceivedCallback;
    typedef std::function<void(const ndn::Name&, const std::string&)> FailedCallback;
+   typedef std::function<void(const FileManifest&, size_t)>          MissingPacketVisitor;
+
+   /*
+    * \brief The checks a received Data packet has to pass before it is written to disk
+    */
+   enum VerificationMode {
+     // the name of the packet matches an entry of the catalog of its manifest
+     VERIFY_NAME,
+     // in addition, the SHA-256 of its wire encoding equals the implicit digest of that entry
+     VERIFY_IMPLICIT_DIGEST
+   };
+
+   /*
+    * \brief A resumable position in the enumeration of the Data packets this manager is missing
+    *
+    * A cursor walks the FileManifests in (file name, sub-manifest number) order and, for each of
+    * them, the bitmap of the packets we have. It only holds the key of the manifest it stopped
+    * in, so it remains valid while new manifests and packets are received. Once done, a cursor
+    * stays done.
+    */
+   class MissingPacketCursor {
+   public:
+     /*
+      * \brief Create a cursor over the missing packets of all the files of the torrent
+      */
+     MissingPacketCursor();
+
+     /*
+      * \brief Create a cursor over the missing packets of the file with the specified name
+      */
+     explicit
+     MissingPacketCursor(const std::string& fileName);
+
+     /*
+      * \brief Return 'true' if there are no more missing packets to enumerate
+      */
+     bool
+     done() const;
+
+   private:
+     friend class TorrentManager;
+
+     // The key of the manifest to resume from
+     ManifestStore::Key m_position;
+     // The index in the catalog of that manifest to resume from
+     size_t             m_packetIndex;
+     bool               m_singleFile;
+     bool               m_done;
+   };
 
    /*
     * \brief Create a new Torrent manager with the specified parameters.
@@ -79,11 +133,25 @@ class TorrentManager : noncopyable {
    *
    * Read and validate from disk all torrent file segments, file manifests, and data packets for
    * the torrent file managed by this object initializing all state in this manager respectively.
-   * Also seeds all validated data.
+   * Also seeds all validated data. The metadata is kept in the binary store of the torrent, which
+   * is created for a torrent without metadata on disk, unless the torrent only has the legacy
+   * directories.
   */
   void
   Initialize();
 
+  /*
+   * \brief Set the checks received Data packets have to pass, VERIFY_IMPLICIT_DIGEST by default
+   */
+  void
+  setVerificationMode(VerificationMode mode);
+
+  /*
+   * \brief Return the checks received Data packets have to pass
+   */
+  VerificationMode
+  getVerificationMode() const;
+
   /**
    * brief Return 'true' if all segments of the torrent file downloaded, 'false' otherwise.
    */
@@ -150,6 +218,34 @@ class TorrentManager : noncopyable {
   void
   findAllMissingDataPackets(std::vector<Name>& packetNames) const;
 
+  /*
+   * \brief Call @p visit with each manifest and catalog index of the next data packets that we
+   *        are missing, starting from the position of @p cursor
+   * @param cursor The position to start from, advanced past the visited packets
+   * @param limit The maximum number of packets to visit, or 0 for all the remaining packets
+   * @param visit The function to call for each missing packet
+   * @return The number of visited packets
+   *
+   * No Name is constructed, so a scheduler can walk the indices of the missing packets and only
+   * build the names of the packets it requests.
+   */
+  size_t
+  visitMissingDataPackets(MissingPacketCursor& cursor,
+                          size_t limit,
+                          const MissingPacketVisitor& visit) const;
+
+  /*
+   * \brief Append to @p packetNames the names of the next data packets that we are missing
+   * @param cursor The position to start from, advanced past the returned packets
+   * @param packetNames The output vector of names
+   * @param limit The maximum number of names to append, or 0 for all the remaining packets
+   * @return The number of appended names
+   */
+  size_t
+  nextMissingDataPackets(MissingPacketCursor& cursor,
+                         std::vector<Name>& packetNames,
+                         size_t limit = 0) const;
+
   /*
    * @brief Stop all network activities of this manager
    */
@@ -185,6 +281,10 @@ class TorrentManager : noncopyable {
    *
    * This method provides non-blocking downloading of all the file manifest segments
    *
+   * If @p manifestName is the root of the manifest tree of a file, as listed in the catalog of
+   * the torrent file, the nodes of the tree are downloaded level by level, each one verified
+   * against its parent, then the sub-manifests we are missing, each one verified against its
+   * node. The callback is then called for each sub-manifest, in the order they are received.
    */
   void
   download_file_manifest(const Name&              manifestName,
@@ -200,7 +300,9 @@ class TorrentManager : noncopyable {
    * @param onFailed Callaback to be called if we fail to download the requested data packet
    *                 It passes the name of the data packet to the callback and a failure reason
    *
-   * This method writes the downloaded data packet to m_dataPath on disk
+   * This method writes the downloaded data packet to m_dataPath on disk. The requests for a
+   * packet that is already requested are merged into the outstanding one, and their callbacks
+   * are all called with its outcome
    *
    */
   void
@@ -208,7 +310,36 @@ class TorrentManager : noncopyable {
                        DataReceivedCallback onSuccess,
                        FailedCallback       onFailed);
 
-  // Seed the specified 'data' to the network.
+  /*
+   * @brief Download the advertisement of the data packets a peer holds of a file manifest
+   * @param manifestName The full name of the file manifest segment
+   * @param onSuccess Callback to be called with the name of the advertisement once it is
+   *                  retrieved and kept for the routable prefix it was retrieved through
+   * @param onFailed Callback to be called if we fail to retrieve or decode the advertisement
+   * @param routablePrefix The routable prefix of the peer to ask, or the empty name to ask the
+   *                       prefix with the most room for another outstanding Interest
+   *
+   * The Interest for the advertisement is sent ahead of the queued Interests. Once it is kept,
+   * the Interests for the data packets of the manifest, queued ones included, are sent through a
+   * prefix that advertised them, if there is one. The advertisements are also
+   * downloaded from each peer inserted into the stats table or seen alive again, for the
+   * manifests whose packets are requested, and dropped along with the peer.
+   */
+  void
+  downloadPieceAvailability(const Name&          manifestName,
+                            DataReceivedCallback onSuccess,
+                            FailedCallback       onFailed,
+                            const Name&          routablePrefix = Name());
+
+  /*
+   * @brief Return the data packets advertised through each routable prefix, e.g., to find the
+   *        rarest packets
+   */
+  const PieceAvailability&
+  getPieceAvailability() const;
+
+  // Seed the specified 'data' to the network, along with the other packets of its manifest when
+  // we have the manifest.
   void
   seed(const Data& data);
 
@@ -241,6 +372,12 @@ class TorrentManager : noncopyable {
   bool
   writeTorrentSegment(const TorrentFile& segment, const std::string& path);
 
+  /*
+   * \brief Same as above, but the manager shares @p segment instead of copying it.
+   */
+  bool
+  writeTorrentSegment(shared_ptr<const TorrentFile> segment, const std::string& path);
+
   /*
    * \brief Write the @p manifest file manifest to disk at the specified @p path.
    * @param manifest The file manifest  to be written to disk
@@ -253,6 +390,37 @@ class TorrentManager : noncopyable {
   bool
   writeFileManifest(const FileManifest& manifest, const std::string& path);
 
+  /*
+   * \brief Same as above, but the manager shares @p manifest instead of copying it.
+   */
+  bool
+  writeFileManifest(shared_ptr<const FileManifest> manifest, const std::string& path);
+
+  /*
+   * \brief Write the @p node manifest tree node to disk in the directory @p path of the file
+   * manifests, or to the binary store, and keep it. Return 'true' if the node was written,
+   * 'false' if we already have it or it cannot be written. Behavior is undefined unless @p node
+   * has been verified against the root of its tree.
+   */
+  bool
+  writeManifestTreeNode(shared_ptr<const ManifestTreeNode> node, const std::string& path);
+
+  /*
+   * \brief Add @p manifest to the FileManifests of this manager and index it by name.
+   * Return 'true' if the manifest was added, 'false' if the manager already has a manifest for
+   * the same file and sub-manifest number.
+   */
+  bool
+  insertFileManifest(shared_ptr<const FileManifest> manifest);
+
+  /*
+   * \brief Return the FileManifest with the specified name (without the implicit digest), or
+   * nullptr if this manager does not have it. The name of a manifest is the prefix of the names
+   * of its Data packets, so this is the lookup for every received or requested packet.
+   */
+  shared_ptr<const FileManifest>
+  findFileManifest(const Name& manifestName) const;
+
   /*
    * \brief Download the segments of the torrent file
    * @param name The name of the torrent file to be downloaded
@@ -286,15 +454,45 @@ class TorrentManager : noncopyable {
                               ManifestReceivedCallback onSuccess,
                               FailedCallback onFailed);
 
+  /*
+   * \brief Download the subtree of the manifest tree node with the specified full name, then the
+   *        sub-manifests below it that we are missing
+   * @param nodeFullName The full name of the node, either the root or taken from its parent
+   * @param path The path to write the nodes and the file manifests on disk
+   * @param onSuccess Callback to be called with the names of the data packets of each downloaded
+   *                  sub-manifest
+   * @param onFailed Callback to be called with the name of each node or sub-manifest we fail to
+   *                 download
+   */
+  void
+  downloadManifestTreeNode(const Name& nodeFullName,
+                           const std::string& path,
+                           ManifestReceivedCallback onSuccess,
+                           FailedCallback onFailed);
+
+  /*
+   * \brief Download the sub-manifest with the specified full name, taken from a node of the
+   *        manifest tree of its file
+   */
+  void
+  downloadManifestTreeLeaf(const Name& manifestFullName,
+                           const std::string& path,
+                           ManifestReceivedCallback onSuccess,
+                           FailedCallback onFailed);
+
   enum {
-    // Number of times to retry if a routable prefix fails to retrieve data
-    MAX_NUM_OF_RETRIES = 5,
-    // Number of Interests to be sent before sorting the stats table
-    SORTING_INTERVAL = 100,
+    // Number of Interests to be sent before checking whether to send an "ALIVE" Interest
+    UPDATE_INTERVAL = 100,
     // Maximum window size used for sending new Interests out
-    WINDOW_SIZE = 50
+    WINDOW_SIZE = 50,
+    // Number of times an Interest is sent again after a congestion Nack before it is given up
+    MAX_CONGESTION_RETRIES = 5
   };
 
+  // The delay before an Interest is sent again after its first congestion Nack, doubled after
+  // each following one
+  static const time::milliseconds INITIAL_CONGESTION_BACKOFF;
+
   void onDataReceived(const Data& data);
 
   void
@@ -304,53 +502,244 @@ class TorrentManager : noncopyable {
   onRegisterFailed(const Name& prefix, const std::string& reason);
 
 protected:
+  // Torrent segments keyed by segment number, segments with the same number keep their order
+  typedef std::multimap<size_t, shared_ptr<const TorrentFile>>        TorrentSegmentIndex;
+  // The full names of the FileManifests keyed by file name and sub-manifest number
+  typedef std::map<ManifestStore::Key, Name>                          FileManifestIndex;
+  // The callbacks of the requests merged into the Interest for a data packet
+  typedef std::vector<std::pair<DataReceivedCallback, FailedCallback>> DataPacketRequests;
+  // The stream to the file of a FileManifest on disk, and a bitmap of the Data packets of the
+  // manifest this manager has
+  typedef std::pair<std::shared_ptr<fs::fstream>, std::vector<bool>>  FileState;
+
+  /*
+   * \brief Return the FileManifest of the specified 'entry' of the FileManifests this manager has,
+   * decoded through the manifest store, or nullptr if it can no longer be read
+   */
+  shared_ptr<const FileManifest>
+  loadFileManifest(const FileManifestIndex::value_type& entry) const;
+
+  /*
+   * \brief Return the state of the file of the specified 'manifest', or nullptr if we have none
+   * of its packets. The packets on disk of a manifest read by Initialize() are checked against
+   * its catalog the first time its state is needed, rather than at startup.
+   */
+  FileState*
+  findFileState(const FileManifest& manifest) const;
+
+  /*
+   * \brief Return the number of data packets of the sub-manifests of the file of the specified
+   * 'manifest' (but the last one), or 0 if we do not know it yet
+  size_t
+  getSubManifestSize(const FileManifest& manifest) const;
+
+  /*
+   * \brief Record the number of data packets of the sub-manifests of the file of the specified
+   * 'manifest', if it tells it, and call the callbacks deferred until it is known
+   */
+  void
+  updateSubManifestSize(const FileManifest& manifest);
+
+  /*
+   * \brief Return 'true' if we have the manifest tree node with the specified full name, e.g.,
+   * the root of a tree, and all the sub-manifests of its file
+   */
+  bool
+  hasManifestTree(const Name& rootFullName) const;
+
   // A map from each fileManifest to corresponding file stream on disk and a bitmap of which Data
   // packets this manager currently has
-  mutable std::unordered_map<Name,
-                             std::pair<std::shared_ptr<fs::fstream>,
-                                       std::vector<bool>>>            m_fileStates;
+  mutable std::unordered_map<Name, FileState>                         m_fileStates;
+  // The FileManifests (by full name) read by Initialize() whose packets on disk are not checked
+  // yet, see findFileState()
+  mutable std::unordered_set<Name>                                    m_uncheckedFileStates;
   // A map for each initial manifest to the size for the sub-manifest
   std::unordered_map<std::string, size_t>                             m_subManifestSizes;
-  // The segments of the TorrentFile this manager has
-  std::vector<TorrentFile>                                            m_torrentSegments;
-  // The FileManifests this manager has
-  std::vector<FileManifest>                                           m_fileManifests;
+  // The callbacks for the last sub-manifest of a file received before any other one, so before
+  // its offset in the file is known, by file name
+  std::unordered_map<std::string, std::vector<std::function<void()>>> m_deferredManifests;
+  // The segments of the TorrentFile this manager has, ordered by segment number
+  TorrentSegmentIndex                                                 m_torrentSegments;
+  // The FileManifests this manager has, ordered by file name and sub-manifest number
+  FileManifestIndex                                                   m_fileManifests;
+  // The FileManifests this manager has, by name (without the implicit digest)
+  std::unordered_map<Name, FileManifestIndex::const_iterator>         m_fileManifestsByName;
+  // The FileManifests this manager has and the ones stored on disk, decoded on demand
+  mutable ManifestStore                                               m_manifestStore;
+  // The nodes of the manifest trees this manager has, by name (without the implicit digest)
+  std::unordered_map<Name, shared_ptr<const ManifestTreeNode>>        m_manifestTreeNodes;
+  // The roots of the manifest trees this manager has, by file prefix
+  std::unordered_map<Name, shared_ptr<const ManifestTreeNode>>        m_manifestTreeRoots;
+  // The full names of the torrent segments, FileManifests and manifest tree nodes this manager
+  // has
+  std::unordered_set<Name>                                            m_metadataNames;
+  // The binary store of the metadata of the torrent, null for a torrent kept in the legacy
+  // directories
+  std::shared_ptr<MetadataStore>                                      m_metadataStore;
   // The name of the initial segment of the torrent file for this manager
   Name                                                                m_torrentFileName;
   // The path to the location on disk of the Data packet for this manager
   std::string                                                         m_dataPath;
+  // The checks received Data packets have to pass
+  VerificationMode                                                    m_verificationMode;
 
 private:
+  /*
+   * \brief Return the advertisement of the data packets we hold of the file manifest with the
+   * specified full name, signed, or nullptr if we do not have the manifest
+   */
+  shared_ptr<const Data>
+  makePieceAvailabilityData(const Name& manifestFullName);
+
+  /*
+   * \brief Download from the peer with the specified 'routablePrefix' the advertisements of the
+   * manifests whose data packets are requested, unless one is already outstanding.
+   */
+  void
+  fetchPieceAvailability(const Name& routablePrefix);
+
+  /*
+   * \brief Create an Interest for the specified 'name', pointed to the specified
+   * 'routablePrefix', or, if it is empty, to the prefix chosen by 'routeInterest' when it is sent.
+   */
   shared_ptr<Interest>
-  createInterest(Name name);
+  createInterest(Name name, const Name& routablePrefix = Name());
+
+  /*
+   * \brief Count the specified 'interest', taken out of the queue for a slot of the window, as
+   * outstanding through the routable prefix it was created for, or point it to the prefix
+   * chosen by 'selectRoutablePrefix' if it was created for none.
+   */
+  void
+  routeInterest(Interest& interest);
+
+  /*
+   * \brief Point the specified 'interest' through a forwarding hint to the routable prefix with
+   * the most room for another outstanding Interest, preferring the prefixes that advertised the
+   * packet it requests and skipping the specified 'excludedPrefixes'. Return 'false', leaving the
+   * 'interest' unchanged, if every prefix is excluded.
+   */
+  bool
+  selectRoutablePrefix(Interest& interest, const std::unordered_set<Name>& excludedPrefixes);
+
+  /*
+   * \brief Point the specified 'interest' through a forwarding hint to the routable prefix of
+   * the specified 'record', and count it as outstanding through the prefix.
+   */
+  void
+  setRoutablePrefix(Interest& interest, StatsTable::iterator record);
 
   void
   sendInterest();
 
+  // The Nacks received for the Interests sent for a name
+  struct NackState {
+    // The routable prefixes that Nacked it for another reason than congestion
+    std::unordered_set<Name> nackedPrefixes;
+    // The number of congestion Nacks received for it
+    size_t                   congestionNacks = 0;
+  };
+
+  /*
+   * \brief Send the specified 'interest' in a slot of the window, and send it again if it is
+   * Nacked, according to the specified 'nackState' of its previous attempts.
+   */
+  void
+  expressInterest(shared_ptr<Interest> interest,
+                  const DataCallback& onData,
+                  const TimeoutCallback& onFailed,
+                  shared_ptr<NackState> nackState);
+
+  /*
+   * \brief Remove the specified 'interest' from the pending Interests, and credit the routable
+   * prefix it was forwarded through with the retrieval of the specified 'data' and its round trip
+   */
+  void
+  onInterestSatisfied(const Interest& interest, const Data& data);
+
+  /*
+   * \brief Remove the specified 'interest' from the pending Interests after it timed out, and
+   * count the timeout against the routable prefix it was forwarded through, unless it was already
+   * counted as Nacked
+   */
+  void
+  onInterestFailed(const Interest& interest);
+
+  /*
+   * \brief Count the specified 'nack' of the specified 'interest' against the routable prefix it
+   * was forwarded through, and send the 'interest' again. After a congestion Nack, it is sent
+   * after a backoff that doubles with each one in the specified 'nackState', keeping its slot in
+   * the window meanwhile. After any other Nack, its slot is freed and it is sent right away
+   * through a prefix that did not Nack it yet. Call the specified 'onFailed' once it is given up.
+   */
+  void
+  onInterestNacked(const Interest& interest,
+                   const lp::Nack& nack,
+                   const DataCallback& onData,
+                   const TimeoutCallback& onFailed,
+                   shared_ptr<NackState> nackState);
 
   // A flag to determine if upon completion we should continue seeding
   bool                                                                m_seedFlag;
   // Face used for network communication
   std::shared_ptr<Face>                                               m_face;
-  // Stats table where routable prefixes are stored
-  StatsTable                                                          m_statsTable;
-  // Iterator to the routable prefix that we currently use
-  StatsTable::iterator                                                m_stats_table_iter;
-  // Number of retries per routable prefix
-  uint64_t                                                            m_retries;
-  // Number of Interests sent since last sorting
-  uint64_t                                                            m_sortingCounter;
-  // Keychain instance
-  shared_ptr<KeyChain>                                                m_keyChain;
-  // A collection for all interests that have been sent for which we have not received a response
-  std::unordered_set<ndn::Name>                                       m_pendingInterests;
+  // Stats table where routable prefixes are stored, Interests are spread over all of them
+  shared_ptr<StatsTable>                                              m_statsTable;
+  // Number of Interests sent since the last check for an "ALIVE" Interest
+  uint64_t                                                            m_updateCounter;
+  // The interests that have been sent for which we have not received a response, and the time
+  // each one was sent
+  std::unordered_map<ndn::Name, time::steady_clock::TimePoint>        m_pendingInterests;
   // A queue to hold all interests for requested data that we have yet to send
   shared_ptr<InterestQueue>                                           m_interestQueue;
-  // TODO(spyros) Fix and reintegrate update handler
-  // // Update Handler instance
-  // shared_ptr<UpdateHandler>                                           m_updateHandler;
+  // The callbacks of the requests for each data packet that is queued or pending, so that a
+  // single Interest is sent for the concurrent requests of a packet
+  std::unordered_map<Name, DataPacketRequests>                        m_dataPacketRequests;
+  // The data packets advertised through each routable prefix, by file manifest
+  PieceAvailability                                                   m_pieceAvailability;
+  // The data packets we hold of a file manifest, as advertised, and the advertisement signed
+  // for them, which is reset when a packet is received and signed again on the next request
+  struct AvailabilityData {
+    PieceAvailability::Bitfield bitfield;
+    shared_ptr<const Data>      data;
+  };
+  // The advertisement of the data packets we hold of each file manifest (by full name), its runs
+  // updated in place as the packets are received
+  std::unordered_map<Name, AvailabilityData>                          m_availabilityData;
+  // The names of the advertisements being downloaded from the peers
+  std::unordered_set<Name>                                            m_availabilityRequests;
+  // Update Handler instance, exchanges the routable prefixes of the stats table with other peers
+  shared_ptr<UpdateHandler>                                           m_updateHandler;
+  // Scheduler of the Interests sent again after a congestion Nack
+  shared_ptr<util::scheduler::Scheduler>                              m_scheduler;
+  // The prefixes of the Interest filters registered to seed the torrent
+  std::unordered_set<Name>                                            m_seededPrefixes;
 };
 
+inline
+TorrentManager::MissingPacketCursor::MissingPacketCursor()
+  : m_position()
+  , m_packetIndex(0)
+  , m_singleFile(false)
+  , m_done(false)
+{
+}
+
+inline
+TorrentManager::MissingPacketCursor::MissingPacketCursor(const std::string& fileName)
+  : m_position(fileName, 0)
+  , m_packetIndex(0)
+  , m_singleFile(true)
+  , m_done(false)
+{
+}
+
+inline bool
+TorrentManager::MissingPacketCursor::done() const
+{
+  return m_done;
+}
+
 inline
 TorrentManager::TorrentManager(const ndn::Name&      torrentFileName,
                                const std::string&    dataPath,
@@ -361,23 +750,23 @@ TorrentManager::TorrentManager(const ndn::Name&      torrentFileName,
 , m_fileManifests()
 , m_torrentFileName(torrentFileName)
 , m_dataPath(dataPath)
+, m_verificationMode(VERIFY_IMPLICIT_DIGEST)
 , m_seedFlag(seed)
 , m_face(face)
-, m_retries(0)
-, m_sortingCounter(0)
-, m_keyChain(new KeyChain())
+, m_statsTable(make_shared<StatsTable>())
+, m_updateCounter(0)
 {
   m_interestQueue = make_shared<InterestQueue>();
 
   if(face == nullptr) {
     m_face = make_shared<Face>();
   }
+  m_scheduler = make_shared<util::scheduler::Scheduler>(m_face->getIoService());
 
   // Hardcoded prefixes for now
   // TODO(Spyros): Think of something more clever to bootstrap...
-  m_statsTable.insert("/ucla");
-  m_statsTable.insert("/arizona");
-  m_stats_table_iter = m_statsTable.begin();
+  m_statsTable->insert("/ucla");
+  m_statsTable->insert("/arizona");
 }
 
 inline
@@ -387,6 +776,20 @@ TorrentManager::processEvents(const time::milliseconds& timeout)
   m_face->processEvents(timeout);
 }
 
+inline
+void
+TorrentManager::setVerificationMode(VerificationMode mode)
+{
+  m_verificationMode = mode;
+}
+
+inline
+TorrentManager::VerificationMode
+TorrentManager::getVerificationMode() const
+{
+  return m_verificationMode;
+}
+
 inline
 bool
 TorrentManager::hasAllTorrentSegments() const
@@ -394,6 +797,13 @@ TorrentManager::hasAllTorrentSegments() const
   return findTorrentFileSegmentToDownload() == nullptr;
 }
 
+inline
+const PieceAvailability&
+TorrentManager::getPieceAvailability() const
+{
+  return m_pieceAvailability;
+}
+
 }  // end ntorrent
 }  // end ndn
 
@@ -21,30 +21,105 @@
 
 #include "update-handler.hpp"
 #include "util/logging.hpp"
+#include "util/signer.hpp"
 
-#include <ndn-cxx/security/signing-helpers.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 
 namespace ndn {
 namespace ntorrent {
 
+const time::milliseconds UpdateHandler::INITIAL_LEARN_RETRY_DELAY = time::milliseconds(100);
+const time::milliseconds UpdateHandler::MAX_LEARN_RETRY_DELAY = time::seconds(30);
+const time::milliseconds UpdateHandler::ALIVE_RETRY_DELAY = time::seconds(1);
+const time::milliseconds UpdateHandler::PEER_LIFETIME = time::minutes(5);
+
+// The freshness period of a response to an "ALIVE" Interest, so that a cached sample is not
+// handed out to every peer that asks
+static const time::milliseconds ALIVE_FRESHNESS_PERIOD = time::seconds(1);
+
+// The score of a prefix whose recent Interests all failed, so that it is still sampled
+static const double MIN_PEER_SCORE = 0.05;
+
+// The throughput, in bytes per second, under which a prefix no longer counts as delivering data
+static const double MIN_PEER_THROUGHPUT = 1024;
+
+// The success rate of a record: its own estimate once it has been tried, until then the rate
+// advertised by the peer it was learned from
+static double
+getSuccessRate(const StatsTableRecord& record)
+{
+  return record.isRecordMeasured() ? record.getRecordEwmaSuccessRate()
+                                   : record.getRecordAdvertisedSuccessRate();
+}
+
+static double
+getScore(const StatsTableRecord& record)
+{
+  return std::max(getSuccessRate(record), MIN_PEER_SCORE);
+}
+
 void
 UpdateHandler::sendAliveInterest(StatsTable::iterator iter)
 {
+  if (IDLE != m_state || m_statsTable->end() == iter) {
+    LOG_DEBUG << "Not sending an ALIVE Interest in state " << m_state << std::endl;
+    return;
+  }
   Name interestName = Name("/NTORRENT" + m_torrentName.toUri() +
                            "/ALIVE" + m_ownRoutablePrefix.toUri());
 
-  shared_ptr<Interest> i = make_shared<Interest>(interestName);
+  Interest interest(interestName);
+  // every response is a new sample, a cached one would not spread the peers
+  interest.setMustBeFresh(true);
 
-  // Create and set the LINK object
-  Link link(interestName, { {1, iter->getRecordName()} });
-  m_keyChain->sign(link, signingWithSha256());
-  Block linkWire = link.wireEncode();
+  m_state = EXCHANGING;
+  m_aliveAttempts = 0;
+  expressAliveInterest(interest, iter->getRecordName());
+}
 
-  i->setLink(linkWire);
+void
+UpdateHandler::expressAliveInterest(const Interest& interest, const Name& routablePrefix)
+{
+  Interest i(interest);
 
-  m_face->expressInterest(*i, bind(&UpdateHandler::decodeDataPacketContent, this, _1, _2),
-                          bind(&UpdateHandler::tryNextRoutablePrefix, this, _1));
-  m_face->processEvents(time::milliseconds(-1));
+  // Create and set the LINK object
+  Link link(i.getName(), { {1, routablePrefix} });
+  Signer::getDefault().sign(link);
+  i.setLink(link.wireEncode());
+  i.refreshNonce();
+
+  ++m_aliveAttempts;
+  m_pendingInterest =
+    m_face->expressInterest(i,
+                            bind(&UpdateHandler::onAliveData, this, _1, _2),
+                            [this] (const Interest& interest, const lp::Nack&) {
+                              tryNextRoutablePrefix(interest);
+                            },
+                            bind(&UpdateHandler::tryNextRoutablePrefix, this, _1));
+}
+
+void
+UpdateHandler::onAliveData(const Interest& interest, const Data& data)
+{
+  m_pendingInterest = nullptr;
+  try {
+    this->decodeDataPacketContent(interest, data);
+  }
+  catch (const tlv::Error& e) {
+    // nothing may be thrown into the event loop of the face, the exchange goes on through the
+    // next prefix instead, and no other one is started meanwhile
+    LOG_ERROR << "Malformed ALIVE data packet " << data.getName() << ": " << e.what()
+              << std::endl;
+    m_aliveRetryEvent = m_scheduler.scheduleEvent(ALIVE_RETRY_DELAY, [this, interest] {
+      this->tryNextRoutablePrefix(interest);
+    });
+    return;
+  }
+  m_state = IDLE;
 }
 
 shared_ptr<Data>
@@ -53,79 +128,243 @@ UpdateHandler::createDataPacket(const Name& name)
   // Parse the sender's routable prefix contained in the name
   Name sendersRoutablePrefix = name.getSubName(2 + m_torrentName.size());
 
-  if (m_statsTable->find(sendersRoutablePrefix) == m_statsTable->end()) {
-    m_statsTable->insert(sendersRoutablePrefix);
+  expireStalePeers();
+  // the sender is alive, but we know nothing about its success rate yet
+  auto sender = m_statsTable->find(sendersRoutablePrefix);
+  if (m_statsTable->end() != sender) {
+    sender->refresh(time::steady_clock::now());
+    if (m_onPeerAlive) {
+      m_onPeerAlive(sendersRoutablePrefix);
+    }
+  }
+  else {
+    mergePeer(PeerEntry{sendersRoutablePrefix, time::milliseconds::zero(), 0});
   }
 
+  // the sender is not told about itself
+  auto peers = samplePeers(MAX_NUM_OF_ENCODED_NAMES, sendersRoutablePrefix);
+
   shared_ptr<Data> data = make_shared<Data>(name);
 
   EncodingEstimator estimator;
-  size_t estimatedSize = encodeContent(estimator);
+  size_t estimatedSize = encodeContent(estimator, peers);
 
   EncodingBuffer buffer(estimatedSize, 0);
-  encodeContent(buffer);
+  encodeContent(buffer, peers);
 
   data->setContentType(tlv::ContentType_Blob);
   data->setContent(buffer.block());
+  data->setFreshnessPeriod(ALIVE_FRESHNESS_PERIOD);
 
   return data;
 }
 
 template<encoding::Tag TAG>
 size_t
-UpdateHandler::encodeContent(EncodingImpl<TAG>& encoder) const
+UpdateHandler::encodeContent(EncodingImpl<TAG>& encoder,
+                             const std::vector<StatsTable::iterator>& peers) const
 {
   // Content ::= CONTENT-TYPE TLV-LENGTH
-  //             RoutableName+
+  //             PeerEntry*
+
+  // PeerEntry ::= PEER-ENTRY-TYPE TLV-LENGTH
+  //               Name
+  //               Age
+  //               SuccessRate
+
+  // Age ::= PEER-AGE-TYPE TLV-LENGTH
+  //         nonNegativeInteger (milliseconds since the prefix was last seen alive)
 
-  // RoutableName ::= NAME-TYPE TLV-LENGTH
-  //                  Name
+  // SuccessRate ::= PEER-SUCCESS-RATE-TYPE TLV-LENGTH
+  //                 nonNegativeInteger (per mille)
 
+  auto now = time::steady_clock::now();
   size_t totalLength = 0;
-  // Encode the names of the first five entries of the stats table
-  uint32_t namesEncoded = 0;
-  for (const auto& entry : *m_statsTable) {
-    if (namesEncoded >= MAX_NUM_OF_ENCODED_NAMES) {
-      break;
-    }
-    size_t nameLength = 0;
-    nameLength += entry.getRecordName().wireEncode(encoder);
-    totalLength += nameLength;
-    ++namesEncoded;
+  for (auto peer = peers.rbegin(); peer != peers.rend(); ++peer) {
+    const StatsTableRecord& record = **peer;
+    auto age = time::duration_cast<time::milliseconds>(now - record.getRecordLastSeen());
+
+    size_t entryLength = 0;
+    entryLength += prependNonNegativeIntegerBlock(encoder, PEER_SUCCESS_RATE_TYPE,
+                                                  std::lround(getSuccessRate(record) * 1000));
+    entryLength += prependNonNegativeIntegerBlock(encoder, PEER_AGE_TYPE,
+                                                  std::max<int64_t>(age.count(), 0));
+    entryLength += record.getRecordName().wireEncode(encoder);
+    entryLength += encoder.prependVarNumber(entryLength);
+    entryLength += encoder.prependVarNumber(PEER_ENTRY_TYPE);
+    totalLength += entryLength;
   }
   totalLength += encoder.prependVarNumber(totalLength);
   totalLength += encoder.prependVarNumber(tlv::Content);
   return totalLength;
 }
 
+std::vector<UpdateHandler::PeerEntry>
+UpdateHandler::decodePeerEntries(const Block& content)
+{
+  std::vector<PeerEntry> peers;
+  content.parse();
+  for (auto element = content.elements_begin(); element != content.elements_end(); ++element) {
+    PeerEntry peer{Name(), time::milliseconds::zero(), 0};
+    if (tlv::Name == element->type()) {
+      peer.prefix.wireDecode(*element);
+    }
+    else if (PEER_ENTRY_TYPE == element->type()) {
+      element->parse();
+      const auto& fields = element->elements();
+      if (3 != fields.size() || tlv::Name != fields[0].type() ||
+          PEER_AGE_TYPE != fields[1].type() || PEER_SUCCESS_RATE_TYPE != fields[2].type()) {
+        BOOST_THROW_EXCEPTION(Error("Malformed peer entry"));
+      }
+      peer.prefix.wireDecode(fields[0]);
+      peer.age = time::milliseconds(readNonNegativeInteger(fields[1]));
+      peer.successRate = std::min(readNonNegativeInteger(fields[2]) / 1000.0, 1.0);
+    }
+    else {
+      // skip what a newer peer may have added
+      continue;
+    }
+    if (peer.prefix.empty()) {
+      BOOST_THROW_EXCEPTION(Error("Empty routable name was received"));
+    }
+    peers.push_back(peer);
+  }
+  return peers;
+}
+
 void
 UpdateHandler::decodeDataPacketContent(const Interest& interest, const Data& data)
 {
-  // Content ::= CONTENT-TYPE TLV-LENGTH
-  //             RoutableName+
-
-  // RoutableName ::= NAME-TYPE TLV-LENGTH
-  //                  Name
-
   LOG_INFO << "ALIVE data packet received: " << data.getName() << std::endl;
 
   if (data.getContentType() != tlv::ContentType_Blob) {
       BOOST_THROW_EXCEPTION(Error("Expected Content Type Blob"));
   }
 
-  const Block& content = data.getContent();
-  content.parse();
+  // the peer answered through the prefix of the forwarding hint
+  if (interest.hasLink()) {
+    auto record = m_statsTable->find(interest.getLink().getDelegations().begin()->second);
+    if (m_statsTable->end() != record) {
+      record->refresh(time::steady_clock::now());
+      if (m_onPeerAlive) {
+        m_onPeerAlive(record->getRecordName());
+      }
+    }
+  }
 
-  // Decode the names (maintain their ordering)
-  for (auto element = content.elements_end() - 1; element != content.elements_begin() - 1; element--) {
-    element->parse();
-    Name name(*element);
-    if (name.empty()) {
-      BOOST_THROW_EXCEPTION(Error("Empty routable name was received"));
+  // Merge the peers in the order they were advertised, the highest scored first
+  for (const auto& peer : decodePeerEntries(data.getContent())) {
+    if (peer.age < PEER_LIFETIME) {
+      mergePeer(peer);
     }
-    if (m_statsTable->find(name) == m_statsTable->end()) {
-      m_statsTable->insert(name);
+  }
+  expireStalePeers();
+}
+
+std::vector<StatsTable::iterator>
+UpdateHandler::samplePeers(size_t count, const Name& excluded)
+{
+  // Efraimidis and Spirakis: the records with the largest u^(1/w), for u uniform in (0, 1] and
+  // w the score of the record, are a weighted random sample without replacement. log(u) / w
+  // keeps the same order without underflowing.
+  std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  std::vector<std::pair<double, StatsTable::iterator>> keys;
+  keys.reserve(m_statsTable->size());
+  for (auto i = m_statsTable->begin(); i != m_statsTable->end(); ++i) {
+    if (i->getRecordName() == excluded) {
+      continue;
     }
+    double u = 1.0 - distribution(m_randomGenerator);
+    keys.emplace_back(std::log(u) / getScore(*i), i);
+  }
+  count = std::min(count, keys.size());
+  auto byKey = [] (const std::pair<double, StatsTable::iterator>& left,
+                   const std::pair<double, StatsTable::iterator>& right) {
+    return left.first > right.first;
+  };
+  std::partial_sort(keys.begin(), keys.begin() + count, keys.end(), byKey);
+
+  std::vector<StatsTable::iterator> peers;
+  peers.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    peers.push_back(keys[i].second);
+  }
+  std::stable_sort(peers.begin(), peers.end(),
+                   [] (StatsTable::iterator left, StatsTable::iterator right) {
+                     return getScore(*left) > getScore(*right);
+                   });
+  return peers;
+}
+
+StatsTable::iterator
+UpdateHandler::selectPeer()
+{
+  auto peers = samplePeers(1);
+  return peers.empty() ? m_statsTable->end() : peers.front();
+}
+
+void
+UpdateHandler::mergePeer(const PeerEntry& peer)
+{
+  if (peer.prefix == m_ownRoutablePrefix) {
+    return;
+  }
+  auto lastSeen = time::steady_clock::now() - peer.age;
+  auto record = m_statsTable->find(peer.prefix);
+  if (m_statsTable->end() != record) {
+    record->refresh(lastSeen);
+    if (!record->isRecordMeasured()) {
+      record->setRecordAdvertisedSuccessRate(peer.successRate);
+      m_statsTable->update(record);
+    }
+    if (m_onPeerAlive) {
+      m_onPeerAlive(peer.prefix);
+    }
+    return;
+  }
+
+  if (m_statsTable->size() >= MAX_NUM_OF_PEERS) {
+    // Evict the lowest scored record, the stalest one among equals, unless the new prefix does
+    // not score higher. The records with outstanding Interests are kept.
+    auto evicted = m_statsTable->end();
+    for (auto i = m_statsTable->begin(); i != m_statsTable->end(); ++i) {
+      if (i->getRecordPendingInterests() > 0) {
+        continue;
+      }
+      if (m_statsTable->end() == evicted || getScore(*i) < getScore(*evicted) ||
+          (getScore(*i) == getScore(*evicted) &&
+           i->getRecordLastSeen() < evicted->getRecordLastSeen())) {
+        evicted = i;
+      }
+    }
+    if (m_statsTable->end() == evicted ||
+        getScore(*evicted) >= std::max(peer.successRate, MIN_PEER_SCORE)) {
+      return;
+    }
+    Name evictedPrefix = evicted->getRecordName();
+    m_statsTable->erase(evictedPrefix);
+    if (m_onPeerRemoved) {
+      m_onPeerRemoved(evictedPrefix);
+    }
+  }
+
+  m_statsTable->insert(peer.prefix);
+  record = m_statsTable->find(peer.prefix);
+  record->setRecordLastSeen(lastSeen);
+  record->setRecordAdvertisedSuccessRate(peer.successRate);
+  m_statsTable->update(record);
+  if (m_onPeerAlive) {
+    m_onPeerAlive(peer.prefix);
+  }
+}
+
+void
+UpdateHandler::expireStalePeers()
+{
+  size_t nExpired = m_statsTable->eraseStale(time::steady_clock::now() - PEER_LIFETIME,
+                                             m_onPeerRemoved);
+  if (nExpired > 0) {
+    LOG_DEBUG << "Expired " << nExpired << " stale routable prefixes" << std::endl;
   }
 }
 
@@ -135,8 +374,11 @@ UpdateHandler::needsUpdate()
   if (m_statsTable->size() < MIN_NUM_OF_ROUTABLE_NAMES) {
     return true;
   }
+  // a prefix that falls silent stops counting as its throughput decays, whatever its past
+  auto now = time::steady_clock::now();
   for (auto i = m_statsTable->begin(); i != m_statsTable->end(); i++) {
-    if (i->getRecordSuccessRate() >= 0.5) {
+    if (i->isRecordMeasured() && i->getRecordEwmaSuccessRate() >= 0.5 &&
+        i->getRecordThroughput(now) >= MIN_PEER_THROUGHPUT) {
       return false;
     }
   }
@@ -151,23 +393,50 @@ UpdateHandler::learnOwnRoutablePrefix()
 
   // parse the first contained routable prefix and set it as the ownRoutablePrefix
   auto prefixReceived = [this] (const Interest& interest, const Data& data) {
-    const Block& content = data.getContent();
-    content.parse();
-
-    auto element = content.elements_begin();
-    element->parse();
-    Name ownRoutablePrefix(*element);
+    m_pendingInterest = nullptr;
+    Name ownRoutablePrefix;
+    try {
+      const Block& content = data.getContent();
+      content.parse();
+
+      auto element = content.elements_begin();
+      if (content.elements_end() == element) {
+        this->onLearnOwnRoutablePrefixFailed();
+        return;
+      }
+      element->parse();
+      ownRoutablePrefix.wireDecode(*element);
+    }
+    catch (const tlv::Error& e) {
+      LOG_ERROR << "Malformed routable prefixes: " << e.what() << std::endl;
+      this->onLearnOwnRoutablePrefixFailed();
+      return;
+    }
     m_ownRoutablePrefix = ownRoutablePrefix;
+    m_learnRetryDelay = INITIAL_LEARN_RETRY_DELAY;
+    m_state = IDLE;
   };
 
-  auto prefixRetrievalFailed = [this] (const Interest&) {
-    LOG_ERROR << "Own Routable Prefix Retrieval Failed. Trying again." << std::endl;
-    // TODO(Spyros): This could lead to an infinite loop. Figure out something better...
-    this->learnOwnRoutablePrefix();
-  };
+  m_state = LEARNING_OWN_PREFIX;
+  m_pendingInterest =
+    m_face->expressInterest(i, prefixReceived,
+                            [this] (const Interest&, const lp::Nack&) {
+                              this->onLearnOwnRoutablePrefixFailed();
+                            },
+                            [this] (const Interest&) {
+                              this->onLearnOwnRoutablePrefixFailed();
+                            });
+}
 
-  m_face->expressInterest(i, prefixReceived, prefixRetrievalFailed);
-  m_face->processEvents(time::milliseconds(-1));
+void
+UpdateHandler::onLearnOwnRoutablePrefixFailed()
+{
+  m_pendingInterest = nullptr;
+  LOG_ERROR << "Own Routable Prefix Retrieval Failed. Trying again in "
+            << m_learnRetryDelay << std::endl;
+  m_learnRetryEvent = m_scheduler.scheduleEvent(m_learnRetryDelay,
+                                                [this] { this->learnOwnRoutablePrefix(); });
+  m_learnRetryDelay = std::min(m_learnRetryDelay * 2, MAX_LEARN_RETRY_DELAY);
 }
 
 void
@@ -175,7 +444,7 @@ UpdateHandler::onInterestReceived(const InterestFilter& filter, const Interest&
 {
   LOG_INFO << "Interest Received: " << interest.getName().toUri() << std::endl;
   shared_ptr<Data> data = this->createDataPacket(interest.getName());
-  m_keyChain->sign(*data, signingWithSha256());
+  Signer::getDefault().sign(*data);
   m_face->put(*data);
 }
 
@@ -185,18 +454,26 @@ UpdateHandler::onRegisterFailed(const Name& prefix, const std::string& reason)
  LOG_ERROR << "ERROR: Failed to register prefix \""
             << prefix << "\" in local hub's daemon (" << reason << ")"
             << std::endl;
-  m_face->shutdown();
+  // the face is shared with the transfer of the torrent, which goes on without the handler
+  m_registeredPrefix = nullptr;
 }
 
 void
 UpdateHandler::tryNextRoutablePrefix(const Interest& interest)
 {
-  Link link(interest.getLink());
-  const Name& name = link.getDelegations().begin()->second;
+  m_pendingInterest = nullptr;
+  if (m_aliveAttempts >= m_statsTable->size()) {
+    LOG_ERROR << "ALIVE Interest failed through every routable prefix: " << interest.getName()
+              << std::endl;
+    m_state = IDLE;
+    return;
+  }
+
+  Name name = interest.getLink().getDelegations().begin()->second;
   auto iter = m_statsTable->find(name);
 
   if (iter != m_statsTable->end()) {
-    if (iter + 1 == m_statsTable->end()) {
+    if (std::next(iter) == m_statsTable->end()) {
       iter = m_statsTable->begin();
     }
     else {
@@ -207,19 +484,7 @@ UpdateHandler::tryNextRoutablePrefix(const Interest& interest)
     iter = m_statsTable->begin();
   }
 
-  shared_ptr<Interest> newInterest = make_shared<Interest>(interest);
-
-  link.removeDelegation(name);
-  link.addDelegation(1, iter->getRecordName());
-
-  m_keyChain->sign(link, signingWithSha256());
-  Block block = link.wireEncode();
-
-  newInterest->setLink(block);
-
-  m_face->expressInterest(*newInterest, bind(&UpdateHandler::decodeDataPacketContent, this, _1, _2),
-                          bind(&UpdateHandler::tryNextRoutablePrefix, this, _1));
-  m_face->processEvents(time::milliseconds(-1));
+  expressAliveInterest(interest, iter->getRecordName());
 }
 
 } // namespace ntorrent
@@ -26,12 +26,39 @@
 
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/interest.hpp>
-#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/util/random.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+#include <ndn-cxx/util/scheduler-scoped-event-id.hpp>
+
+#include <random>
+#include <vector>
 
 namespace ndn {
 namespace ntorrent {
 
-class UpdateHandler {
+/**
+ * @brief Exchanges routable prefixes with other peers through "ALIVE" Interests
+ *
+ * The handler never blocks: every step is started by a callback of the face it shares with the
+ * application, or by an event of a scheduler on the io_service of that face, so it can run
+ * alongside the transfer of the torrent. It moves between the following states:
+ *
+ *   LEARNING_OWN_PREFIX  waiting for the local NFD to tell the own routable prefix, the request
+ *                        is retried with an exponential backoff until it succeeds
+ *   IDLE                 ready to send an "ALIVE" Interest
+ *   EXCHANGING           an "ALIVE" Interest is outstanding, if it fails it is retried through
+ *                        the next prefix of the stats table, at most once per prefix, and so
+ *                        is an Interest whose response cannot be decoded, after a short delay
+ *
+ * The peers are exchanged by gossip: the response to an "ALIVE" Interest carries a random
+ * sample of the stats table, weighted by the success rate of each prefix, along with how long
+ * ago each prefix was seen alive and its success rate. The receiver merges the sample into its
+ * table, which is bounded to MAX_NUM_OF_PEERS prefixes by evicting the lowest scored ones, and
+ * the prefixes not seen alive for PEER_LIFETIME are expired. As each peer hands out a different
+ * sample, the prefixes that perform well spread through the swarm without every peer asking for
+ * the same few.
+ */
+class UpdateHandler : noncopyable {
 public:
   class Error : public tlv::Error
   {
@@ -43,8 +70,7 @@ public:
     }
   };
 
-  UpdateHandler(Name torrentName, shared_ptr<KeyChain> keyChain,
-                shared_ptr<StatsTable> statsTable, shared_ptr<Face> face);
+  UpdateHandler(Name torrentName, shared_ptr<StatsTable> statsTable, shared_ptr<Face> face);
 
   ~UpdateHandler();
 
@@ -52,6 +78,10 @@ public:
    * @brief Send an ALIVE Interest
    * @param routablePrefix The routable prefix to be included in the LINK object attached
    *        to this Interest
+   *
+   * Does nothing unless the handler is IDLE, i.e., the own routable prefix is known and no other
+   * "ALIVE" Interest is outstanding. Returns immediately, the response is processed by the
+   * event loop of the face.
    */
   void
   sendAliveInterest(StatsTable::iterator iter);
@@ -60,19 +90,96 @@ public:
    * @brief Check whether we need to send out an "ALIVE" interest
    * @return True if an "ALIVE" interest should be sent out, otherwise false
    *
-   * Returns true if we have less than MIN_NUM_OF_ROUTABLE_NAMES prefixes in the stats table
-   * or all the routable prefixes has success rate less than 0.5. Otherwise, it returns false
+   * Returns true if we have less than MIN_NUM_OF_ROUTABLE_NAMES prefixes in the stats table,
+   * or if no routable prefix both answered at least half of its recent Interests and still
+   * delivers data, as told by its decaying throughput. Otherwise, it returns false
    */
   bool
   needsUpdate();
 
+  typedef std::function<void(const Name& routablePrefix)> PeerCallback;
+
+  /**
+   * @brief Set the callbacks told about the peers of the stats table
+   * @param onPeerAlive Called when a prefix is inserted into the table or seen alive again
+   * @param onPeerRemoved Called when a prefix is evicted from the table or expired
+   */
+  void
+  setPeerCallbacks(const PeerCallback& onPeerAlive, const PeerCallback& onPeerRemoved);
+
+  /**
+   * @brief Pick the prefix through which to send the next "ALIVE" Interest
+   * @return An iterator to a random record of the stats table, weighted by its score, or the
+   *         end of the table if it is empty
+   */
+  StatsTable::iterator
+  selectPeer();
+
   enum {
     // Maximum number of names to be encoded as a response to an "ALIVE" Interest
     MAX_NUM_OF_ENCODED_NAMES = 5,
     // Minimum number of routable prefixes that the peer would like to have
     MIN_NUM_OF_ROUTABLE_NAMES = 5,
+    // Maximum number of routable prefixes kept in the stats table through the exchange
+    MAX_NUM_OF_PEERS = 64,
+  };
+
+  enum {
+    PEER_ENTRY_TYPE        = 150,
+    PEER_AGE_TYPE          = 151,
+    PEER_SUCCESS_RATE_TYPE = 152
   };
 
+  /**
+   * @brief A routable prefix as advertised in the response to an "ALIVE" Interest
+   */
+  struct PeerEntry {
+    Name prefix;
+    // how long before the response the prefix was last seen alive
+    time::milliseconds age;
+    double successRate;
+  };
+
+  /**
+   * @brief Decode the peer entries of the content of a response to an "ALIVE" Interest
+   * @throws Error if an entry is malformed
+   *
+   * A bare Name stands for a prefix seen alive just now with an unknown success rate.
+   */
+  static std::vector<PeerEntry>
+  decodePeerEntries(const Block& content);
+
+  /**
+   * @brief The time after which a prefix that has not been seen alive is expired
+   */
+  static const time::milliseconds PEER_LIFETIME;
+
+  enum State {
+    LEARNING_OWN_PREFIX,
+    IDLE,
+    EXCHANGING
+  };
+
+  /**
+   * @brief Get the state of the handler
+   */
+  State
+  getState() const;
+
+  /**
+   * @brief The delay before the first retry of learning the own routable prefix, doubled after
+   *        each failure up to MAX_LEARN_RETRY_DELAY
+   */
+  static const time::milliseconds INITIAL_LEARN_RETRY_DELAY;
+
+  static const time::milliseconds MAX_LEARN_RETRY_DELAY;
+
+  /**
+   * @brief The delay before an "ALIVE" Interest whose response could not be decoded is sent
+   *        again through the next prefix of the stats table
+   */
+  static const time::milliseconds ALIVE_RETRY_DELAY;
+
 protected:
   // Used for testing purposes
   const Name&
@@ -81,7 +188,28 @@ protected:
 private:
   template<encoding::Tag TAG>
   size_t
-  encodeContent(EncodingImpl<TAG>& encoder) const;
+  encodeContent(EncodingImpl<TAG>& encoder,
+                const std::vector<StatsTable::iterator>& peers) const;
+
+  /**
+   * @brief Pick up to @p count distinct records at random, weighted by their score, leaving out
+   *        the record of @p excluded
+   * @return The picked records, the highest scored first
+   */
+  std::vector<StatsTable::iterator>
+  samplePeers(size_t count, const Name& excluded = Name());
+
+  /**
+   * @brief Insert or refresh an advertised prefix, keeping the table within MAX_NUM_OF_PEERS
+   */
+  void
+  mergePeer(const PeerEntry& peer);
+
+  /**
+   * @brief Erase the records of the stats table not seen alive for PEER_LIFETIME
+   */
+  void
+  expireStalePeers();
 
   void
   onInterestReceived(const InterestFilter& filter, const Interest& interest);
@@ -90,7 +218,8 @@ private:
   onRegisterFailed(const Name& prefix, const std::string& reason);
 
   /**
-   * @brief Encode the first MAX_NUM_OF_ENCODED_NAMES prefixes of the table into a data packet
+   * @brief Encode a sample of at most MAX_NUM_OF_ENCODED_NAMES prefixes of the table, other
+   *        than the prefix of the sender of the Interest, into a data packet
    * @param name The name of the data packet
    * @return A shared pointer to the created data packet
    *
@@ -100,7 +229,7 @@ private:
 
   /**
    * @brief Given a received data packet, decode the contained routable name prefixes
-   *        and insert them to the table (if not already there)
+   *        and merge them into the table
    * @param interest The interest that retrieved the data packet
    * @param data A shared pointer to the received data packet
    *
@@ -115,35 +244,97 @@ private:
   void
   learnOwnRoutablePrefix();
 
+  /**
+   * @brief Schedule the next attempt to learn the own routable prefix
+   */
+  void
+  onLearnOwnRoutablePrefixFailed();
+
+  /**
+   * @brief Express @p interest through @p routablePrefix
+   */
+  void
+  expressAliveInterest(const Interest& interest, const Name& routablePrefix);
+
+  void
+  onAliveData(const Interest& interest, const Data& data);
+
+  /**
+   * @brief Retry a failed ALIVE Interest through the next prefix of the stats table, unless
+   *        every prefix has been tried
+   */
   void
   tryNextRoutablePrefix(const Interest& interest);
 
 private:
   Name m_torrentName;
-  shared_ptr<KeyChain> m_keyChain;
   shared_ptr<StatsTable> m_statsTable;
   shared_ptr<Face> m_face;
   Name m_ownRoutablePrefix;
+  State m_state;
+  // The delay before the next attempt to learn the own routable prefix
+  time::milliseconds m_learnRetryDelay;
+  // The number of prefixes the outstanding ALIVE Interest has been sent through
+  size_t m_aliveAttempts;
+  // The outstanding Interest and the registered prefix, removed with the handler
+  const PendingInterestId* m_pendingInterest;
+  const RegisteredPrefixId* m_registeredPrefix;
+  util::scheduler::Scheduler m_scheduler;
+  util::scheduler::ScopedEventId m_learnRetryEvent;
+  util::scheduler::ScopedEventId m_aliveRetryEvent;
+  std::mt19937 m_randomGenerator;
+  PeerCallback m_onPeerAlive;
+  PeerCallback m_onPeerRemoved;
 };
 
 inline
-UpdateHandler::UpdateHandler(Name torrentName, shared_ptr<KeyChain> keyChain,
-                             shared_ptr<StatsTable> statsTable, shared_ptr<Face> face)
+UpdateHandler::UpdateHandler(Name torrentName, shared_ptr<StatsTable> statsTable,
+                             shared_ptr<Face> face)
 : m_torrentName(torrentName)
-, m_keyChain(keyChain)
 , m_statsTable(statsTable)
 , m_face(face)
+, m_state(LEARNING_OWN_PREFIX)
+, m_learnRetryDelay(INITIAL_LEARN_RETRY_DELAY)
+, m_aliveAttempts(0)
+, m_pendingInterest(nullptr)
+, m_registeredPrefix(nullptr)
+, m_scheduler(face->getIoService())
+, m_learnRetryEvent(m_scheduler)
+, m_aliveRetryEvent(m_scheduler)
+, m_randomGenerator(random::generateWord32())
 {
   this->learnOwnRoutablePrefix();
-  m_face->setInterestFilter(Name("/NTORRENT" + m_torrentName.toUri() + "/ALIVE"),
-                            bind(&UpdateHandler::onInterestReceived, this, _1, _2),
-                            RegisterPrefixSuccessCallback(),
-                            bind(&UpdateHandler::onRegisterFailed, this, _1, _2));
+  m_registeredPrefix =
+    m_face->setInterestFilter(Name("/NTORRENT" + m_torrentName.toUri() + "/ALIVE"),
+                              bind(&UpdateHandler::onInterestReceived, this, _1, _2),
+                              RegisterPrefixSuccessCallback(),
+                              bind(&UpdateHandler::onRegisterFailed, this, _1, _2));
 }
 
 inline
 UpdateHandler::~UpdateHandler()
 {
+  // the face outlives the handler, none of its callbacks may be left pointing to it
+  if (nullptr != m_pendingInterest) {
+    m_face->removePendingInterest(m_pendingInterest);
+  }
+  if (nullptr != m_registeredPrefix) {
+    m_face->unsetInterestFilter(m_registeredPrefix);
+  }
+}
+
+inline void
+UpdateHandler::setPeerCallbacks(const PeerCallback& onPeerAlive,
+                                const PeerCallback& onPeerRemoved)
+{
+  m_onPeerAlive = onPeerAlive;
+  m_onPeerRemoved = onPeerRemoved;
+}
+
+inline UpdateHandler::State
+UpdateHandler::getState() const
+{
+  return m_state;
 }
 
 inline const Name&
@@ -0,0 +1,264 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef INCLUDED_UTIL_CHAIN_BUILDER_H
+#define INCLUDED_UTIL_CHAIN_BUILDER_H
+
+#include "util/signer.hpp"
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/name.hpp>
+#include <ndn-cxx/security/digest-sha256.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+namespace ndn {
+namespace ntorrent {
+
+/**
+ * @brief Build a chain of segments in which each segment points to the full name of the next
+ *
+ * As the full name of a segment includes its implicit digest, the segments of a chain have to be
+ * signed from the last one to the initial one. Instead of holding the whole chain in memory,
+ * the builder spills each appended segment, unsigned, to a temporary file, and build() reads
+ * them back in reverse order, linking, signing and passing each one to a sink. Only the most
+ * recently appended segment and the offsets of the spilled ones are kept in memory, so a chain
+ * of a single segment never touches the disk.
+ *
+ * @tparam Segment A default constructible Data type with finalize(), which encodes its content,
+ *         and wireDecode() (e.g., TorrentFile or FileManifest)
+ */
+template<typename Segment>
+class ChainBuilder : noncopyable {
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /**
+   * @brief Callback that sets the pointer of a segment to the full name of the next one
+   */
+  typedef std::function<void(Segment&, const Name&)> Linker;
+
+  /**
+   * @brief Callback that receives each segment once it is finalized and signed
+   */
+  typedef std::function<void(const Data&)> Sink;
+
+  /**
+   * @brief Create a builder that spills the segments to a unique file of the temp directory
+   */
+  explicit
+  ChainBuilder(const Linker& link);
+
+  /**
+   * @brief Create a builder that spills the segments to the file at @p spillPath
+   */
+  ChainBuilder(const Linker& link, const std::string& spillPath);
+
+  /**
+   * @brief Remove the spill file
+   */
+  ~ChainBuilder();
+
+  /**
+   * @brief Append @p segment to the end of the chain
+   * @throws Error if the previous segment cannot be spilled
+   */
+  void
+  append(Segment segment);
+
+  /**
+   * @brief Return the number of segments appended to the chain
+   */
+  size_t
+  size() const;
+
+  /**
+   * @brief Link, finalize and sign the segments from the last one to the initial one, passing
+   *        each to @p sink, and clear the chain
+   * @return The full name of the initial segment, or an empty name if the chain is empty
+   * @throws Error if a spilled segment cannot be read back
+   */
+  Name
+  build(const Sink& sink);
+
+private:
+  void
+  spill(Segment& segment);
+
+  void
+  sign(Segment& segment, const Name& next, const Sink& sink);
+
+private:
+  Linker m_link;
+  std::string m_spillPath;
+  boost::filesystem::ofstream m_spill;
+  // The offsets of the spilled segments in the spill file
+  std::vector<uint64_t> m_offsets;
+  uint64_t m_spillSize;
+  // The last appended segment, which is kept in memory
+  Segment m_last;
+  bool m_hasLast;
+};
+
+template<typename Segment>
+inline
+ChainBuilder<Segment>::ChainBuilder(const Linker& link)
+  : ChainBuilder(link,
+                 (boost::filesystem::temp_directory_path() /
+                  boost::filesystem::unique_path("ntorrent-chain-%%%%-%%%%-%%%%")).string())
+{
+}
+
+template<typename Segment>
+inline
+ChainBuilder<Segment>::ChainBuilder(const Linker& link, const std::string& spillPath)
+  : m_link(link)
+  , m_spillPath(spillPath)
+  , m_spillSize(0)
+  , m_hasLast(false)
+{
+}
+
+template<typename Segment>
+inline
+ChainBuilder<Segment>::~ChainBuilder()
+{
+  m_spill.close();
+  boost::system::error_code ec;
+  boost::filesystem::remove(m_spillPath, ec);
+}
+
+template<typename Segment>
+inline void
+ChainBuilder<Segment>::append(Segment segment)
+{
+  if (m_hasLast) {
+    spill(m_last);
+  }
+  m_last = std::move(segment);
+  m_hasLast = true;
+}
+
+template<typename Segment>
+inline size_t
+ChainBuilder<Segment>::size() const
+{
+  return m_offsets.size() + (m_hasLast ? 1 : 0);
+}
+
+template<typename Segment>
+inline Name
+ChainBuilder<Segment>::build(const Sink& sink)
+{
+  Name next;
+  if (!m_hasLast) {
+    return next;
+  }
+  sign(m_last, next, sink);
+  next = m_last.getFullName();
+  m_last = Segment();
+  m_hasLast = false;
+
+  if (!m_offsets.empty()) {
+    m_spill.close();
+    boost::filesystem::ifstream is(m_spillPath, boost::filesystem::ifstream::binary);
+    // each record ends where the next one starts, so it is read by its known size rather than
+    // with Block::fromStream, which is bounded by MAX_NDN_PACKET_SIZE
+    uint64_t end = m_spillSize;
+    for (auto it = m_offsets.rbegin(); it != m_offsets.rend(); ++it) {
+      auto wire = make_shared<Buffer>(end - *it);
+      if (!is.seekg(*it) || !is.read(reinterpret_cast<char*>(wire->buf()), wire->size())) {
+        BOOST_THROW_EXCEPTION(Error("IO Error when reading " + m_spillPath));
+      }
+      end = *it;
+      Segment segment;
+      try {
+        segment.wireDecode(Block(wire));
+      }
+      catch (const tlv::Error& e) {
+        BOOST_THROW_EXCEPTION(Error("Invalid segment in " + m_spillPath + ": " + e.what()));
+      }
+      sign(segment, next, sink);
+      next = segment.getFullName();
+    }
+    is.close();
+    m_offsets.clear();
+    m_spillSize = 0;
+    boost::system::error_code ec;
+    boost::filesystem::remove(m_spillPath, ec);
+  }
+  return next;
+}
+
+template<typename Segment>
+inline void
+ChainBuilder<Segment>::spill(Segment& segment)
+{
+  if (!m_spill.is_open()) {
+    m_spill.open(m_spillPath, boost::filesystem::ofstream::binary |
+                              boost::filesystem::ofstream::trunc);
+  }
+  // The segment is signed once the full name of the next segment is known, until then a
+  // placeholder signature is enough to encode it
+  segment.finalize();
+  segment.setSignature(DigestSha256());
+  segment.setSignatureValue(makeEmptyBlock(tlv::SignatureValue));
+  const Block& wire = segment.wireEncode();
+  m_spill.write(reinterpret_cast<const char*>(wire.wire()), wire.size());
+  if (!m_spill) {
+    BOOST_THROW_EXCEPTION(Error("IO Error when writing to " + m_spillPath));
+  }
+  m_offsets.push_back(m_spillSize);
+  m_spillSize += wire.size();
+}
+
+template<typename Segment>
+inline void
+ChainBuilder<Segment>::sign(Segment& segment, const Name& next, const Sink& sink)
+{
+  if (!next.empty()) {
+    m_link(segment, next);
+  }
+  segment.finalize();
+  Signer::getDefault().sign(segment);
+  sink(segment);
+}
+
+} // namespace ntorrent
+} // namespace ndn
+
+#endif // INCLUDED_UTIL_CHAIN_BUILDER_H
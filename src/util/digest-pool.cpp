@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "util/digest-pool.hpp"
+
+#include "util/signer.hpp"
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <algorithm>
+#include <exception>
+
+namespace ndn {
+namespace ntorrent {
+
+// Batches smaller than this are not worth handing to the workers
+static const size_t MIN_PACKETS_PER_TASK = 8;
+
+static void
+encodeRange(const std::vector<DigestPool::Job>& jobs,
+            std::vector<DigestPool::Packet>& packets,
+            size_t begin,
+            size_t end)
+{
+  for (size_t i = begin; i < end; ++i) {
+    const auto& job = jobs[i];
+    Data d(job.name);
+    d.setContent(encoding::makeBinaryBlock(tlv::Content,
+                                           job.contentBegin,
+                                           job.contentEnd - job.contentBegin));
+    Signer::signWithSha256(d);
+    // the implicit digest is computed while the packet is hot
+    packets[i].fullName = d.getFullName();
+    packets[i].wire = d.wireEncode();
+  }
+}
+
+DigestPool::DigestPool(size_t nThreads)
+  : m_isStopped(false)
+{
+  m_threads.reserve(nThreads);
+  for (size_t i = 0; i < nThreads; ++i) {
+    m_threads.emplace_back(&DigestPool::run, this);
+  }
+}
+
+DigestPool::~DigestPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopped = true;
+  }
+  m_hasTask.notify_all();
+  for (auto& t : m_threads) {
+    t.join();
+  }
+}
+
+DigestPool&
+DigestPool::getDefault()
+{
+  static DigestPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+  return pool;
+}
+
+std::vector<DigestPool::Packet>
+DigestPool::encode(const std::vector<Job>& jobs)
+{
+  size_t nPackets = jobs.size();
+  // each task fills its own range of the packets, so they are not locked
+  std::vector<Packet> packets(nPackets);
+  // the calling thread takes a share of the batch as well
+  size_t nTasks = std::min(m_threads.size() + 1, nPackets / MIN_PACKETS_PER_TASK);
+  if (nTasks <= 1) {
+    encodeRange(jobs, packets, 0, nPackets);
+    return packets;
+  }
+
+  std::mutex doneMutex;
+  std::condition_variable done;
+  size_t nPending = nTasks - 1;
+  std::exception_ptr error;
+
+  size_t perTask = nPackets / nTasks;
+  size_t taskBegin = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i + 1 < nTasks; ++i) {
+      size_t taskEnd = taskBegin + perTask;
+      m_tasks.emplace_back([=, &jobs, &packets, &doneMutex, &done, &nPending, &error] {
+        std::exception_ptr e;
+        try {
+          encodeRange(jobs, packets, taskBegin, taskEnd);
+        }
+        catch (...) {
+          e = std::current_exception();
+        }
+        std::lock_guard<std::mutex> doneLock(doneMutex);
+        if (e && !error) {
+          error = e;
+        }
+        if (0 == --nPending) {
+          done.notify_one();
+        }
+      });
+      taskBegin = taskEnd;
+    }
+  }
+  m_hasTask.notify_all();
+
+  std::exception_ptr ownError;
+  try {
+    // the remainder of the division goes to the calling thread
+    encodeRange(jobs, packets, taskBegin, nPackets);
+  }
+  catch (...) {
+    ownError = std::current_exception();
+  }
+
+  std::unique_lock<std::mutex> doneLock(doneMutex);
+  done.wait(doneLock, [&nPending] { return 0 == nPending; });
+  if (ownError) {
+    std::rethrow_exception(ownError);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return packets;
+}
+
+void
+DigestPool::run()
+{
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_hasTask.wait(lock, [this] { return m_isStopped || !m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+} // namespace ntorrent
+} // namespace ndn
@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef INCLUDED_UTIL_DIGEST_POOL_H
+#define INCLUDED_UTIL_DIGEST_POOL_H
+
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/name.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ndn {
+namespace ntorrent {
+
+/**
+ * @brief A pool of threads that build packets signed with DigestSha256 and compute their full
+ *        names
+ *
+ * Each packet costs a copy of its content and two SHA-256 computations: one for its DigestSha256
+ * signature and one for the implicit digest of its full name. A job only holds the name of a
+ * packet and the range of its content, so the pool spreads all of this work over its worker
+ * threads and the calling thread, and returns the wire encoding and the full name of each packet,
+ * so that neither is computed again.
+ */
+class DigestPool : noncopyable {
+public:
+  /**
+   * @brief A packet to build: its name and the range of bytes of its content
+   */
+  struct Job {
+    Name           name;
+    const uint8_t* contentBegin;
+    const uint8_t* contentEnd;
+  };
+
+  /**
+   * @brief A packet signed with DigestSha256: its wire encoding and its full name
+   */
+  struct Packet {
+    Block wire;
+    Name  fullName;
+  };
+
+  /**
+   * @brief Create a pool with @p nThreads worker threads
+   *
+   * With no worker threads, batches are processed on the calling thread.
+   */
+  explicit
+  DigestPool(size_t nThreads);
+
+  /**
+   * @brief Stop and join the worker threads
+   */
+  ~DigestPool();
+
+  /**
+   * @brief Return the pool of the process, with a worker for each hardware thread but one
+   */
+  static DigestPool&
+  getDefault();
+
+  /**
+   * @brief Build the packet of each of @p jobs, sign it with DigestSha256 and compute its full
+   *        name
+   * @return The packets, in the order of their jobs
+   *
+   * Blocks until the whole batch is processed, the content of the jobs has to remain valid until
+   * then. If building any packet throws, the first exception is rethrown once the other packets
+   * are processed.
+   */
+  std::vector<Packet>
+  encode(const std::vector<Job>& jobs);
+
+  /**
+   * @brief Return the number of worker threads
+   */
+  size_t
+  getNumThreads() const;
+
+private:
+  typedef std::function<void()> Task;
+
+  void
+  run();
+
+private:
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_hasTask;
+  std::deque<Task> m_tasks;
+  bool m_isStopped;
+};
+
+inline size_t
+DigestPool::getNumThreads() const
+{
+  return m_threads.size();
+}
+
+} // namespace ntorrent
+} // namespace ndn
+
+#endif // INCLUDED_UTIL_DIGEST_POOL_H
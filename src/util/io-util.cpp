@@ -22,14 +22,16 @@
 #include "util/io-util.hpp"
 
 #include "file-manifest.hpp"
+#include "manifest-tree-node.hpp"
 #include "torrent-file.hpp"
 #include "util/logging.hpp"
+#include "util/signer.hpp"
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 
-#include <ndn-cxx/security/key-chain.hpp>
-#include <ndn-cxx/security/signing-helpers.hpp>
+#include <iterator>
+
 
 namespace fs = boost::filesystem;
 
@@ -39,7 +41,9 @@ using std::vector;
 namespace ndn {
 namespace ntorrent {
 
-std::vector<ndn::Data>
+const char* IoUtil::TEMP_FILE_EXTENSION = ".tmp";
+
+std::vector<DigestPool::Packet>
 IoUtil::packetize_file(const fs::path& filePath,
                        const ndn::Name& commonPrefix,
                        size_t dataPacketSize,
@@ -56,7 +60,7 @@ IoUtil::packetize_file(const fs::path& filePath,
   subManifestLength = remainingFileLength < subManifestLength
                     ? remainingFileLength
                     : subManifestLength;
-  vector<ndn::Data> packets;
+  vector<DigestPool::Packet> packets;
   packets.reserve(subManifestLength/dataPacketSize + 1);
   fs::ifstream fs(filePath, fs::ifstream::binary);
   if (!fs) {
@@ -71,30 +75,34 @@ IoUtil::packetize_file(const fs::path& filePath,
     APPROX_BUFFER_SIZE :
     APPROX_BUFFER_SIZE + dataPacketSize - (APPROX_BUFFER_SIZE % dataPacketSize);
   vector<char> file_bytes;
-  file_bytes.reserve(buffer_size);
   size_t bytes_read = 0;
   fs.seekg(start_offset);
   while(fs && bytes_read < subManifestLength && !fs.eof()) {
     // read the file into the buffer
+    file_bytes.resize(buffer_size);
     fs.read(&file_bytes.front(), buffer_size);
     auto read_size = fs.gcount();
     if (fs.bad() || read_size < 0) {
       BOOST_THROW_EXCEPTION(Data::Error("IO Error when reading" + filePath.string()));
     }
     bytes_read += read_size;
-    char *curr_start = &file_bytes.front();
+    auto curr_start = reinterpret_cast<const uint8_t*>(&file_bytes.front());
+    vector<DigestPool::Job> jobs;
+    jobs.reserve(buffer_size / dataPacketSize + 1);
     for (size_t i = 0u; i < buffer_size; i += dataPacketSize) {
-      // Build a packet from the data
+      // the packets are built from the buffer by the digest pool
       Name packetName = commonPrefix;
-      packetName.appendSequenceNumber(packets.size());
-      Data d(packetName);
+      packetName.appendSequenceNumber(packets.size() + jobs.size());
       auto content_length = i + dataPacketSize > buffer_size ? buffer_size - i : dataPacketSize;
-      d.setContent(encoding::makeBinaryBlock(tlv::Content, curr_start, content_length));
+      jobs.push_back(DigestPool::Job{packetName, curr_start, curr_start + content_length});
       curr_start += content_length;
-      // append to the collection
-      packets.push_back(d);
     }
-    file_bytes.clear();
+    // sign all the packets and compute their full names on the digest pool, before the buffer
+    // is reused
+    auto encoded = DigestPool::getDefault().encode(jobs);
+    packets.insert(packets.end(),
+                   std::make_move_iterator(encoded.begin()),
+                   std::make_move_iterator(encoded.end()));
     // recompute the buffer_size
     buffer_size =
       subManifestLength - bytes_read < APPROX_BUFFER_SIZE ?
@@ -105,33 +113,37 @@ IoUtil::packetize_file(const fs::path& filePath,
   }
   fs.close();
   packets.shrink_to_fit();
-  ndn::security::KeyChain key_chain;
-  // sign all the packets
-  for (auto& p : packets) {
-    key_chain.sign(p, signingWithSha256());
-  }
   return packets;
 }
 
+// Write @p data to a temporary file next to @p filename, then move it in place, so that a partially
+// written file is never visible under @p filename.
+static bool
+saveAtomically(const Data& data, const fs::path& filename)
+{
+  fs::path tempFilename = filename;
+  tempFilename += IoUtil::TEMP_FILE_EXTENSION;
+  try {
+    io::save(data, tempFilename.string());
+    fs::rename(tempFilename, filename);
+    return true;
+  }
+  catch (const std::exception& e) {
+    LOG_ERROR << "Failed to write " << filename << ": " << e.what() << std::endl;
+    boost::system::error_code ec;
+    fs::remove(tempFilename, ec);
+    return false;
+  }
+}
+
 bool IoUtil::writeTorrentSegment(const TorrentFile& segment, const std::string& path)
 {
-  // validate that this torrent segment belongs to our torrent
   auto segmentNum = segment.getSegmentNumber();
   // write to disk at path
   if (!fs::exists(path)) {
     fs::create_directories(path);
   }
-  auto filename = path + to_string(segmentNum);
-  // if there is already a file on disk for this torrent segment, determine if we should override
-  if (fs::exists(filename)) {
-    auto segmentOnDisk_ptr = io::load<TorrentFile>(filename);
-    if (nullptr != segmentOnDisk_ptr && *segmentOnDisk_ptr == segment) {
-      return false;
-    }
-  }
-  io::save(segment, filename);
-  // add to collection
-  return true;
+  return saveAtomically(segment, path + to_string(segmentNum));
 }
 
 bool IoUtil::writeFileManifest(const FileManifest& manifest, const std::string& path)
@@ -143,16 +155,31 @@ bool IoUtil::writeFileManifest(const FileManifest& manifest, const std::string&
   if (!fs::exists(filename.parent_path())) {
     boost::filesystem::create_directories(filename.parent_path());
   }
-  // if there is already a file on disk for this file manifest, determine if we should override
-  if (fs::exists(filename)) {
-    auto submanifestOnDisk_ptr = io::load<FileManifest>(filename.string());
-    if (nullptr != submanifestOnDisk_ptr && *submanifestOnDisk_ptr == manifest) {
-      return false;
-    }
+  return saveAtomically(manifest, filename);
+}
+
+std::string
+IoUtil::manifestTreeNodePath(const Name& nodeName, const std::string& path)
+{
+  // .../NTORRENT/<file name>/%00manifest-tree/<level>/<index>
+  Name scheme(SharedConstants::commonPrefix);
+  auto fileName = nodeName.getSubName(1 + scheme.size(),
+                                      nodeName.size() - (4 + scheme.size())).toUri();
+  return path + fileName + "/" + ManifestTreeNode::DIRECTORY_NAME + "/" +
+         to_string(nodeName.get(-2).toSequenceNumber()) + "/" +
+         to_string(nodeName.get(-1).toSequenceNumber());
+}
+
+bool
+IoUtil::writeManifestTreeNode(const ManifestTreeNode& node, const std::string& path)
+{
+  fs::path filename = manifestTreeNodePath(node.getName(), path);
+  if (!fs::exists(filename.parent_path())) {
+    fs::create_directories(filename.parent_path());
   }
-  io::save(manifest, filename.string());
-  return true;
+  return saveAtomically(node, filename);
 }
+
 bool
 IoUtil::writeData(const Data& packet, const FileManifest& manifest, size_t subManifestSize, fs::fstream& os)
 {
@@ -202,8 +229,7 @@ IoUtil::readDataPacket(const Name& packetFullName,
  auto packetName = packetFullName.getSubName(0, packetFullName.size() - 1);
  auto d = make_shared<Data>(packetName);
  d->setContent(encoding::makeBinaryBlock(tlv::Content, &bytes.front(), read_size));
- ndn::security::KeyChain key_chain;
- key_chain.sign(*d, signingWithSha256());
+ Signer::getDefault().sign(*d);
  return d->getFullName() == packetFullName ? d : nullptr;
 }
 
@@ -215,6 +241,9 @@ IoUtil::findType(const Name& name)
       name.get(name.size() - 3).toUri() == "torrent-file") {
     rval = TORRENT_FILE;
   }
+  else if (!name.empty() && ManifestTreeNode::isNodeName(name.getPrefix(-1))) {
+    rval = MANIFEST_TREE_NODE;
+  }
   else if (name.get(name.size() - 2).isSequenceNumber() &&
            name.get(name.size() - 3).isSequenceNumber()) {
     rval = DATA_PACKET;
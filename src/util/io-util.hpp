@@ -22,6 +22,8 @@
 #ifndef INCLUDED_UTIL_IO_UTIL_H
 #define INCLUDED_UTIL_IO_UTIL_H
 
+#include "util/digest-pool.hpp"
+
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 
@@ -40,6 +42,7 @@ namespace ntorrent {
 
 class TorrentFile;
 class FileManifest;
+class ManifestTreeNode;
 
 class IoUtil {
  public:
@@ -51,15 +54,26 @@ class IoUtil {
     TORRENT_FILE,
     FILE_MANIFEST,
     DATA_PACKET,
+    MANIFEST_TREE_NODE,
     UNKNOWN
   };
 
+  /*
+   * The extension of the temporary files used to write segments atomically, these files are
+   * ignored when loading a directory
+   */
+  static const char* TEMP_FILE_EXTENSION;
+
   template<typename T>
   static std::vector<T>
   load_directory(const std::string& dirPath,
                  ndn::io::IoEncoding encoding = ndn::io::IoEncoding::BASE64);
 
-  static std::vector<ndn::Data>
+  /*
+   * @brief Return the Data packets of the sub-manifest @p subManifestNum of the file at
+   *        @p filePath, signed with DigestSha256, as their wire encodings and full names
+   */
+  static std::vector<DigestPool::Packet>
   packetize_file(const fs::path& filePath,
                  const ndn::Name& commonPrefix,
                  size_t dataPacketSize,
@@ -73,6 +87,8 @@ class IoUtil {
    * Write the segment to disk, return 'true' if data successfully written to disk 'false'
    * otherwise. Behavior is undefined unless @segment is a correct segment for the torrent file of
    * this manager and @p path is the directory used for all segments of this torrent file.
+   * The segment is written to a temporary file which then replaces any previous file for the
+   * segment, the caller is responsible for not writing segments it already has.
    */
   static bool
   writeTorrentSegment(const TorrentFile& segment, const std::string& path);
@@ -84,11 +100,29 @@ class IoUtil {
    * Write the file manifest to disk, return 'true' if data successfully written to disk 'false'
    * otherwise. Behavior is undefined unless @manifest is a correct file manifest for a file in the
    * torrent file of this manager and @p path is the directory used for all file manifests of this
-   * torrent file.
+   * torrent file. As for torrent segments, the write is atomic and not checked against the disk.
    */
   static bool
   writeFileManifest(const FileManifest& manifest, const std::string& path);
 
+  /*
+   * @brief Return the path of the file of the manifest tree node with the specified @p nodeName
+   *        (without the implicit digest) in the directory @p path of the file manifests
+   *
+   * The nodes of the tree of a file are stored next to its sub-manifests, under
+   * <file name>/manifest-tree/<level>/<index>.
+   */
+  static std::string
+  manifestTreeNodePath(const Name& nodeName, const std::string& path);
+
+  /*
+   * @brief Write the @p node manifest tree node to disk in the directory @p path of the file
+   *        manifests, return 'true' if it is successfully written, 'false' otherwise. As for
+   *        file manifests, the write is atomic and not checked against the disk.
+   */
+  static bool
+  writeManifestTreeNode(const ManifestTreeNode& node, const std::string& path);
+
   /*
    * @brief Write @p packet composed of torrent date to disk.
    * @param packet The data packet to be written to the disk
@@ -137,7 +171,9 @@ IoUtil::load_directory(const std::string& dirPath,
       it !=  fs::recursive_directory_iterator();
       ++it)
     {
-      fileNames.insert(it->path().string());
+      if (it->path().extension() != TEMP_FILE_EXTENSION) {
+        fileNames.insert(it->path().string());
+      }
     }
     for (const auto& f : fileNames) {
       auto data_ptr = ndn::io::load<T>(f, encoding);
@@ -0,0 +1,395 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "util/metadata-store.hpp"
+
+#include "util/io-util.hpp"
+#include "util/logging.hpp"
+
+#include <cstring>
+#include <limits>
+#include <set>
+#include <unordered_set>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/encoding/encoding-buffer.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace ndn {
+namespace ntorrent {
+
+// The first bytes of every store
+static const char FILE_MAGIC[] = {'N', 'T', 'M', 'D', '0', '0', '0', '1'};
+// The last bytes of a store that ends with an index footer
+static const char FOOTER_MAGIC[] = {'N', 'T', 'I', 'X'};
+// The size of the big-endian offset of the index that precedes FOOTER_MAGIC
+static const size_t OFFSET_SIZE = 8;
+static const size_t TRAILER_SIZE = OFFSET_SIZE + sizeof(FOOTER_MAGIC);
+
+// Thrown when a TLV block runs past the end of the file, as the last record does when a crash
+// cuts it short
+class TruncatedError : public tlv::Error
+{
+public:
+  explicit
+  TruncatedError(const std::string& what)
+    : tlv::Error(what)
+  {
+  }
+};
+
+// Read a VAR-NUMBER from @p is into @p number, appending its encoding to @p wire
+static bool
+readVarNumber(std::istream& is, uint64_t& number, Buffer& wire)
+{
+  int first = is.get();
+  if (std::char_traits<char>::eof() == first) {
+    return false;
+  }
+  wire.push_back(static_cast<uint8_t>(first));
+  size_t size = first < 253 ? 0 : first == 253 ? 2 : first == 254 ? 4 : 8;
+  if (0 == size) {
+    number = first;
+    return true;
+  }
+  uint8_t bytes[8];
+  if (!is.read(reinterpret_cast<char*>(bytes), size)) {
+    return false;
+  }
+  wire.insert(wire.end(), bytes, bytes + size);
+  number = 0;
+  for (size_t i = 0; i < size; ++i) {
+    number = (number << 8) | bytes[i];
+  }
+  return true;
+}
+
+// Read the TLV type and length at the current position of @p is, then exactly the TLV-LENGTH
+// bytes of its value. Unlike Block::fromStream, it is not bounded by MAX_NDN_PACKET_SIZE, only by
+// the @p available bytes left in the file. Return the type, and the whole block in @p block,
+// unless @p expectedType is not 0 and the type differs, in which case the value is not read.
+static uint32_t
+readTlv(std::istream& is, uint64_t available, uint32_t expectedType, Block& block)
+{
+  auto wire = make_shared<Buffer>();
+  uint64_t type = 0;
+  uint64_t length = 0;
+  if (!readVarNumber(is, type, *wire)) {
+    BOOST_THROW_EXCEPTION(TruncatedError("Cannot read the TLV-TYPE"));
+  }
+  if (type > std::numeric_limits<uint32_t>::max()) {
+    BOOST_THROW_EXCEPTION(tlv::Error("TLV-TYPE out of range"));
+  }
+  if (0 != expectedType && expectedType != type) {
+    return type;
+  }
+  if (!readVarNumber(is, length, *wire)) {
+    BOOST_THROW_EXCEPTION(TruncatedError("Cannot read the TLV-LENGTH"));
+  }
+  if (wire->size() > available || length > available - wire->size()) {
+    BOOST_THROW_EXCEPTION(TruncatedError("TLV-LENGTH exceeds the size of the file"));
+  }
+  size_t headerSize = wire->size();
+  wire->resize(headerSize + length);
+  if (!is.read(reinterpret_cast<char*>(wire->buf()) + headerSize, length)) {
+    BOOST_THROW_EXCEPTION(tlv::Error("Cannot read the TLV-VALUE"));
+  }
+  block = Block(wire);
+  return type;
+}
+
+MetadataStore::MetadataStore(const std::string& path)
+  : m_path(path)
+  , m_recordsEnd(sizeof(FILE_MAGIC))
+  , m_hasFooter(false)
+{
+  if (!fs::exists(m_path)) {
+    create();
+    return;
+  }
+  uint64_t fileSize = fs::file_size(m_path);
+  char magic[sizeof(FILE_MAGIC)];
+  fs::ifstream is(m_path, fs::ifstream::binary);
+  if (fileSize < sizeof(FILE_MAGIC)
+      || !is.read(magic, sizeof(magic))
+      || 0 != std::memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC))) {
+    BOOST_THROW_EXCEPTION(Error(m_path + " is not a metadata store"));
+  }
+  is.close();
+  if (!loadFooter(fileSize)) {
+    LOG_DEBUG << "No valid index in " << m_path << ", scanning the records" << std::endl;
+    scanRecords(fileSize);
+  }
+}
+
+MetadataStore::~MetadataStore()
+{
+  try {
+    flush();
+  }
+  catch (const std::exception& e) {
+    LOG_ERROR << "Failed to write the index of " << m_path << ": " << e.what() << std::endl;
+  }
+}
+
+bool
+MetadataStore::exists(const std::string& path)
+{
+  return fs::exists(path) && fs::is_regular_file(path);
+}
+
+std::string
+MetadataStore::pathFor(const std::string& torrentPath)
+{
+  return (fs::path(torrentPath) / "metadata.ntm").string();
+}
+
+size_t
+MetadataStore::migrate(const std::string& torrentPath, const std::string& storePath)
+{
+  MetadataStore store(storePath);
+  std::unordered_set<Name> known;
+  for (const auto& e : store.entries()) {
+    known.insert(e.fullName);
+  }
+  size_t count = 0;
+  // torrent-file segments first, so that a store can be read in download order
+  for (const auto& dir : {"torrent_files", "manifests"}) {
+    auto packets = IoUtil::load_directory<Data>((fs::path(torrentPath) / dir).string());
+    for (const auto& p : packets) {
+      if (known.insert(p.getFullName()).second) {
+        store.append(p);
+        ++count;
+      }
+    }
+  }
+  store.flush();
+  return count;
+}
+
+uint64_t
+MetadataStore::append(const Data& data)
+{
+  // the records may be followed by the footer, overwrite it
+  dropFooter();
+  const Block& wire = data.wireEncode();
+  fs::ofstream os(m_path, fs::ofstream::binary | fs::ofstream::app);
+  os.write(reinterpret_cast<const char*>(wire.wire()), wire.size());
+  os.close();
+  if (!os) {
+    BOOST_THROW_EXCEPTION(Error("IO Error when appending to " + m_path));
+  }
+  uint64_t offset = m_recordsEnd;
+  m_entries.push_back(Entry{data.getFullName(), offset});
+  m_recordsEnd += wire.size();
+  return offset;
+}
+
+Block
+MetadataStore::read(uint64_t offset) const
+{
+  return readBlock(m_path, offset);
+}
+
+Block
+MetadataStore::readBlock(const std::string& path, uint64_t offset)
+{
+  fs::ifstream is(path, fs::ifstream::binary);
+  uint64_t fileSize = is ? fs::file_size(path) : 0;
+  if (!is || offset >= fileSize || !is.seekg(offset)) {
+    BOOST_THROW_EXCEPTION(Error("IO Error when reading " + path));
+  }
+  try {
+    Block block;
+    readTlv(is, fileSize - offset, 0, block);
+    return block;
+  }
+  catch (const tlv::Error& e) {
+    BOOST_THROW_EXCEPTION(Error("No valid block at offset " + to_string(offset) +
+                                " of " + path + ": " + e.what()));
+  }
+}
+
+void
+MetadataStore::flush()
+{
+  if (m_hasFooter) {
+    return;
+  }
+  // the remains of an outdated footer are replaced
+  dropFooter();
+  EncodingBuffer encoder;
+  size_t totalLength = 0;
+  for (auto it = m_entries.rbegin(); it != m_entries.rend(); ++it) {
+    size_t entryLength = 0;
+    entryLength += prependNonNegativeIntegerBlock(encoder, RECORD_OFFSET_TYPE, it->offset);
+    entryLength += it->fullName.wireEncode(encoder);
+    entryLength += encoder.prependVarNumber(entryLength);
+    entryLength += encoder.prependVarNumber(INDEX_ENTRY_TYPE);
+    totalLength += entryLength;
+  }
+  encoder.prependVarNumber(totalLength);
+  encoder.prependVarNumber(INDEX_TYPE);
+
+  char trailer[TRAILER_SIZE];
+  for (size_t i = 0; i < OFFSET_SIZE; ++i) {
+    trailer[i] = static_cast<char>((m_recordsEnd >> (8 * (OFFSET_SIZE - 1 - i))) & 0xFF);
+  }
+  std::memcpy(trailer + OFFSET_SIZE, FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+
+  fs::ofstream os(m_path, fs::ofstream::binary | fs::ofstream::app);
+  os.write(reinterpret_cast<const char*>(encoder.buf()), encoder.size());
+  os.write(trailer, sizeof(trailer));
+  os.close();
+  if (!os) {
+    BOOST_THROW_EXCEPTION(Error("IO Error when writing the index of " + m_path));
+  }
+  m_hasFooter = true;
+}
+
+void
+MetadataStore::create()
+{
+  fs::path p(m_path);
+  if (p.has_parent_path() && !fs::exists(p.parent_path())) {
+    fs::create_directories(p.parent_path());
+  }
+  fs::ofstream os(m_path, fs::ofstream::binary | fs::ofstream::trunc);
+  os.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+  os.close();
+  if (!os) {
+    BOOST_THROW_EXCEPTION(Error("IO Error when creating " + m_path));
+  }
+}
+
+bool
+MetadataStore::loadFooter(uint64_t fileSize)
+{
+  if (fileSize < sizeof(FILE_MAGIC) + TRAILER_SIZE) {
+    return false;
+  }
+  fs::ifstream is(m_path, fs::ifstream::binary);
+  char trailer[TRAILER_SIZE];
+  if (!is.seekg(fileSize - TRAILER_SIZE) || !is.read(trailer, sizeof(trailer))
+      || 0 != std::memcmp(trailer + OFFSET_SIZE, FOOTER_MAGIC, sizeof(FOOTER_MAGIC))) {
+    return false;
+  }
+  uint64_t indexOffset = 0;
+  for (size_t i = 0; i < OFFSET_SIZE; ++i) {
+    indexOffset = (indexOffset << 8) | static_cast<uint8_t>(trailer[i]);
+  }
+  if (indexOffset < sizeof(FILE_MAGIC) || indexOffset > fileSize - TRAILER_SIZE) {
+    return false;
+  }
+  std::vector<Entry> entries;
+  try {
+    is.seekg(indexOffset);
+    Block index;
+    if (INDEX_TYPE != readTlv(is, fileSize - TRAILER_SIZE - indexOffset, INDEX_TYPE, index)
+        || indexOffset + index.size() + TRAILER_SIZE != fileSize) {
+      return false;
+    }
+    index.parse();
+    entries.reserve(index.elements_size());
+    for (const auto& element : index.elements()) {
+      if (INDEX_ENTRY_TYPE != element.type()) {
+        return false;
+      }
+      element.parse();
+      auto name_it = element.find(tlv::Name);
+      auto offset_it = element.find(RECORD_OFFSET_TYPE);
+      if (element.elements_end() == name_it || element.elements_end() == offset_it) {
+        return false;
+      }
+      entries.push_back(Entry{Name(*name_it), readNonNegativeInteger(*offset_it)});
+    }
+  }
+  catch (const tlv::Error&) {
+    return false;
+  }
+  m_entries.swap(entries);
+  m_recordsEnd = indexOffset;
+  m_hasFooter = true;
+  return true;
+}
+
+void
+MetadataStore::scanRecords(uint64_t fileSize)
+{
+  m_entries.clear();
+  fs::ifstream is(m_path, fs::ifstream::binary);
+  uint64_t offset = sizeof(FILE_MAGIC);
+  is.seekg(offset);
+  while (offset < fileSize) {
+    Block record;
+    try {
+      auto type = readTlv(is, fileSize - offset, tlv::Data, record);
+      if (INDEX_TYPE == type) {
+        // the remains of a footer, overwritten by the next append() or flush()
+        break;
+      }
+      if (tlv::Data != type) {
+        BOOST_THROW_EXCEPTION(tlv::Error("Not a Data packet"));
+      }
+      Data d(record);
+      m_entries.push_back(Entry{d.getFullName(), offset});
+      offset += record.size();
+    }
+    catch (const TruncatedError& e) {
+      // the last record was cut short by a crash while appending, it was never indexed
+      LOG_ERROR << "Dropping the incomplete record at offset " << offset << " of " << m_path
+                << ": " << e.what() << std::endl;
+      is.close();
+      fs::resize_file(m_path, offset);
+      break;
+    }
+    catch (const tlv::Error& e) {
+      // a complete record that is not valid, the file is left as it is
+      BOOST_THROW_EXCEPTION(Error("No valid record at offset " + to_string(offset) +
+                                  " of " + m_path + ": " + e.what()));
+    }
+  }
+  m_recordsEnd = offset;
+  m_hasFooter = false;
+}
+
+void
+MetadataStore::dropFooter()
+{
+  // whatever follows the last record is a footer, written by flush()
+  boost::system::error_code ec;
+  uint64_t fileSize = fs::file_size(m_path, ec);
+  if (!ec && fileSize > m_recordsEnd) {
+    fs::resize_file(m_path, m_recordsEnd, ec);
+  }
+  if (ec) {
+    BOOST_THROW_EXCEPTION(Error("IO Error when dropping the index of " + m_path + ": " +
+                                ec.message()));
+  }
+  m_hasFooter = false;
+}
+
+} // namespace ntorrent
+} // namespace ndn
@@ -0,0 +1,199 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef INCLUDED_UTIL_METADATA_STORE_H
+#define INCLUDED_UTIL_METADATA_STORE_H
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/name.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ndn {
+namespace ntorrent {
+
+/**
+ * @brief A binary, append-only store for the torrent-file segments and file manifests of a torrent
+ *
+ * All the metadata of a torrent is kept in a single file:
+ *
+ *   MetadataFile ::= Magic Record* Footer?
+ *   Record       ::= Data             (raw wire encoding of a torrent-file or manifest segment)
+ *   Footer       ::= Index IndexOffset FooterMagic
+ *   Index        ::= INDEX-TYPE TLV-LENGTH IndexEntry*
+ *   IndexEntry   ::= INDEX-ENTRY-TYPE TLV-LENGTH Name RecordOffset
+ *   RecordOffset ::= RECORD-OFFSET-TYPE TLV-LENGTH nonNegativeInteger
+ *   IndexOffset  ::= OCTET[8]         (big-endian offset of Index)
+ *
+ * Each index entry holds the full name (including the implicit digest) of a record, so the store
+ * can be opened without decoding any record. New records are appended after the last record,
+ * replacing the footer, which is written back by flush(). If the footer is missing (e.g., after a
+ * crash), the index is rebuilt by scanning the records. A last record cut short by a crash while
+ * appending is dropped, by truncating the file to the end of the record before it. Any other
+ * record that cannot be read back is reported rather than dropped.
+ */
+class MetadataStore : noncopyable {
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /**
+   * @brief An entry of the index of the store
+   */
+  struct Entry {
+    // The full name of the record
+    Name     fullName;
+    // The offset of the record in the file
+    uint64_t offset;
+  };
+
+  enum {
+    INDEX_TYPE         = 128,
+    INDEX_ENTRY_TYPE   = 129,
+    RECORD_OFFSET_TYPE = 130
+  };
+
+  /**
+   * @brief Open the store at @p path, creating an empty store if the file does not exist
+   * @throws Error if the file exists but is not a metadata store, or it has no index footer and
+   *         one of its complete records is not valid
+   */
+  explicit
+  MetadataStore(const std::string& path);
+
+  /**
+   * @brief Close the store, writing the index footer if needed
+   */
+  ~MetadataStore();
+
+  /**
+   * @brief Return whether there is a metadata store at @p path
+   */
+  static bool
+  exists(const std::string& path);
+
+  /**
+   * @brief Return the path of the store for the torrent with the specified data directory
+   * @param torrentPath The directory holding the metadata of a torrent (e.g., .appdata/<torrent>)
+   */
+  static std::string
+  pathFor(const std::string& torrentPath);
+
+  /**
+   * @brief Copy the torrent-file segments and manifests of the legacy directory layout into
+   *        the store at @p storePath
+   * @param torrentPath The directory holding the "torrent_files" and "manifests" directories
+   * @return The number of records appended to the store
+   *
+   * The legacy files are left in place; records that the store already holds are skipped.
+   */
+  static size_t
+  migrate(const std::string& torrentPath, const std::string& storePath);
+
+  /**
+   * @brief Append the wire encoding of @p data to the store
+   * @return The offset of the new record
+   * @throws Error if the record cannot be written
+   */
+  uint64_t
+  append(const Data& data);
+
+  /**
+   * @brief Read the record at the specified offset
+   * @throws Error if there is no valid record at @p offset
+   */
+  Block
+  read(uint64_t offset) const;
+
+  /**
+   * @brief Read the TLV block at @p offset of the file at @p path
+   * @throws Error if there is no valid block at @p offset
+   */
+  static Block
+  readBlock(const std::string& path, uint64_t offset);
+
+  /**
+   * @brief Write the index footer if any record was appended since it was last written
+   */
+  void
+  flush();
+
+  /**
+   * @brief Return the index of the store, in the order the records were appended
+   */
+  const std::vector<Entry>&
+  entries() const;
+
+  /**
+   * @brief Return the path of the file of the store
+   */
+  const std::string&
+  path() const;
+
+private:
+  void
+  create();
+
+  bool
+  loadFooter(uint64_t fileSize);
+
+  void
+  scanRecords(uint64_t fileSize);
+
+  void
+  dropFooter();
+
+private:
+  std::string m_path;
+  std::vector<Entry> m_entries;
+  // The offset right after the last record
+  uint64_t m_recordsEnd;
+  // Whether the file currently ends with an up-to-date footer
+  bool m_hasFooter;
+};
+
+inline const std::vector<MetadataStore::Entry>&
+MetadataStore::entries() const
+{
+  return m_entries;
+}
+
+inline const std::string&
+MetadataStore::path() const
+{
+  return m_path;
+}
+
+} // namespace ntorrent
+} // namespace ndn
+
+#endif // INCLUDED_UTIL_METADATA_STORE_H
@@ -0,0 +1,88 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "util/signer.hpp"
+
+#include <ndn-cxx/encoding/encoding-buffer.hpp>
+#include <ndn-cxx/security/digest-sha256.hpp>
+#include <ndn-cxx/util/crypto.hpp>
+
+namespace ndn {
+namespace ntorrent {
+
+// The size of the SignatureValue of a DigestSha256 signature and of the largest TLV header of
+// the Data packet
+static const size_t SIGNATURE_VALUE_SIZE = 2 + 32;
+static const size_t MAX_HEADER_SIZE = 1 + 9;
+
+Signer&
+Signer::getDefault()
+{
+  static Signer signer;
+  return signer;
+}
+
+void
+Signer::sign(Data& data, const security::SigningInfo& params)
+{
+  if (security::SigningInfo::SIGNER_TYPE_SHA256 == params.getSignerType()) {
+    signWithSha256(data);
+    return;
+  }
+  getKeyChain()->sign(data, params);
+}
+
+void
+Signer::signWithSha256(Data& data)
+{
+  data.setSignature(DigestSha256());
+
+  // size the buffer once for the unsigned portion, the outer header and the signature value,
+  // which is appended, so that encoding the signed packet never reallocates
+  EncodingEstimator estimator;
+  size_t unsignedSize = data.wireEncode(estimator, true);
+  EncodingBuffer encoder(unsignedSize + MAX_HEADER_SIZE + SIGNATURE_VALUE_SIZE,
+                         SIGNATURE_VALUE_SIZE);
+  data.wireEncode(encoder, true);
+
+  auto digest = crypto::computeSha256Digest(encoder.buf(), encoder.size());
+  data.wireEncode(encoder, Block(tlv::SignatureValue, digest));
+}
+
+shared_ptr<security::KeyChain>
+Signer::getKeyChain()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (nullptr == m_keyChain) {
+    m_keyChain = make_shared<security::KeyChain>();
+  }
+  return m_keyChain;
+}
+
+void
+Signer::setKeyChain(shared_ptr<security::KeyChain> keyChain)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_keyChain = keyChain;
+}
+
+} // namespace ntorrent
+} // namespace ndn
@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef INCLUDED_UTIL_SIGNER_H
+#define INCLUDED_UTIL_SIGNER_H
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/security/signing-helpers.hpp>
+#include <ndn-cxx/security/signing-info.hpp>
+
+#include <memory>
+#include <mutex>
+
+namespace ndn {
+namespace ntorrent {
+
+/**
+ * @brief The signer shared by the whole process
+ *
+ * Constructing a security::KeyChain opens the PIB and TPM backends, which costs more than
+ * signing (or reading) a packet. The signer creates a KeyChain only the first time a packet is
+ * signed with a key, and reuses it afterwards. Packets signed with signingWithSha256(), which is
+ * what all the segments and data packets of a torrent use, never go through a KeyChain: their
+ * DigestSha256 signature is computed straight into a buffer sized for the whole packet.
+ */
+class Signer : noncopyable {
+public:
+  /**
+   * @brief Return the signer of the process
+   */
+  static Signer&
+  getDefault();
+
+  /**
+   * @brief Sign @p data as specified by @p params
+   */
+  void
+  sign(Data& data, const security::SigningInfo& params = signingWithSha256());
+
+  /**
+   * @brief Sign each packet in [ @p begin, @p end ) as specified by @p params
+   */
+  template<typename Iterator>
+  void
+  sign(Iterator begin, Iterator end, const security::SigningInfo& params = signingWithSha256());
+
+  /**
+   * @brief Sign @p data with a DigestSha256 signature without a KeyChain
+   *
+   * Produces the same wire encoding as signing with signingWithSha256() through a KeyChain.
+   */
+  static void
+  signWithSha256(Data& data);
+
+  /**
+   * @brief Return the KeyChain used for the other signing methods, creating it if needed
+   *
+   * The caller shares the ownership of the KeyChain, so that it outlives a concurrent
+   * setKeyChain().
+   */
+  shared_ptr<security::KeyChain>
+  getKeyChain();
+
+  /**
+   * @brief Use @p keyChain for the signing methods other than signingWithSha256()
+   */
+  void
+  setKeyChain(shared_ptr<security::KeyChain> keyChain);
+
+private:
+  Signer() = default;
+
+private:
+  std::mutex m_mutex;
+  shared_ptr<security::KeyChain> m_keyChain;
+};
+
+template<typename Iterator>
+inline void
+Signer::sign(Iterator begin, Iterator end, const security::SigningInfo& params)
+{
+  if (security::SigningInfo::SIGNER_TYPE_SHA256 == params.getSignerType()) {
+    for (auto it = begin; it != end; ++it) {
+      signWithSha256(*it);
+    }
+    return;
+  }
+  auto keyChain = getKeyChain();
+  for (auto it = begin; it != end; ++it) {
+    keyChain->sign(*it, params);
+  }
+}
+
+} // namespace ntorrent
+} // namespace ndn
+
+#endif // INCLUDED_UTIL_SIGNER_H
@@ -0,0 +1,90 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "util/tree-builder.hpp"
+
+#include "util/signer.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+
+namespace ndn {
+namespace ntorrent {
+
+TreeBuilder::TreeBuilder(const Name& filePrefix,
+                         size_t fanout,
+                         size_t leafCount,
+                         const Sink& sink)
+  : m_filePrefix(filePrefix)
+  , m_fanout(fanout)
+  , m_leafCount(leafCount)
+  , m_sink(sink)
+{
+  BOOST_ASSERT(1 < fanout);
+  BOOST_ASSERT(0 < leafCount);
+  size_t height = ManifestTreeNode::getHeight(leafCount, fanout);
+  m_widths.reserve(height + 1);
+  m_nodes.reserve(height);
+  m_widths.push_back(leafCount);
+  for (size_t level = 1; level <= height; ++level) {
+    m_widths.push_back((m_widths.back() + fanout - 1) / fanout);
+    m_nodes.emplace_back(filePrefix, level, 0, fanout, leafCount);
+  }
+}
+
+void
+TreeBuilder::append(const Name& leafFullName)
+{
+  if (!m_rootName.empty()) {
+    BOOST_THROW_EXCEPTION(ManifestTreeNode::Error("Every sub-manifest of " +
+                                                  m_filePrefix.toUri() +
+                                                  " is already in the tree"));
+  }
+  insert(1, leafFullName);
+}
+
+void
+TreeBuilder::insert(size_t level, const Name& childFullName)
+{
+  auto& node = m_nodes[level - 1];
+  node.insert(childFullName);
+  // the last node of a level holds the children left over by the others
+  size_t firstChild = node.getIndex() * m_fanout;
+  if (node.childCount() < std::min(m_fanout, m_widths[level - 1] - firstChild)) {
+    return;
+  }
+  node.finalize();
+  Signer::getDefault().sign(node);
+  m_sink(node);
+  Name fullName = node.getFullName();
+  node = ManifestTreeNode(m_filePrefix, level, node.getIndex() + 1, m_fanout, m_leafCount);
+  if (m_nodes.size() == level) {
+    m_rootName = fullName;
+  }
+  else {
+    insert(level + 1, fullName);
+  }
+}
+
+} // namespace ntorrent
+} // namespace ndn
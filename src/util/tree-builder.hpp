@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#ifndef INCLUDED_UTIL_TREE_BUILDER_H
+#define INCLUDED_UTIL_TREE_BUILDER_H
+
+#include "manifest-tree-node.hpp"
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/name.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace ndn {
+namespace ntorrent {
+
+/**
+ * @brief Build the Merkle tree over the sub-manifests of a file while they are generated
+ *
+ * The full name of each sub-manifest is appended as soon as it is signed. A node is finalized,
+ * signed and passed to a sink once its last child is appended, and its full name is then
+ * appended to its parent. Only the node being filled at each level is kept in memory, so the
+ * memory used grows with the height of the tree rather than with the size of the file.
+ */
+class TreeBuilder : noncopyable {
+public:
+  /**
+   * @brief Callback that receives each node once it is finalized and signed
+   */
+  typedef std::function<void(const Data&)> Sink;
+
+  /**
+   * @brief Create a builder for the tree of the specified file
+   * @param filePrefix The name of the file, i.e., the name of its sub-manifests without <seq>
+   * @param fanout The maximum number of children of each node of the tree
+   * @param leafCount The number of sub-manifests of the file
+   * @param sink The callback that receives every node, the root last
+   *
+   * The behavior is undefined unless '1 < fanout' and '0 < leafCount'.
+   */
+  TreeBuilder(const Name& filePrefix, size_t fanout, size_t leafCount, const Sink& sink);
+
+  /**
+   * @brief Append the full name of the next sub-manifest of the file
+   * @throws ManifestTreeNode::Error if it is not the full name of the next sub-manifest, or if
+   *         every sub-manifest has already been appended
+   */
+  void
+  append(const Name& leafFullName);
+
+  /**
+   * @brief Return the full name of the root, or an empty name until every sub-manifest has been
+   *        appended
+   */
+  const Name&
+  getRootName() const;
+
+private:
+  void
+  insert(size_t level, const Name& childFullName);
+
+private:
+  Name m_filePrefix;
+  size_t m_fanout;
+  size_t m_leafCount;
+  Sink m_sink;
+  // The number of nodes of each level, the number of sub-manifests at level 0
+  std::vector<size_t> m_widths;
+  // The node being filled at each level, from level 1 up to the root
+  std::vector<ManifestTreeNode> m_nodes;
+  Name m_rootName;
+};
+
+inline const Name&
+TreeBuilder::getRootName() const
+{
+  return m_rootName;
+}
+
+} // namespace ntorrent
+} // namespace ndn
+
+#endif // INCLUDED_UTIL_TREE_BUILDER_H
@@ -0,0 +1,148 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "compact-catalog.hpp"
+#include "boost-test.hpp"
+
+#include <vector>
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/security/signing-helpers.hpp>
+
+BOOST_TEST_DONT_PRINT_LOG_VALUE(std::vector<ndn::Name>)
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+using ndn::Name;
+
+static vector<Name>
+makeFullNames(const Name& prefix, size_t count)
+{
+  KeyChain keyChain;
+  vector<Name> names;
+  for (size_t i = 0; i < count; ++i) {
+    Name packetName = prefix;
+    packetName.appendSequenceNumber(i);
+    Data d(packetName);
+    d.setContent(reinterpret_cast<const uint8_t*>(&i), sizeof(i));
+    keyChain.sign(d, signingWithSha256());
+    names.push_back(d.getFullName());
+  }
+  return names;
+}
+
+BOOST_AUTO_TEST_SUITE(TestCompactCatalog)
+
+BOOST_AUTO_TEST_CASE(CheckPushBackAndAccessors)
+{
+  Name prefix("/ndn/multicast/NTORRENT/foo/bar.txt");
+  prefix.appendSequenceNumber(0);
+  auto names = makeFullNames(prefix, 5);
+
+  CompactCatalog c(prefix);
+  BOOST_CHECK(c.empty());
+  BOOST_CHECK_EQUAL(prefix, c.packet_prefix());
+
+  for (const auto& n : names) {
+    BOOST_CHECK(c.push_back(n));
+  }
+  BOOST_CHECK_EQUAL(names.size(), c.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    BOOST_CHECK_EQUAL(names[i], c.at(i));
+    BOOST_CHECK_EQUAL(i, c.find(names[i]));
+  }
+  BOOST_CHECK_EQUAL(names, c.materialize());
+
+  c.pop_back();
+  BOOST_CHECK_EQUAL(names.size() - 1, c.size());
+  BOOST_CHECK_EQUAL(c.size(), c.find(names.back()));
+}
+
+BOOST_AUTO_TEST_CASE(CheckIrregularNamesRejected)
+{
+  Name prefix("/foo");
+  auto names = makeFullNames(prefix, 2);
+
+  CompactCatalog c(prefix);
+  // out of order
+  BOOST_CHECK(!c.push_back(names[1]));
+  // no implicit digest
+  BOOST_CHECK(!c.push_back(names[0].getPrefix(-1)));
+  // different prefix
+  BOOST_CHECK(!c.push_back(makeFullNames("/bar", 1)[0]));
+  BOOST_CHECK(c.empty());
+
+  BOOST_CHECK(c.push_back(names[0]));
+  BOOST_CHECK(!c.push_back(names[0]));
+  BOOST_CHECK_EQUAL(1, c.size());
+}
+
+BOOST_AUTO_TEST_CASE(CheckPushBackSuffix)
+{
+  Name catalogPrefix("/ndn/multicast/NTORRENT/foo");
+  Name prefix = catalogPrefix;
+  prefix.append("bar.txt").appendSequenceNumber(0);
+  auto names = makeFullNames(prefix, 3);
+
+  CompactCatalog c(prefix);
+  for (const auto& n : names) {
+    Block suffix = n.getSubName(catalogPrefix.size()).wireEncode();
+    BOOST_CHECK(c.push_back_suffix(catalogPrefix.size(), suffix));
+  }
+  BOOST_CHECK_EQUAL(names, c.materialize());
+
+  // the suffix must complete the packet prefix
+  auto other = makeFullNames("/ndn/multicast/NTORRENT/foo/baz.txt/%00", 4);
+  BOOST_CHECK(!c.push_back_suffix(catalogPrefix.size(),
+                                  other[3].getSubName(catalogPrefix.size()).wireEncode()));
+  // and the entries must still be in order
+  BOOST_CHECK(!c.push_back_suffix(catalogPrefix.size(),
+                                  names[0].getSubName(catalogPrefix.size()).wireEncode()));
+  BOOST_CHECK_EQUAL(names.size(), c.size());
+}
+
+BOOST_AUTO_TEST_CASE(CheckEquality)
+{
+  auto names = makeFullNames("/foo", 3);
+  CompactCatalog c1("/foo");
+  CompactCatalog c2("/foo");
+  BOOST_CHECK(c1 == c2);
+
+  c1.push_back(names[0]);
+  BOOST_CHECK(c1 != c2);
+
+  c2.push_back(names[0]);
+  BOOST_CHECK(c1 == c2);
+
+  c1.clear();
+  BOOST_CHECK(c1 != c2);
+  BOOST_CHECK(c1 == CompactCatalog("/foo"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace nTorrent
+} // namespace ndn
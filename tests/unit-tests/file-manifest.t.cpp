@@ -392,6 +392,9 @@ BOOST_AUTO_TEST_CASE(CheckGenerateFileManifest)
         BOOST_CHECK_EQUAL(it->data_packet_size(), dataPacketSize);
         BOOST_CHECK_EQUAL(it->catalog_prefix(), catalogPrefix);
         BOOST_CHECK_EQUAL(*it, FileManifest(it->wireEncode()));
+        // generated and decoded catalogs are held in compact form
+        BOOST_CHECK(it->is_compact());
+        BOOST_CHECK(FileManifest(it->wireEncode()).is_compact());
         if (it != manifests.end() -1) {
           BOOST_CHECK_EQUAL(it->catalog().size(), subManifestSize);
           BOOST_CHECK_EQUAL(*(it->submanifest_ptr()), (it+1)->getFullName());
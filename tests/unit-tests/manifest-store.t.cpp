@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "manifest-store.hpp"
+#include "boost-test.hpp"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ndn-cxx/util/io.hpp>
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestManifestStore)
+
+BOOST_AUTO_TEST_CASE(CheckIndexAndGet)
+{
+  auto manifests = FileManifest::generate("tests/testdata/foo/bar.txt",
+                                          "/ndn/multicast/NTORRENT/foo/", 10, 10);
+  BOOST_REQUIRE(manifests.size() > 2);
+
+  std::string dirPath = "tests/testdata/temp/";
+  for (const auto& m : manifests) {
+    fs::path filename = dirPath + m.file_name() + "/" + to_string(m.submanifest_number());
+    fs::create_directories(filename.parent_path());
+    io::save(m, filename.string());
+  }
+
+  ManifestStore store(2);
+  store.indexDirectory(dirPath);
+  BOOST_CHECK_EQUAL(manifests.size(), store.size());
+  // nothing is decoded until it is requested
+  BOOST_CHECK_EQUAL(0, store.cacheSize());
+
+  for (const auto& m : manifests) {
+    auto key = ManifestStore::makeKey(m.getFullName());
+    BOOST_CHECK_EQUAL(m.file_name(), key.first);
+    BOOST_CHECK_EQUAL(m.submanifest_number(), key.second);
+    BOOST_CHECK(store.contains(key));
+
+    auto m1 = store.get(key);
+    BOOST_REQUIRE(nullptr != m1);
+    BOOST_CHECK(m == *m1);
+    BOOST_CHECK_EQUAL(m.getFullName(), m1->getFullName());
+    // the cache is bounded
+    BOOST_CHECK_LE(store.cacheSize(), 2);
+  }
+  BOOST_CHECK(nullptr == store.get(ManifestStore::makeKey("/ndn/multicast/NTORRENT/foo/none")));
+
+  BOOST_CHECK(store.erase(ManifestStore::makeKey(manifests[0].getName())));
+  BOOST_CHECK(nullptr == store.get(ManifestStore::makeKey(manifests[0].getName())));
+  BOOST_CHECK_EQUAL(manifests.size() - 1, store.size());
+
+  store.clear();
+  BOOST_CHECK_EQUAL(0, store.size());
+  BOOST_CHECK_EQUAL(0, store.cacheSize());
+  fs::remove_all(dirPath);
+}
+
+BOOST_AUTO_TEST_CASE(CheckInsertDecoded)
+{
+  auto manifests = FileManifest::generate("tests/testdata/foo/bar.txt",
+                                          "/ndn/multicast/NTORRENT/foo/", 10, 10);
+  BOOST_REQUIRE(manifests.size() > 2);
+
+  std::string dirPath = "tests/testdata/temp/";
+  fs::path filename = dirPath + manifests[0].file_name() + "/0";
+  fs::create_directories(filename.parent_path());
+  io::save(manifests[0], filename.string());
+
+  ManifestStore store(1);
+  auto key0 = ManifestStore::makeKey(manifests[0].getName());
+  auto m0 = make_shared<const FileManifest>(manifests[0]);
+  // a segment inserted along with its location is cached at once
+  store.insert(key0, ManifestStore::Location{filename.string(), 0, io::BASE64}, m0);
+  BOOST_CHECK_EQUAL(1, store.cacheSize());
+  BOOST_CHECK(m0 == store.get(key0));
+
+  // a segment that is not on disk is kept in memory, whatever the capacity of the cache
+  auto key1 = ManifestStore::makeKey(manifests[1].getName());
+  auto m1 = make_shared<const FileManifest>(manifests[1]);
+  store.insert(key1, m1);
+  BOOST_CHECK_EQUAL(2, store.size());
+  BOOST_CHECK(m0 == store.get(key0));
+  BOOST_CHECK(m1 == store.get(key1));
+
+  // the location of a segment replaces its copy in memory
+  store.insert(key1, ManifestStore::Location{filename.string(), 0, io::BASE64});
+  auto m2 = store.get(key1);
+  BOOST_REQUIRE(nullptr != m2);
+  BOOST_CHECK_EQUAL(manifests[0].getFullName(), m2->getFullName());
+
+  BOOST_CHECK(store.erase(key1));
+  BOOST_CHECK(nullptr == store.get(key1));
+  fs::remove_all(dirPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace nTorrent
+} // namespace ndn
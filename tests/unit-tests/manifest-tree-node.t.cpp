@@ -0,0 +1,168 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "manifest-tree-node.hpp"
+#include "file-manifest.hpp"
+#include "boost-test.hpp"
+#include "util/signer.hpp"
+
+#include <map>
+#include <vector>
+
+#include <ndn-cxx/data.hpp>
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestManifestTreeNode)
+
+BOOST_AUTO_TEST_CASE(CheckNames)
+{
+  Name filePrefix("/ndn/multicast/NTORRENT/foo/bar1.txt");
+  Name name = ManifestTreeNode::makeName(filePrefix, 2, 3);
+  BOOST_CHECK_EQUAL(filePrefix, name.getPrefix(-3));
+  BOOST_CHECK_EQUAL(ManifestTreeNode::NAME_MARKER, name.get(-3));
+  BOOST_CHECK_EQUAL(2, name.get(-2).toSequenceNumber());
+  BOOST_CHECK_EQUAL(3, name.get(-1).toSequenceNumber());
+
+  BOOST_CHECK_EQUAL(1, ManifestTreeNode::getHeight(1, 4));
+  BOOST_CHECK_EQUAL(1, ManifestTreeNode::getHeight(4, 4));
+  BOOST_CHECK_EQUAL(2, ManifestTreeNode::getHeight(5, 4));
+  BOOST_CHECK_EQUAL(2, ManifestTreeNode::getHeight(16, 4));
+  BOOST_CHECK_EQUAL(3, ManifestTreeNode::getHeight(17, 4));
+}
+
+BOOST_AUTO_TEST_CASE(CheckInsertEncodeDecode)
+{
+  Name filePrefix("/ndn/multicast/NTORRENT/foo/bar.txt");
+  ManifestTreeNode node(filePrefix, 1, 1, 2, 4);
+  BOOST_CHECK_EQUAL(0, node.childCount());
+
+  std::vector<Data> children;
+  for (size_t i = 2; i < 4; ++i) {
+    Data child(Name(filePrefix).appendSequenceNumber(i));
+    Signer::signWithSha256(child);
+    children.push_back(child);
+  }
+  // the children have to be inserted in order
+  BOOST_CHECK_THROW(node.insert(children[1].getFullName()), ManifestTreeNode::Error);
+  // and with their implicit digest
+  BOOST_CHECK_THROW(node.insert(children[0].getName()), ManifestTreeNode::Error);
+  node.insert(children[0].getFullName());
+  node.insert(children[1].getFullName());
+  BOOST_CHECK_THROW(node.insert(children[1].getFullName()), ManifestTreeNode::Error);
+  node.finalize();
+  Signer::signWithSha256(node);
+
+  ManifestTreeNode decoded(node.wireEncode());
+  BOOST_CHECK_EQUAL(node.getName(), decoded.getName());
+  BOOST_CHECK_EQUAL(filePrefix, decoded.getFilePrefix());
+  BOOST_CHECK_EQUAL(1, decoded.getLevel());
+  BOOST_CHECK_EQUAL(1, decoded.getIndex());
+  BOOST_CHECK_EQUAL(2, decoded.getFanout());
+  BOOST_CHECK_EQUAL(4, decoded.getLeafCount());
+  BOOST_CHECK(!decoded.isRoot());
+  BOOST_REQUIRE_EQUAL(2, decoded.childCount());
+  for (size_t i = 0; i < 2; ++i) {
+    BOOST_CHECK_EQUAL(children[i].getFullName(), decoded.getChildName(i));
+    BOOST_CHECK(decoded.verifyChild(children[i]));
+  }
+
+  // a Data packet that is not a child of the node is rejected
+  Data other(Name(filePrefix).appendSequenceNumber(0));
+  Signer::signWithSha256(other);
+  BOOST_CHECK(!decoded.verifyChild(other));
+
+  // a node cannot be decoded from a packet that is not a node
+  BOOST_CHECK_THROW(ManifestTreeNode(children[0].wireEncode()), ManifestTreeNode::Error);
+}
+
+BOOST_AUTO_TEST_CASE(CheckGenerateTree)
+{
+  const size_t dataPacketSize = 1024;
+  const size_t fanout = 4;
+  const char* filePath = "tests/testdata/foo/bar1.txt";
+  auto fileSize = fs::file_size(filePath);
+  auto tree = FileManifest::generateTree(filePath, "/ndn/multicast/NTORRENT/foo/", 1,
+                                         dataPacketSize, fanout);
+  const auto& manifests = tree.first;
+  const auto& nodes = tree.second;
+
+  BOOST_REQUIRE_EQUAL(fileSize / dataPacketSize + !!(fileSize % dataPacketSize),
+                      manifests.size());
+  // 48 leaves under a fanout of 4: 12 + 3 + 1 nodes
+  BOOST_REQUIRE_EQUAL(16, nodes.size());
+  BOOST_CHECK(nodes.back().isRoot());
+  BOOST_CHECK_EQUAL(3, nodes.back().getLevel());
+
+  std::map<Name, Data> byName;
+  for (const auto& m : manifests) {
+    // the leaves are independent of each other
+    BOOST_CHECK(nullptr == m.submanifest_ptr());
+    byName[m.getName()] = m;
+  }
+  for (const auto& n : nodes) {
+    byName[n.getName()] = n;
+  }
+
+  // starting from the root alone, every node and leaf verifies against its parent
+  size_t verified = 0;
+  std::vector<ManifestTreeNode> level = { nodes.back() };
+  while (!level.empty()) {
+    std::vector<ManifestTreeNode> below;
+    for (const auto& node : level) {
+      for (size_t i = 0; i < node.childCount(); ++i) {
+        const auto& child = byName.at(node.getChildName(i).getPrefix(-1));
+        BOOST_CHECK(node.verifyChild(child));
+        ++verified;
+        if (1 < node.getLevel()) {
+          below.push_back(ManifestTreeNode(child.wireEncode()));
+        }
+      }
+    }
+    level.swap(below);
+  }
+  BOOST_CHECK_EQUAL(manifests.size() + nodes.size() - 1, verified);
+
+  // a forged sub-manifest is rejected by its parent
+  FileManifest forged = manifests[5];
+  forged.push_back(forged.catalog().front());
+  forged.finalize();
+  Signer::signWithSha256(forged);
+  BOOST_CHECK(!nodes[1].verifyChild(forged));
+  BOOST_CHECK(nodes[1].verifyChild(manifests[5]));
+
+  BOOST_CHECK_THROW(FileManifest::generateTree("tests/testdata/foo/fake.txt",
+                                               "/ndn/multicast/NTORRENT/foo/", 1,
+                                               dataPacketSize, fanout),
+                    FileManifest::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace ntorrent
+} // namespace ndn
@@ -0,0 +1,184 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "piece-availability.hpp"
+#include "boost-test.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/encoding/encoding-buffer.hpp>
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+
+BOOST_AUTO_TEST_SUITE(TestPieceAvailability)
+
+BOOST_AUTO_TEST_CASE(CheckEncodeDecode)
+{
+  vector<bool> mostlyHeld(1000, true);
+  mostlyHeld[0] = false;
+  mostlyHeld[500] = false;
+  mostlyHeld[999] = false;
+
+  const vector<vector<bool>> bitmaps = {
+    {},
+    {false, false, false},
+    {true, true, true},
+    {true, false, true, true, false, false, false},
+    {false, true, false, true, false, true},
+    mostlyHeld,
+    vector<bool>(1000, true),
+  };
+  for (const auto& bitmap : bitmaps) {
+    auto decoded = PieceAvailability::decode(PieceAvailability::encode(bitmap));
+    BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), bitmap.begin(), bitmap.end());
+  }
+
+  // a run takes a byte or three, whatever its length
+  BOOST_CHECK_LT(PieceAvailability::encode(vector<bool>(1000, true)).size(), 12);
+  BOOST_CHECK_LT(PieceAvailability::encode(mostlyHeld).size(), 24);
+}
+
+BOOST_AUTO_TEST_CASE(CheckBitfieldSet)
+{
+  // the packets are marked held in an order that splits, extends and merges runs
+  const size_t nPackets = 64;
+  vector<size_t> order;
+  for (size_t i = 0; i < nPackets; ++i) {
+    order.push_back((i * 37 + 5) % nPackets);
+  }
+  order.push_back(order.front());
+
+  vector<bool> bitmap(nPackets);
+  PieceAvailability::Bitfield bitfield(bitmap);
+  BOOST_CHECK_EQUAL(bitfield.size(), nPackets);
+  BOOST_CHECK_EQUAL(bitfield.count(), 0);
+  for (auto index : order) {
+    BOOST_CHECK_EQUAL(bitfield.set(index), !bitmap[index]);
+    bitmap[index] = true;
+    // the same runs as those of the whole bitmap
+    BOOST_CHECK(bitfield.encode() == PieceAvailability::encode(bitmap));
+    BOOST_CHECK_EQUAL(bitfield.count(), std::count(bitmap.begin(), bitmap.end(), true));
+  }
+  BOOST_CHECK_EQUAL(bitfield.count(), nPackets);
+
+  // the first and last packets
+  PieceAvailability::Bitfield edges(vector<bool>(3));
+  BOOST_CHECK(edges.set(2));
+  BOOST_CHECK(edges.set(0));
+  BOOST_CHECK(edges.encode() == PieceAvailability::encode({true, false, true}));
+  BOOST_CHECK(edges.set(1));
+  BOOST_CHECK(edges.encode() == PieceAvailability::encode({true, true, true}));
+}
+
+BOOST_AUTO_TEST_CASE(CheckDecodeMalformed)
+{
+  // the runs add up to 5 bits out of 4
+  EncodingBuffer encoder;
+  size_t length = 0;
+  length += encoder.prependVarNumber(3);
+  length += encoder.prependVarNumber(2);
+  length += encoder.prependVarNumber(length);
+  length += encoder.prependVarNumber(PieceAvailability::RUN_LENGTHS_TYPE);
+  length += prependNonNegativeIntegerBlock(encoder, PieceAvailability::BIT_COUNT_TYPE, 4);
+  length += encoder.prependVarNumber(length);
+  length += encoder.prependVarNumber(tlv::Content);
+  BOOST_CHECK_THROW(PieceAvailability::decode(encoder.block()), PieceAvailability::Error);
+
+  // the runs add up to 2 bits out of 4
+  Block shorter(tlv::Content);
+  shorter.push_back(makeNonNegativeIntegerBlock(PieceAvailability::BIT_COUNT_TYPE, 4));
+  shorter.push_back(makeBinaryBlock(PieceAvailability::RUN_LENGTHS_TYPE, "\x01\x01", 2));
+  shorter.encode();
+  BOOST_CHECK_THROW(PieceAvailability::decode(shorter), PieceAvailability::Error);
+
+  Block noRuns(tlv::Content);
+  noRuns.push_back(makeNonNegativeIntegerBlock(PieceAvailability::BIT_COUNT_TYPE, 4));
+  noRuns.encode();
+  BOOST_CHECK_THROW(PieceAvailability::decode(noRuns), PieceAvailability::Error);
+
+  Block tooLarge(tlv::Content);
+  tooLarge.push_back(makeNonNegativeIntegerBlock(PieceAvailability::BIT_COUNT_TYPE,
+                                                 PieceAvailability::MAX_BIT_COUNT + 1));
+  tooLarge.push_back(makeBinaryBlock(PieceAvailability::RUN_LENGTHS_TYPE, "", 0));
+  tooLarge.encode();
+  BOOST_CHECK_THROW(PieceAvailability::decode(tooLarge), PieceAvailability::Error);
+}
+
+BOOST_AUTO_TEST_CASE(CheckNames)
+{
+  Name manifestName("/ndn/multicast/NTORRENT/foo/bar1.txt/%00%00/sha256digest=00");
+  Name name = PieceAvailability::makeName(manifestName);
+  BOOST_CHECK_EQUAL(manifestName, name.getPrefix(-1));
+  BOOST_CHECK(PieceAvailability::isAvailabilityName(name));
+  BOOST_CHECK(!PieceAvailability::isAvailabilityName(manifestName));
+
+  auto data = PieceAvailability::makeData(manifestName, {true, false, true});
+  BOOST_CHECK_EQUAL(name, data->getName().getPrefix(-1));
+  BOOST_CHECK_EQUAL(2, PieceAvailability::getVersion(data->getName()));
+  BOOST_CHECK_EQUAL(PieceAvailability::FRESHNESS_PERIOD, data->getFreshnessPeriod());
+  auto bitmap = PieceAvailability::decode(data->getContent());
+  BOOST_CHECK(bitmap == vector<bool>({true, false, true}));
+}
+
+BOOST_AUTO_TEST_CASE(CheckUpdate)
+{
+  Name manifestName("/ndn/multicast/NTORRENT/foo/bar1.txt/%00%00");
+  PieceAvailability availability;
+  BOOST_CHECK(availability.empty());
+
+  BOOST_CHECK(availability.update("/ucla", manifestName, 1, {true, false, false}));
+  BOOST_CHECK(availability.update("/arizona", manifestName, 2, {true, true, false}));
+
+  BOOST_CHECK(availability.has("/ucla", manifestName, 0));
+  BOOST_CHECK(!availability.has("/ucla", manifestName, 1));
+  BOOST_CHECK(availability.has("/arizona", manifestName, 1));
+  BOOST_CHECK(!availability.has("/arizona", manifestName, 3));
+  BOOST_CHECK(!availability.has("/memphis", manifestName, 0));
+  BOOST_CHECK(!availability.has("/ucla", "/other", 0));
+
+  BOOST_CHECK_EQUAL(availability.count(manifestName, 0), 2);
+  BOOST_CHECK_EQUAL(availability.count(manifestName, 1), 1);
+  BOOST_CHECK_EQUAL(availability.count(manifestName, 2), 0);
+  BOOST_CHECK_EQUAL(availability.count("/other", 0), 0);
+
+  // an older advertisement never replaces a newer one
+  BOOST_CHECK(!availability.update("/arizona", manifestName, 1, {false, false, true}));
+  BOOST_CHECK(availability.has("/arizona", manifestName, 1));
+  BOOST_CHECK(availability.update("/arizona", manifestName, 3, {true, true, true}));
+  BOOST_CHECK_EQUAL(availability.count(manifestName, 2), 1);
+
+  availability.erase("/arizona");
+  BOOST_CHECK_EQUAL(availability.count(manifestName, 1), 0);
+  availability.erase("/ucla");
+  BOOST_CHECK(availability.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace ntorrent
+} // namespace ndn
@@ -20,10 +20,13 @@
 */
 
 #include "boost-test.hpp"
+#include "unit-test-time-fixture.hpp"
 #include "stats-table-record.hpp"
 
 #include <ndn-cxx/name.hpp>
 
+#include <cmath>
+
 namespace ndn {
 namespace ntorrent {
 namespace tests {
@@ -58,15 +61,105 @@ BOOST_AUTO_TEST_CASE(TestIncrement)
   BOOST_CHECK_EQUAL(record.getRecordSuccessRate(), 1);
 }
 
-BOOST_AUTO_TEST_CASE(TestIncrementThrow)
+BOOST_AUTO_TEST_CASE(TestPendingInterests)
+{
+  StatsTableRecord record(Name("isp1"));
+  record.incrementSentInterests();
+  record.incrementSentInterests();
+  record.incrementSentInterests();
+  BOOST_CHECK_EQUAL(record.getRecordPendingInterests(), 3);
+
+  record.incrementReceivedData();
+  BOOST_CHECK_EQUAL(record.getRecordPendingInterests(), 2);
+
+  record.decrementPendingInterests();
+  record.decrementPendingInterests();
+  BOOST_CHECK_EQUAL(record.getRecordPendingInterests(), 0);
+  record.decrementPendingInterests();
+  BOOST_CHECK_EQUAL(record.getRecordPendingInterests(), 0);
+
+  BOOST_CHECK_EQUAL(record.getRecordSentInterests(), 3);
+  BOOST_CHECK_EQUAL(record.getRecordReceivedData(), 1);
+
+  StatsTableRecord copy(record);
+  BOOST_CHECK_EQUAL(copy.getRecordPendingInterests(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(TestSmoothedMetrics, UnitTestTimeFixture)
+{
+  StatsTableRecord record(Name("isp1"));
+  BOOST_CHECK_EQUAL(record.getRecordEwmaSuccessRate(), 0);
+  BOOST_CHECK(record.getRecordSmoothedRtt() == time::nanoseconds::zero());
+  BOOST_CHECK_EQUAL(record.getRecordThroughput(), 0);
+
+  // the first round trip initializes the estimates
+  record.incrementSentInterests();
+  advanceClocks(time::milliseconds(100));
+  record.incrementReceivedData(1000, time::milliseconds(100));
+  BOOST_CHECK_EQUAL(record.getRecordEwmaSuccessRate(), 1);
+  BOOST_CHECK(record.getRecordSmoothedRtt() == time::milliseconds(100));
+  BOOST_CHECK(record.getRecordRttVariance() == time::milliseconds(50));
+  BOOST_CHECK_GT(record.getRecordThroughput(), 0);
+
+  // later round trips are smoothed
+  record.incrementSentInterests();
+  advanceClocks(time::milliseconds(100));
+  record.incrementReceivedData(1000, time::milliseconds(300));
+  BOOST_CHECK(record.getRecordSmoothedRtt() == time::milliseconds(125));
+  BOOST_CHECK(record.getRecordRttVariance() == time::milliseconds(87) + time::microseconds(500));
+
+  // the failures known at once weigh as much as the successes, less the decay of the first one
+  for (int i = 0; i < 8; ++i) {
+    record.incrementSentInterests();
+    record.incrementTimeouts();
+  }
+  record.incrementSentInterests();
+  record.incrementNacks();
+  BOOST_CHECK_EQUAL(record.getRecordTimeouts(), 8);
+  BOOST_CHECK_EQUAL(record.getRecordNacks(), 1);
+  BOOST_CHECK_EQUAL(record.getRecordPendingInterests(), 0);
+  double tau = time::duration_cast<time::duration<double>>(
+                 StatsTableRecord::SUCCESS_RATE_TIME_CONSTANT).count();
+  double successWeight = 1 + std::exp(-0.1 / tau);
+  BOOST_CHECK_CLOSE(record.getRecordEwmaSuccessRate(),
+                    successWeight / (successWeight + 9), 0.0001);
+
+  // the outcomes weigh less as time passes, however few Interests are sent meanwhile
+  advanceClocks(StatsTableRecord::SUCCESS_RATE_TIME_CONSTANT * 5);
+  record.incrementSentInterests();
+  record.incrementReceivedData();
+  BOOST_CHECK_GT(record.getRecordEwmaSuccessRate(), 0.9);
+
+  // without data, the throughput decays with time
+  double throughput = record.getRecordThroughput();
+  advanceClocks(StatsTableRecord::THROUGHPUT_TIME_CONSTANT * 5);
+  BOOST_CHECK_LT(record.getRecordThroughput(time::steady_clock::now()), throughput / 100);
+  BOOST_CHECK_EQUAL(record.getRecordThroughput(), throughput);
+  record.incrementSentInterests();
+  record.incrementTimeouts();
+  BOOST_CHECK_LT(record.getRecordThroughput(), throughput / 100);
+
+  StatsTableRecord copy(record);
+  BOOST_CHECK_EQUAL(copy.getRecordEwmaSuccessRate(), record.getRecordEwmaSuccessRate());
+  BOOST_CHECK(copy.getRecordSmoothedRtt() == record.getRecordSmoothedRtt());
+  BOOST_CHECK_EQUAL(copy.getRecordThroughput(), record.getRecordThroughput());
+  BOOST_CHECK_EQUAL(copy.getRecordNacks(), record.getRecordNacks());
+}
+
+BOOST_AUTO_TEST_CASE(TestIncrementWithoutInterest)
 {
+  // a data packet that answers no Interest of the record is ignored
   StatsTableRecord record(Name("isp1"));
-  BOOST_REQUIRE_THROW(record.incrementReceivedData(), StatsTableRecord::Error);
+  BOOST_CHECK_NO_THROW(record.incrementReceivedData());
+  BOOST_CHECK_NO_THROW(record.incrementReceivedData(1000, time::milliseconds(100)));
 
   BOOST_CHECK_EQUAL(record.getRecordName().toUri(), "/isp1");
   BOOST_CHECK_EQUAL(record.getRecordSentInterests(), 0);
   BOOST_CHECK_EQUAL(record.getRecordReceivedData(), 0);
   BOOST_CHECK_EQUAL(record.getRecordSuccessRate(), 0);
+  BOOST_CHECK(!record.isRecordMeasured());
+  BOOST_CHECK(record.getRecordSmoothedRtt() == time::nanoseconds::zero());
+  BOOST_CHECK_EQUAL(record.getRecordThroughput(), 0);
 }
 
 BOOST_AUTO_TEST_CASE(TestEqualityOperator)
@@ -24,6 +24,10 @@
 
 #include <ndn-cxx/name.hpp>
 
+#include <iterator>
+#include <string>
+#include <vector>
+
 namespace ndn {
 namespace ntorrent {
 namespace tests {
@@ -51,6 +55,43 @@ BOOST_AUTO_TEST_CASE(TestCoreAPI)
   BOOST_CHECK(table.find(Name("isp4")) == table.end());
 }
 
+BOOST_AUTO_TEST_CASE(TestIndexedLookup)
+{
+  StatsTable table(Name("linux15.01"));
+  for (int i = 0; i < 1000; ++i) {
+    table.insert(Name("isp").appendNumber(i));
+  }
+  BOOST_CHECK_EQUAL(table.size(), 1000);
+
+  for (int i = 0; i < 1000; i += 2) {
+    BOOST_CHECK(table.erase(Name("isp").appendNumber(i)));
+  }
+  BOOST_CHECK_EQUAL(table.size(), 500);
+
+  const StatsTable& constTable = table;
+  for (int i = 0; i < 1000; ++i) {
+    Name prefix = Name("isp").appendNumber(i);
+    if (i % 2) {
+      BOOST_REQUIRE(table.find(prefix) != table.end());
+      BOOST_CHECK_EQUAL(table.find(prefix)->getRecordName(), prefix);
+      BOOST_CHECK(constTable.find(prefix) != constTable.end());
+    }
+    else {
+      BOOST_CHECK(table.find(prefix) == table.end());
+      BOOST_CHECK(constTable.find(prefix) == constTable.end());
+      BOOST_CHECK(!table.erase(prefix));
+    }
+  }
+
+  // a prefix can be inserted again once erased
+  table.insert(Name("isp").appendNumber(0));
+  BOOST_CHECK(table.find(Name("isp").appendNumber(0)) != table.end());
+  BOOST_CHECK_EQUAL(table.size(), 501);
+
+  table.clear();
+  BOOST_CHECK(table.find(Name("isp").appendNumber(1)) == table.end());
+}
+
 BOOST_AUTO_TEST_CASE(TestStatsTableModification)
 {
   StatsTable table(Name("linux15.01"));
@@ -214,15 +255,250 @@ BOOST_AUTO_TEST_CASE(TestTableSort)
 
   table.sort();
 
+  // the sort is stable, records with the same success rate keep their order
   i = table.begin();
-  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp3");
+  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp2");
   BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0.25);
 
   i++;
-  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp2");
+  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp3");
   BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0.25);
 }
 
+BOOST_AUTO_TEST_CASE(TestRanks)
+{
+  StatsTable table(Name("linux15.01"));
+  table.insert(Name("isp1"));
+  table.insert(Name("isp2"));
+  table.insert(Name("isp3"));
+  table.insert(Name("isp2"));
+  BOOST_CHECK_EQUAL(table.size(), 3);
+
+  auto ranked = [&table] {
+    std::vector<std::string> names;
+    for (auto i = table.rank_begin(); i != table.rank_end(); ++i) {
+      names.push_back(i->getRecordName().toUri());
+    }
+    return names;
+  };
+
+  // records with the same load are ranked in the order they were inserted
+  BOOST_CHECK(ranked() == std::vector<std::string>({"/isp1", "/isp2", "/isp3"}));
+
+  auto isp3 = table.find(Name("isp3"));
+  isp3->incrementSentInterests();
+  isp3->incrementReceivedData(1000, time::milliseconds(100));
+  // the rank only follows the stats once the record is updated
+  BOOST_CHECK(ranked() == std::vector<std::string>({"/isp1", "/isp2", "/isp3"}));
+  table.update(isp3);
+  BOOST_CHECK(ranked() == std::vector<std::string>({"/isp3", "/isp1", "/isp2"}));
+  BOOST_CHECK(table.selectRecord() == isp3);
+
+  // an outstanding Interest loads a record
+  auto isp1 = table.find(Name("isp1"));
+  isp1->incrementSentInterests();
+  table.update(isp1);
+  BOOST_CHECK(ranked() == std::vector<std::string>({"/isp3", "/isp2", "/isp1"}));
+
+  // iterators stay valid across insertions, erasures and sorting
+  auto isp2 = table.find(Name("isp2"));
+  table.insert(Name("isp4"));
+  BOOST_CHECK(table.erase(Name("isp1")));
+  table.sort();
+  BOOST_CHECK_EQUAL(isp2->getRecordName().toUri(), "/isp2");
+  BOOST_CHECK_EQUAL(isp3->getRecordName().toUri(), "/isp3");
+  BOOST_CHECK(ranked() == std::vector<std::string>({"/isp3", "/isp2", "/isp4"}));
+
+  for (int i = 0; i < 30; ++i) {
+    isp3->incrementSentInterests();
+  }
+  table.update(isp3);
+  BOOST_CHECK(ranked() == std::vector<std::string>({"/isp2", "/isp4", "/isp3"}));
+
+  // the records ranked ahead of the selected one are the only ones filtered
+  std::vector<std::string> filtered;
+  auto record = table.selectRecord([&filtered] (const StatsTableRecord& r) {
+    filtered.push_back(r.getRecordName().toUri());
+    return r.getRecordName() == Name("isp4");
+  });
+  BOOST_CHECK_EQUAL(record->getRecordName().toUri(), "/isp4");
+  BOOST_CHECK(filtered == std::vector<std::string>({"/isp2", "/isp4"}));
+
+  // a copy ranks its own records
+  StatsTable copy(table);
+  table.clear();
+  BOOST_CHECK(table.rank_begin() == table.rank_end());
+  BOOST_REQUIRE_EQUAL(copy.size(), 3);
+  BOOST_CHECK_EQUAL(copy.rank_begin()->getRecordName().toUri(), "/isp2");
+  auto copyIsp2 = copy.find(Name("isp2"));
+  copyIsp2->incrementSentInterests();
+  copyIsp2->incrementSentInterests();
+  copy.update(copyIsp2);
+  BOOST_CHECK_EQUAL(copy.rank_begin()->getRecordName().toUri(), "/isp4");
+}
+
+BOOST_AUTO_TEST_CASE(TestSelectRecord)
+{
+  StatsTable table(Name("linux15.01"));
+  BOOST_CHECK(table.selectRecord() == table.end());
+
+  table.insert(Name("isp1"));
+  table.insert(Name("isp2"));
+
+  // without any stats, the Interests alternate between the records
+  for (int i = 0; i < 4; ++i) {
+    auto record = table.selectRecord();
+    BOOST_CHECK_EQUAL(record->getRecordName().toUri(), i % 2 ? "/isp2" : "/isp1");
+    record->incrementSentInterests();
+    table.update(record);
+  }
+  for (auto& record : table) {
+    BOOST_CHECK_EQUAL(record.getRecordPendingInterests(), 2);
+  }
+
+  // isp1 retrieves all its data, isp2 half of it
+  auto isp1 = table.find(Name("isp1"));
+  isp1->incrementReceivedData();
+  isp1->incrementReceivedData();
+  table.update(isp1);
+  auto isp2 = table.find(Name("isp2"));
+  isp2->incrementReceivedData();
+  isp2->incrementTimeouts();
+  table.update(isp2);
+
+  // isp1 carries twice as many of the outstanding Interests as isp2
+  for (int i = 0; i < 6; ++i) {
+    auto record = table.selectRecord();
+    record->incrementSentInterests();
+    table.update(record);
+  }
+  BOOST_CHECK_EQUAL(isp1->getRecordPendingInterests(), 4);
+  BOOST_CHECK_EQUAL(isp2->getRecordPendingInterests(), 2);
+
+  // a record whose Interests all failed still gets a share of the Interests
+  table.insert(Name("isp3"));
+  auto isp3 = table.find(Name("isp3"));
+  isp3->incrementSentInterests();
+  isp3->incrementTimeouts();
+  table.update(isp3);
+  bool probed = false;
+  for (int i = 0; i < 50 && !probed; ++i) {
+    auto record = table.selectRecord();
+    probed = record->getRecordName() == Name("isp3");
+    record->incrementSentInterests();
+    table.update(record);
+  }
+  BOOST_CHECK(probed);
+}
+
+BOOST_AUTO_TEST_CASE(TestSelectRecordByGoodput)
+{
+  StatsTable table(Name("linux15.01"));
+  table.insert(Name("slow"));
+  table.insert(Name("fast"));
+
+  // both records answer every Interest, the fast one four times as soon
+  auto slow = table.find(Name("slow"));
+  slow->incrementSentInterests();
+  slow->incrementReceivedData(1000, time::milliseconds(200));
+  table.update(slow);
+  auto fast = table.find(Name("fast"));
+  fast->incrementSentInterests();
+  fast->incrementReceivedData(1000, time::milliseconds(50));
+  table.update(fast);
+
+  BOOST_CHECK(table.selectRecord() == fast);
+  for (int i = 0; i < 10; ++i) {
+    auto record = table.selectRecord();
+    record->incrementSentInterests();
+    table.update(record);
+  }
+  BOOST_CHECK_EQUAL(fast->getRecordPendingInterests(), 8);
+  BOOST_CHECK_EQUAL(slow->getRecordPendingInterests(), 2);
+
+  // the Interests of the slow record time out, which leaves it a third of its goodput, so the
+  // fast record takes more Interests than before the slow one is selected again
+  slow->incrementTimeouts();
+  slow->incrementTimeouts();
+  table.update(slow);
+  for (int i = 0; i < 3; ++i) {
+    auto record = table.selectRecord();
+    record->incrementSentInterests();
+    table.update(record);
+  }
+  BOOST_CHECK_EQUAL(fast->getRecordPendingInterests(), 11);
+  BOOST_CHECK_EQUAL(slow->getRecordPendingInterests(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestSelectNewRecord)
+{
+  StatsTable table(Name("linux15.01"));
+  table.insert(Name("measured"));
+
+  // the measured record answers every Interest in 100 ms, and is loaded with a full window
+  auto measured = table.find(Name("measured"));
+  measured->incrementSentInterests();
+  measured->incrementReceivedData(1000, time::milliseconds(100));
+  for (int i = 0; i < 50; ++i) {
+    measured->incrementSentInterests();
+  }
+  table.update(measured);
+  BOOST_CHECK(table.selectRecord() == measured);
+
+  // a newly learned record is tried before it
+  table.insert(Name("fresh"));
+  auto fresh = table.find(Name("fresh"));
+  BOOST_CHECK(table.selectRecord() == fresh);
+
+  // at the success rate advertised for it, until it has been tried
+  table.insert(Name("advertised"));
+  auto advertised = table.find(Name("advertised"));
+  advertised->setRecordAdvertisedSuccessRate(0.1);
+  table.update(advertised);
+  fresh->setRecordAdvertisedSuccessRate(0.1);
+  table.update(fresh);
+  BOOST_CHECK(table.selectRecord() == measured);
+  advertised->setRecordAdvertisedSuccessRate(0.9);
+  table.update(advertised);
+  BOOST_CHECK(table.selectRecord() == advertised);
+}
+
+BOOST_AUTO_TEST_CASE(TestEraseStale)
+{
+  StatsTable table(Name("linux15.01"));
+  table.insert(Name("isp1"));
+  table.insert(Name("isp2"));
+  table.insert(Name("isp3"));
+
+  auto now = time::steady_clock::now();
+  table.find(Name("isp1"))->setRecordLastSeen(now - time::minutes(10));
+  table.find(Name("isp2"))->setRecordLastSeen(now - time::minutes(10));
+  table.find(Name("isp2"))->incrementSentInterests();
+  table.find(Name("isp3"))->setRecordLastSeen(now - time::minutes(1));
+
+  // isp2 is kept while an Interest is outstanding through it
+  BOOST_CHECK_EQUAL(table.eraseStale(now - time::minutes(5)), 1);
+  BOOST_CHECK_EQUAL(table.size(), 2);
+  BOOST_CHECK(table.find(Name("isp1")) == table.end());
+  BOOST_CHECK(table.find(Name("isp2")) != table.end());
+  BOOST_CHECK_EQUAL(std::distance(table.rank_begin(), table.rank_end()), 2);
+
+  // refreshing never moves the last seen time back
+  table.find(Name("isp3"))->refresh(now - time::minutes(20));
+  BOOST_CHECK(table.find(Name("isp3"))->getRecordLastSeen() == now - time::minutes(1));
+
+  table.find(Name("isp2"))->incrementTimeouts();
+  std::vector<Name> erased;
+  BOOST_CHECK_EQUAL(table.eraseStale(now - time::minutes(5),
+                                     [&erased] (const Name& prefix) {
+                                       erased.push_back(prefix);
+                                     }), 1);
+  BOOST_REQUIRE_EQUAL(erased.size(), 1);
+  BOOST_CHECK_EQUAL(erased[0], Name("isp2"));
+  BOOST_CHECK_EQUAL(table.size(), 1);
+  BOOST_CHECK_EQUAL(std::distance(table.rank_begin(), table.rank_end()), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace tests
@@ -23,6 +23,8 @@
 
 #include "torrent-file.hpp"
 #include "file-manifest.hpp"
+#include "manifest-tree-node.hpp"
+#include "util/io-util.hpp"
 
 #include <ndn-cxx/data.hpp>
 #include <ndn-cxx/signature.hpp>
@@ -33,6 +35,8 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 
+#include <set>
+
 namespace fs = boost::filesystem;
 
 BOOST_TEST_DONT_PRINT_LOG_VALUE(std::nullptr_t)
@@ -458,6 +462,81 @@ BOOST_AUTO_TEST_CASE(TestTorrentFileGenerator)
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestTorrentFileGenerateStreaming)
+{
+  for (size_t namesPerSegment : {1, 2, 3, 1024}) {
+    auto content = TorrentFile::generate("tests/testdata/foo", namesPerSegment, 20, 512);
+    std::vector<Name> manifestNames;
+    for (const auto& ms : content.second) {
+      for (const auto& m : ms.first | boost::adaptors::reversed) {
+        manifestNames.push_back(m.getFullName());
+      }
+    }
+
+    std::vector<Data> segments;
+    auto numSegments = TorrentFile::generateStreaming("tests/testdata/foo", namesPerSegment,
+                                                      20, 512,
+                                                      [&segments] (const Data& d) {
+                                                        segments.push_back(d);
+                                                      });
+    BOOST_CHECK_EQUAL(content.first.size(), numSegments);
+    BOOST_REQUIRE_EQUAL(manifestNames.size() + numSegments, segments.size());
+    // the manifests come first, each file from its last to its initial sub-manifest
+    for (size_t i = 0; i < manifestNames.size(); ++i) {
+      BOOST_CHECK_EQUAL(manifestNames[i], segments[i].getFullName());
+    }
+    // followed by the torrent-file segments, from the last to the initial one
+    for (size_t i = 0; i < numSegments; ++i) {
+      const auto& expected = content.first[numSegments - 1 - i];
+      TorrentFile segment(segments[manifestNames.size() + i].wireEncode());
+      BOOST_CHECK_EQUAL(expected.getFullName(), segment.getFullName());
+      BOOST_CHECK_EQUAL(expected, segment);
+    }
+  }
+  BOOST_CHECK_THROW(TorrentFile::generateStreaming("tests/testdata/foo-fake", 1, 20, 512,
+                                                   [] (const Data&) {}),
+                    TorrentFile::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestTorrentFileGenerateStreamingTree)
+{
+  std::vector<Data> segments;
+  auto numSegments = TorrentFile::generateStreaming("tests/testdata/foo", 1024, 1, 1024,
+                                                    [&segments] (const Data& d) {
+                                                      segments.push_back(d);
+                                                    },
+                                                    4);
+  BOOST_REQUIRE_EQUAL(1, numSegments);
+  TorrentFile torrentFile(segments.back().wireEncode());
+
+  std::set<Name> roots;
+  size_t manifestCount = 0;
+  for (const auto& d : segments) {
+    switch (IoUtil::findType(d.getFullName())) {
+      case IoUtil::MANIFEST_TREE_NODE:
+        if (ManifestTreeNode(d.wireEncode()).isRoot()) {
+          roots.insert(d.getFullName());
+        }
+        break;
+      case IoUtil::FILE_MANIFEST:
+        // the sub-manifests are not chained
+        BOOST_CHECK(nullptr == FileManifest(d.wireEncode()).submanifest_ptr());
+        ++manifestCount;
+        break;
+      default:
+        break;
+    }
+  }
+  // 1 + 48 + 48 sub-manifests
+  BOOST_CHECK_EQUAL(97, manifestCount);
+  // the catalog holds the root of the tree of each file instead of its initial sub-manifest
+  const auto& catalog = torrentFile.getCatalog();
+  std::set<Name> catalogNames(catalog.begin(), catalog.end());
+  BOOST_CHECK_EQUAL(3, catalog.size());
+  BOOST_CHECK_EQUAL_COLLECTIONS(roots.begin(), roots.end(),
+                                catalogNames.begin(), catalogNames.end());
+}
+
 } // namespace tests
 
 } // namespace ntorrent
@@ -22,10 +22,16 @@
 #include "boost-test.hpp"
 
 #include "dummy-parser-fixture.hpp"
+#include "manifest-tree-node.hpp"
 #include "torrent-manager.hpp"
 #include "torrent-file.hpp"
 #include "unit-test-time-fixture.hpp"
+#include "util/io-util.hpp"
+#include "util/metadata-store.hpp"
+#include "util/signer.hpp"
 
+#include <algorithm>
+#include <map>
 #include <set>
 
 #include <boost/filesystem.hpp>
@@ -51,23 +57,30 @@ public:
   : TorrentManager(torrentFileName, filePath, false, face)
   , m_face(face)
   {
-    m_keyChain = make_shared<KeyChain>();
   }
 
   std::vector<TorrentFile> torrentSegments() const {
-    return m_torrentSegments;
+    std::vector<TorrentFile> segments;
+    for (const auto& kv : m_torrentSegments) {
+      segments.push_back(*kv.second);
+    }
+    return segments;
   }
 
   std::vector<FileManifest> fileManifests() const {
-    return m_fileManifests;
+    std::vector<FileManifest> manifests;
+    for (const auto& kv : m_fileManifests) {
+      manifests.push_back(*loadFileManifest(kv));
+    }
+    return manifests;
   }
 
   void pushTorrentSegment(const TorrentFile& t) {
-    m_torrentSegments.push_back(t);
+    m_torrentSegments.emplace(t.getSegmentNumber(), make_shared<const TorrentFile>(t));
   }
 
   void pushFileManifestSegment(const FileManifest& m) {
-    m_fileManifests.push_back(m);
+    insertFileManifest(make_shared<const FileManifest>(m));
   }
 
   shared_ptr<Name> findTorrentFileSegmentToDownload() {
@@ -79,6 +92,11 @@ public:
   }
 
   std::vector<bool> fileState(const ndn::Name& manifestName) {
+    // the packets on disk are checked the first time the state is needed
+    auto manifest = manifestName.empty() ? nullptr : findFileManifest(manifestName.getPrefix(-1));
+    if (nullptr != manifest && manifest->getFullName() == manifestName) {
+      findFileState(*manifest);
+    }
     auto fout = m_fileStates[manifestName].first;
     if (nullptr != fout) {
       fout->flush();
@@ -90,13 +108,30 @@ public:
                     std::shared_ptr<fs::fstream> f,
                     const std::vector<bool>& stateVec) {
 
+    m_uncheckedFileStates.erase(manifestName);
     m_fileStates.insert({ manifestName, std::make_pair(f, stateVec) });
   }
 
+  bool isFileStateChecked(const ndn::Name& manifestName) const {
+    return 0 == m_uncheckedFileStates.count(manifestName);
+  }
+
   bool writeData(const Data& data) {
     return TorrentManager::writeData(data);
   }
 
+  size_t windowSize() const {
+    return WINDOW_SIZE;
+  }
+
+  size_t maxCongestionRetries() const {
+    return MAX_CONGESTION_RETRIES;
+  }
+
+  time::milliseconds initialCongestionBackoff() const {
+    return INITIAL_CONGESTION_BACKOFF;
+  }
+
   bool writeTorrentSegment(const TorrentFile& segment, const std::string& path) {
     return TorrentManager::writeTorrentSegment(segment, path);
   }
@@ -105,16 +140,19 @@ public:
     return TorrentManager::writeFileManifest(manifest, path);
   }
 
+  shared_ptr<MetadataStore> metadataStore() const {
+    return m_metadataStore;
+  }
+
   void sendRoutablePrefixResponse() {
     // Create a data packet containing one name as content
     shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
                                                        { Name("ucla") });
-    m_keyChain->sign(*d);
+    Signer::getDefault().sign(*d);
     m_face->receive(*d);
   }
 
 private:
-  shared_ptr<KeyChain> m_keyChain;
   shared_ptr<DummyClientFace> m_face;
 };
 
@@ -145,6 +183,66 @@ public:
   }
 };
 
+class TorrentFixture : public FaceFixture
+{
+public:
+  TorrentFixture()
+    : initialSegmentName("/ndn/multicast/NTORRENT/foo/torrent-file/sha256digest=9e0410fa477309b40a4ef9cb2bebe70ed2e9fa2defcb584979d768b3f6ced981")
+    , filePath("tests/testdata/temp")
+  {
+  }
+
+  ~TorrentFixture()
+  {
+    fs::remove_all(filePath);
+  }
+
+  // Generate the torrent of "tests/testdata/foo" and write its segments and manifests where
+  // Initialize() reads them
+  void
+  writeTorrent()
+  {
+    auto temp = TorrentFile::generate("tests/testdata/foo", 1024, 1024, 1024, true);
+    torrentSegments = temp.first;
+    for (const auto& ms : temp.second) {
+      manifests.insert(manifests.end(), ms.first.begin(), ms.first.end());
+      fileData.push_back(ms.second);
+    }
+    std::string dirPath = ".appdata/foo/";
+    auto torrentPath = dirPath + "torrent_files/";
+    boost::filesystem::create_directories(torrentPath);
+    auto fileNum = 0;
+    for (const auto& t : torrentSegments) {
+      fileNum++;
+      io::save(t, torrentPath + to_string(fileNum));
+    }
+    auto manifestPath = dirPath + "manifests/";
+    for (const auto& m : manifests) {
+      fs::path filename = manifestPath + m.file_name() + "/" + to_string(m.submanifest_number());
+      boost::filesystem::create_directories(filename.parent_path());
+      io::save(m, filename.string());
+    }
+  }
+
+  // Initialize the specified 'manager' and answer its request for its routable prefix
+  void
+  initialize(TestTorrentManager& manager)
+  {
+    manager.Initialize();
+    advanceClocks(time::milliseconds(1), 10);
+    manager.sendRoutablePrefixResponse();
+    advanceClocks(time::milliseconds(1), 10);
+  }
+
+public:
+  Name                 initialSegmentName;
+  std::string          filePath;
+  vector<TorrentFile>  torrentSegments;
+  vector<FileManifest> manifests;
+  // for each file, the data packets
+  vector<vector<Data>> fileData;
+};
+
 BOOST_FIXTURE_TEST_SUITE(TestTorrentManagerInitialize, FaceFixture)
 
 BOOST_AUTO_TEST_CASE(CheckInitializeComplete)
@@ -390,6 +488,139 @@ BOOST_AUTO_TEST_CASE(CheckInitializeMissingManifests)
   }
 }
 
+BOOST_AUTO_TEST_CASE(CheckInitializeManifestTree)
+{
+  // the catalog holds the root of the tree of each file, 1 + 3 + 3 sub-manifests under a fanout
+  // of 2
+  std::string dirPath = ".appdata/foo/";
+  std::string torrentPath = dirPath + "torrent_files/";
+  std::string manifestPath = dirPath + "manifests/";
+  boost::filesystem::create_directories(torrentPath);
+  Name initialSegmentName;
+  vector<FileManifest> manifests;
+  std::set<Name> rootNames;
+  TorrentFile::generateStreaming("tests/testdata/foo", 1024, 16, 1024,
+                                 [&] (const Data& d) {
+                                   switch (IoUtil::findType(d.getFullName())) {
+                                     case IoUtil::TORRENT_FILE: {
+                                       TorrentFile t(d.wireEncode());
+                                       io::save(t, torrentPath + to_string(t.getSegmentNumber()));
+                                       initialSegmentName = t.getFullName();
+                                       break;
+                                     }
+                                     case IoUtil::MANIFEST_TREE_NODE: {
+                                       ManifestTreeNode node(d.wireEncode());
+                                       IoUtil::writeManifestTreeNode(node, manifestPath);
+                                       if (node.isRoot()) {
+                                         rootNames.insert(node.getFullName());
+                                       }
+                                       break;
+                                     }
+                                     default:
+                                       manifests.push_back(FileManifest(d.wireEncode()));
+                                       IoUtil::writeFileManifest(manifests.back(), manifestPath);
+                                       break;
+                                   }
+                                 },
+                                 2);
+  BOOST_REQUIRE_EQUAL(7, manifests.size());
+  BOOST_REQUIRE_EQUAL(3, rootNames.size());
+
+  TestTorrentManager manager(initialSegmentName, "tests/testdata/", face);
+  manager.Initialize();
+  BOOST_CHECK(manager.hasAllTorrentSegments());
+
+  advanceClocks(time::milliseconds(1), 10);
+  manager.sendRoutablePrefixResponse();
+
+  // every sub-manifest is verified through its tree, and the packets of the last one of each
+  // file are found at their offset
+  std::set<Name> manifestNames;
+  for (const auto& m : manifests) {
+    manifestNames.insert(m.getFullName());
+  }
+  auto fileManifests = manager.fileManifests();
+  BOOST_CHECK_EQUAL(manifests.size(), fileManifests.size());
+  for (const auto& m : fileManifests) {
+    BOOST_CHECK_EQUAL(1, manifestNames.count(m.getFullName()));
+    auto fileState = manager.fileState(m.getFullName());
+    BOOST_CHECK_EQUAL(m.catalog_size(), fileState.size());
+    BOOST_CHECK(std::all_of(fileState.begin(), fileState.end(), [] (bool s) { return s; }));
+  }
+  vector<Name> missing;
+  manager.findFileManifestsToDownload(missing);
+  BOOST_CHECK(missing.empty());
+
+  // the nodes are seeded along with the manifests
+  face->receive(Interest(*rootNames.begin()));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_REQUIRE(!face->sentData.empty());
+  BOOST_CHECK_EQUAL(*rootNames.begin(), face->sentData.back().getFullName());
+
+  // without one of its sub-manifests, the tree of the file is downloaded again from its root
+  auto removed = std::find_if(manifests.begin(), manifests.end(),
+                              [] (const FileManifest& m) { return 1 == m.submanifest_number(); });
+  BOOST_REQUIRE(manifests.end() != removed);
+  fs::remove(manifestPath + removed->file_name() + "/1");
+  manager.Initialize();
+  BOOST_CHECK_EQUAL(manifests.size() - 1, manager.fileManifests().size());
+  manager.findFileManifestsToDownload(missing);
+  BOOST_REQUIRE_EQUAL(1, missing.size());
+  BOOST_CHECK_EQUAL(1, rootNames.count(missing.front()));
+  BOOST_CHECK(removed->getName().getPrefix(-1).isPrefixOf(missing.front()));
+
+  fs::remove_all(".appdata");
+}
+
+BOOST_AUTO_TEST_CASE(CheckInitializeChecksDataOnDemand)
+{
+  Name initialSegmentName = "/ndn/multicast/NTORRENT/foo/torrent-file/sha256digest=9e0410fa477309b40a4ef9cb2bebe70ed2e9fa2defcb584979d768b3f6ced981";
+  auto temp = TorrentFile::generate("tests/testdata/foo", 1024, 1024, 1024, false);
+  vector<FileManifest> manifests;
+  for (const auto& ms : temp.second) {
+    manifests.insert(manifests.end(), ms.first.begin(), ms.first.end());
+  }
+  BOOST_REQUIRE_GE(manifests.size(), 2);
+  std::string dirPath = ".appdata/foo/";
+  std::string torrentPath = dirPath + "torrent_files/";
+  fs::create_directories(torrentPath);
+  auto fileNum = 0;
+  for (const auto& t : temp.first) {
+    io::save(t, torrentPath + to_string(++fileNum));
+  }
+  for (const auto& m : manifests) {
+    fs::path filename = dirPath + "manifests/" + m.file_name() + "/" +
+                        to_string(m.submanifest_number());
+    fs::create_directories(filename.parent_path());
+    io::save(m, filename.string());
+  }
+
+  // the data of the torrent, all of it on disk, is not read at startup
+  TestTorrentManager manager(initialSegmentName, "tests/testdata/", face);
+  manager.Initialize();
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(manager.fileManifests().size(), manifests.size());
+  for (const auto& m : manifests) {
+    BOOST_CHECK(!manager.isFileStateChecked(m.getFullName()));
+  }
+
+  // but the first time a packet of a file is looked up, for that file only
+  const auto& m0 = manifests[0];
+  BOOST_CHECK(manager.hasDataPacket(m0.catalog_entry(0)));
+  BOOST_CHECK(manager.isFileStateChecked(m0.getFullName()));
+  BOOST_CHECK(!manager.isFileStateChecked(manifests[1].getFullName()));
+
+  // and the packets of a file are served once they are requested
+  const auto& m1 = manifests[1];
+  face->receive(Interest(m1.catalog_entry(0)));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK(manager.isFileStateChecked(m1.getFullName()));
+  BOOST_REQUIRE_EQUAL(face->sentData.size(), 1);
+  BOOST_CHECK_EQUAL(face->sentData[0].getName(), m1.catalog_entry(0).getPrefix(-1));
+
+  fs::remove_all(".appdata");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE(TestTorrentManagerNetworkingStuff, FaceFixture)
@@ -523,6 +754,86 @@ BOOST_AUTO_TEST_CASE(TestDownloadingFileManifests)
   fs::remove_all(".appdata");
 }
 
+BOOST_AUTO_TEST_CASE(TestDownloadingManifestTree)
+{
+  // 3 sub-manifests under a fanout of 2: 2 + 1 nodes
+  auto tree = FileManifest::generateTree("tests/testdata/foo/bar1.txt",
+                                         "/ndn/multicast/NTORRENT/foo/", 16, 1024, 2);
+  auto& leaves = tree.first;
+  auto& nodes = tree.second;
+  BOOST_REQUIRE_EQUAL(3, leaves.size());
+  BOOST_REQUIRE_EQUAL(3, nodes.size());
+  auto& root = nodes.back();
+
+  std::string filePath = ".appdata/foo/";
+  TestTorrentManager manager("/ndn/multicast/NTORRENT/foo/torrent-file/sha256digest=9e0410fa477309b40a4ef9cb2bebe70ed2e9fa2defcb584979d768b3f6ced981",
+                             filePath, face);
+  manager.Initialize();
+
+  advanceClocks(time::milliseconds(1), 10);
+  manager.sendRoutablePrefixResponse();
+
+  auto hasSent = [this] (const Name& name) {
+    return std::any_of(face->sentInterests.begin(), face->sentInterests.end(),
+                       [&name] (const Interest& interest) { return interest.getName() == name; });
+  };
+  vector<Name> packetNames;
+  vector<Name> failures;
+  manager.download_file_manifest(root.getFullName(), filePath + "manifests/",
+                                 [&packetNames] (const std::vector<ndn::Name>& vec) {
+                                   packetNames.insert(packetNames.end(), vec.begin(), vec.end());
+                                 },
+                                 [&failures] (const ndn::Name& name, const std::string& reason) {
+                                   failures.push_back(name);
+                                 });
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK(hasSent(root.getFullName()));
+  face->receive(dynamic_cast<Data&>(root));
+  advanceClocks(time::milliseconds(1), 10);
+  // the nodes of a level are requested at once
+  BOOST_CHECK(hasSent(nodes[0].getFullName()));
+  BOOST_CHECK(hasSent(nodes[1].getFullName()));
+
+  // a forged node does not match the digest its parent holds
+  ManifestTreeNode forged(root.getFilePrefix(), 1, 0, 2, 3);
+  forged.insert(leaves[0].getFullName());
+  forged.finalize();
+  Signer::getDefault().sign(forged);
+  face->receive(dynamic_cast<Data&>(forged));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK(!hasSent(leaves[0].getFullName()));
+
+  face->receive(dynamic_cast<Data&>(nodes[0]));
+  face->receive(dynamic_cast<Data&>(nodes[1]));
+  advanceClocks(time::milliseconds(1), 10);
+  for (const auto& leaf : leaves) {
+    BOOST_CHECK(hasSent(leaf.getFullName()));
+  }
+  // a new torrent keeps its metadata in its binary store
+  auto store = manager.metadataStore();
+  BOOST_REQUIRE(nullptr != store);
+  BOOST_CHECK(std::any_of(store->entries().begin(), store->entries().end(),
+                          [&nodes] (const MetadataStore::Entry& entry) {
+                            return entry.fullName == nodes[1].getFullName();
+                          }));
+  BOOST_CHECK(!fs::exists(filePath + "manifests"));
+
+  // the packets of the last sub-manifest are requested once the size of the others is known
+  face->receive(dynamic_cast<Data&>(leaves[2]));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK(packetNames.empty());
+  face->receive(dynamic_cast<Data&>(leaves[0]));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(leaves[0].catalog_size() + leaves[2].catalog_size(), packetNames.size());
+  face->receive(dynamic_cast<Data&>(leaves[1]));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(48, packetNames.size());
+  BOOST_CHECK(failures.empty());
+  BOOST_CHECK_EQUAL(3, manager.fileManifests().size());
+
+  fs::remove_all(".appdata");
+}
+
 BOOST_AUTO_TEST_CASE(TestDownloadingDataPackets)
 {
   std::string filePath = ".appdata/foo/";
@@ -811,6 +1122,60 @@ BOOST_AUTO_TEST_CASE(TestFindManifestSegmentToDownload2)
   fs::remove_all(".appdata");
 }
 
+BOOST_AUTO_TEST_CASE(TestMissingPacketCursor)
+{
+  std::string filePath = ".appdata/foo/";
+  TestTorrentManager manager("/ndn/multicast/NTORRENT/foo/torrent-file/sha256digest",
+                             filePath, face);
+
+  manager.Initialize();
+
+  advanceClocks(time::milliseconds(1), 10);
+  manager.sendRoutablePrefixResponse();
+
+  auto manifests = FileManifest::generate("tests/testdata/foo/bar.txt",
+                                          "/ndn/multicast/NTORRENT/foo/", 10, 10);
+  BOOST_REQUIRE(manifests.size() > 2);
+  for (const auto& m : manifests) {
+    manager.pushFileManifestSegment(m);
+  }
+  // we have some of the packets of the first two segments
+  std::vector<bool> v1(manifests[0].catalog_size(), true);
+  v1[3] = false;
+  manager.setFileState(manifests[0].getFullName(), make_shared<fs::fstream>(), v1);
+  std::vector<bool> v2(manifests[1].catalog_size(), false);
+  v2[0] = true;
+  manager.setFileState(manifests[1].getFullName(), make_shared<fs::fstream>(), v2);
+
+  vector<Name> expected;
+  manager.findAllMissingDataPackets(expected);
+  BOOST_CHECK_EQUAL(expected[0], manifests[0].catalog_entry(3));
+  BOOST_CHECK_EQUAL(expected[1], manifests[1].catalog_entry(1));
+
+  // pull the missing packets a few at a time
+  vector<Name> names;
+  TorrentManager::MissingPacketCursor cursor;
+  while (!cursor.done()) {
+    auto count = manager.nextMissingDataPackets(cursor, names, 3);
+    BOOST_CHECK_LE(count, 3);
+  }
+  BOOST_CHECK_EQUAL_COLLECTIONS(names.begin(), names.end(), expected.begin(), expected.end());
+  BOOST_CHECK_EQUAL(0, manager.nextMissingDataPackets(cursor, names, 3));
+
+  // the indices can be visited without building names
+  size_t visited = 0;
+  TorrentManager::MissingPacketCursor cursor2;
+  manager.visitMissingDataPackets(cursor2, 1,
+                                  [&visited, &manifests] (const FileManifest& m, size_t index) {
+                                    BOOST_CHECK(m == manifests[0]);
+                                    BOOST_CHECK_EQUAL(3, index);
+                                    ++visited;
+                                  });
+  BOOST_CHECK_EQUAL(1, visited);
+  BOOST_CHECK(!cursor2.done());
+  fs::remove_all(".appdata");
+}
+
 BOOST_AUTO_TEST_CASE(TestDataAlreadyDownloaded)
 {
   vector<FileManifest> manifests;
@@ -885,6 +1250,19 @@ BOOST_AUTO_TEST_CASE(TestDataAlreadyDownloaded)
   p2 = Name(p2.toUri() + "/sha256digest");
 
   BOOST_CHECK(manager.hasDataPacket(p2));
+
+  // names out of the catalog of the manifest are not held
+  Name p3("/ndn/multicast/NTORRENT/foo/bar.txt");
+  p3.appendSequenceNumber(0);
+  p3.appendSequenceNumber(100);
+  p3 = Name(p3.toUri() + "/sha256digest");
+  BOOST_CHECK(!manager.hasDataPacket(p3));
+
+  Name p4("/ndn/multicast/NTORRENT/foo/bar.txt");
+  p4.appendSequenceNumber(0);
+  p4 = Name(p4.toUri() + "/packet/sha256digest");
+  BOOST_CHECK(!manager.hasDataPacket(p4));
+  BOOST_CHECK(!manager.hasDataPacket(Name("/sha256digest")));
 }
 
 BOOST_AUTO_TEST_CASE(CheckSeedComplete)
@@ -1108,6 +1486,462 @@ BOOST_AUTO_TEST_CASE(CheckSeedRandom)
   fs::remove_all(".appdata");
 }
 
+BOOST_FIXTURE_TEST_CASE(CheckSeedAvailability, TorrentFixture)
+{
+  writeTorrent();
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  const auto& manifest = manifests.front();
+  const auto& packets = fileData.front();
+  BOOST_REQUIRE_GE(packets.size(), 3);
+  Name availabilityName = PieceAvailability::makeName(manifest.getFullName());
+
+  // none of the packets of the manifest is held yet
+  face->receive(Interest(availabilityName));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_REQUIRE_EQUAL(face->sentData.size(), 1);
+  auto advertisement = face->sentData.back();
+  BOOST_CHECK(availabilityName.isPrefixOf(advertisement.getName()));
+  BOOST_CHECK_EQUAL(PieceAvailability::getVersion(advertisement.getName()), 0);
+  auto bitmap = PieceAvailability::decode(advertisement.getContent());
+  BOOST_CHECK_EQUAL(bitmap.size(), manifest.catalog_size());
+  BOOST_CHECK(std::none_of(bitmap.begin(), bitmap.end(), [] (bool b) { return b; }));
+
+  // the advertisement follows the packets written
+  BOOST_CHECK(manager.writeData(packets[0]));
+  BOOST_CHECK(manager.writeData(packets[2]));
+  face->receive(Interest(availabilityName));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_REQUIRE_EQUAL(face->sentData.size(), 2);
+  advertisement = face->sentData.back();
+  BOOST_CHECK_EQUAL(PieceAvailability::getVersion(advertisement.getName()), 2);
+  bitmap = PieceAvailability::decode(advertisement.getContent());
+  BOOST_REQUIRE_EQUAL(bitmap.size(), manifest.catalog_size());
+  BOOST_CHECK(bitmap[0]);
+  BOOST_CHECK(!bitmap[1]);
+  BOOST_CHECK(bitmap[2]);
+  BOOST_CHECK_EQUAL(std::count(bitmap.begin(), bitmap.end(), true), 2);
+
+  // nothing is advertised for a manifest we do not have
+  face->receive(Interest(PieceAvailability::makeName("/ndn/multicast/NTORRENT/foo/missing")));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(face->sentData.size(), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckFetchAvailabilityFromPeers, TorrentFixture)
+{
+  writeTorrent();
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  const auto& manifest = manifests.front();
+  const auto& packets = fileData.front();
+  BOOST_REQUIRE_GE(packets.size(), 2);
+  Name availabilityName = PieceAvailability::makeName(manifest.getFullName());
+  auto sentAvailabilityInterests = [&] {
+    vector<Interest> interests;
+    for (const auto& i : face->sentInterests) {
+      if (i.getName() == availabilityName) {
+        interests.push_back(i);
+      }
+    }
+    return interests;
+  };
+
+  manager.download_data_packet(packets[1].getFullName(),
+                               [] (const Name&) {},
+                               [] (const Name&, const std::string&) {});
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(sentAvailabilityInterests().size(), 0);
+
+  // a new peer is asked for the packets it holds of the manifest of the requested packet
+  face->receive(Interest("/NTORRENT/foo/ALIVE/memphis"));
+  advanceClocks(time::milliseconds(1), 10);
+  auto interests = sentAvailabilityInterests();
+  BOOST_REQUIRE_EQUAL(interests.size(), 1);
+  BOOST_REQUIRE(interests[0].hasLink());
+  BOOST_CHECK_EQUAL(interests[0].getLink().getDelegations().begin()->second, Name("/memphis"));
+
+  // while the advertisement is outstanding, it is not asked again
+  face->receive(Interest("/NTORRENT/foo/ALIVE/chicago"));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(sentAvailabilityInterests().size(), 1);
+
+  auto advertisement = PieceAvailability::makeData(manifest.getFullName(), {false, true});
+  Signer::getDefault().sign(*advertisement);
+  face->receive(*advertisement);
+  advanceClocks(time::milliseconds(1), 10);
+  const auto& availability = manager.getPieceAvailability();
+  BOOST_CHECK(availability.has("/memphis", manifest.getName(), 1));
+  BOOST_CHECK(!availability.has("/memphis", manifest.getName(), 0));
+
+  // the advertisement is dropped once the peer expires
+  advanceClocks(time::seconds(1), UpdateHandler::PEER_LIFETIME.count() / 1000 + 10);
+  face->receive(Interest("/NTORRENT/foo/ALIVE/boston"));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK(!availability.has("/memphis", manifest.getName(), 1));
+  BOOST_CHECK(availability.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckQueuedPacketFollowsAvailability, TorrentFixture)
+{
+  writeTorrent();
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  const auto& manifest = manifests.front();
+  const auto& packets = fileData.front();
+  BOOST_REQUIRE_GE(packets.size(), 3);
+  auto lastSentTo = [&] (const Name& name) {
+    auto interest = std::find_if(face->sentInterests.rbegin(), face->sentInterests.rend(),
+                                 [&name] (const Interest& i) { return i.getName() == name; });
+    BOOST_REQUIRE(face->sentInterests.rend() != interest);
+    BOOST_REQUIRE(interest->hasLink());
+    return interest->getLink().getDelegations().begin()->second;
+  };
+
+  // learn two peers, before anything is requested
+  face->receive(Interest("/NTORRENT/foo/ALIVE/memphis"));
+  face->receive(Interest("/NTORRENT/foo/ALIVE/chicago"));
+  advanceClocks(time::milliseconds(1), 10);
+
+  // fill the window, and queue two packets of the manifest behind it
+  vector<Name> fillerNames;
+  for (size_t i = 0; i < manager.windowSize(); ++i) {
+    fillerNames.push_back(Name("/foo/bar").appendSequenceNumber(i).append("digest"));
+  }
+  for (const auto& name : fillerNames) {
+    manager.download_data_packet(name,
+                                 [] (const Name&) {}, [] (const Name&, const std::string&) {});
+  }
+  for (size_t i = 1; i <= 2; ++i) {
+    manager.download_data_packet(packets[i].getFullName(),
+                                 [] (const Name&) {}, [] (const Name&, const std::string&) {});
+  }
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK(std::none_of(face->sentInterests.begin(), face->sentInterests.end(),
+                           [&packets] (const Interest& i) {
+                             return i.getName() == packets[1].getFullName();
+                           }));
+
+  // "/chicago" is seen alive again, so it is asked for the packets it holds of the manifest
+  face->receive(Interest("/NTORRENT/foo/ALIVE/chicago"));
+  advanceClocks(time::milliseconds(1), 10);
+
+  // "/memphis" answers one of its Interests fast, which frees a slot for the advertisement
+  auto memphisFiller = std::find_if(fillerNames.begin(), fillerNames.end(),
+                                    [&] (const Name& name) {
+                                      return Name("/memphis") == lastSentTo(name);
+                                    });
+  BOOST_REQUIRE(fillerNames.end() != memphisFiller);
+  auto filler = make_shared<Data>(*memphisFiller);
+  Signer::getDefault().sign(*filler);
+  face->receive(*filler);
+  advanceClocks(time::milliseconds(1), 10);
+  Name availabilityName = PieceAvailability::makeName(manifest.getFullName());
+  BOOST_CHECK_EQUAL(lastSentTo(availabilityName), Name("/chicago"));
+
+  // the advertisement arrives, slowly, after the packets were queued, and routes the one it holds
+  advanceClocks(time::milliseconds(10), 50);
+  auto advertisement = PieceAvailability::makeData(manifest.getFullName(), {false, true});
+  Signer::getDefault().sign(*advertisement);
+  face->receive(*advertisement);
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(lastSentTo(packets[1].getFullName()), Name("/chicago"));
+
+  // while the packet it does not hold goes to the fastest prefix
+  auto memphisFiller2 = std::find_if(memphisFiller + 1, fillerNames.end(),
+                                     [&] (const Name& name) {
+                                       return Name("/memphis") == lastSentTo(name);
+                                     });
+  BOOST_REQUIRE(fillerNames.end() != memphisFiller2);
+  auto filler2 = make_shared<Data>(*memphisFiller2);
+  Signer::getDefault().sign(*filler2);
+  face->receive(*filler2);
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(lastSentTo(packets[2].getFullName()), Name("/memphis"));
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckNackMissingPacket, TorrentFixture)
+{
+  writeTorrent();
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  const auto& packets = fileData.front();
+  BOOST_REQUIRE_GE(packets.size(), 2);
+  BOOST_CHECK(manager.writeData(packets[0]));
+
+  // a packet we have is served
+  face->receive(Interest(packets[0].getFullName()));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(face->sentData.size(), 1);
+  BOOST_CHECK_EQUAL(face->sentNacks.size(), 0);
+
+  // a packet of a manifest we have, that we miss, is Nacked at once
+  face->receive(Interest(packets[1].getFullName()));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(face->sentData.size(), 1);
+  BOOST_REQUIRE_EQUAL(face->sentNacks.size(), 1);
+  BOOST_CHECK_EQUAL(face->sentNacks[0].getInterest().getName(), packets[1].getFullName());
+  BOOST_CHECK_EQUAL(face->sentNacks[0].getReason(), lp::NackReason::NO_ROUTE);
+
+  // a packet of a manifest we do not know about is not
+  face->receive(Interest("/ndn/multicast/NTORRENT/foo/missing/%00%01/sha256digest=00"));
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(face->sentNacks.size(), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckNackedPacketRetry, TorrentFixture)
+{
+  writeTorrent();
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  // learn another peer, from its "ALIVE" Interest
+  face->receive(Interest("/NTORRENT/foo/ALIVE/memphis"));
+  advanceClocks(time::milliseconds(1), 10);
+
+  const Name packetName = fileData.front().at(1).getFullName();
+  auto sentPacketInterests = [&] {
+    vector<Interest> interests;
+    for (const auto& i : face->sentInterests) {
+      if (i.getName() == packetName) {
+        interests.push_back(i);
+      }
+    }
+    return interests;
+  };
+
+  bool failed = false;
+  manager.download_data_packet(packetName,
+                               [] (const Name&) {
+                                 BOOST_FAIL("Unexpected data");
+                               },
+                               [&failed] (const Name&, const std::string&) {
+                                 failed = true;
+                               });
+  advanceClocks(time::milliseconds(1), 10);
+
+  std::set<Name> nackedPrefixes;
+  for (size_t nNacks = 0; !failed; ++nNacks) {
+    // the Nacked Interest is sent again right away through a peer that did not Nack it yet
+    auto interests = sentPacketInterests();
+    BOOST_REQUIRE_EQUAL(interests.size(), nNacks + 1);
+    BOOST_REQUIRE(interests.back().hasLink());
+    auto prefix = interests.back().getLink().getDelegations().begin()->second;
+    BOOST_REQUIRE(nackedPrefixes.insert(prefix).second);
+
+    lp::Nack nack(interests.back());
+    nack.setReason(lp::NackReason::NO_ROUTE);
+    face->receive(nack);
+    advanceClocks(time::milliseconds(1), 10);
+  }
+  // once every peer Nacked it, the download fails without waiting for a timeout
+  BOOST_CHECK_EQUAL(nackedPrefixes.count("/memphis"), 1);
+  BOOST_CHECK_EQUAL(sentPacketInterests().size(), nackedPrefixes.size());
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckNackFreesWindowSlot, TorrentFixture)
+{
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  // fill the window, and queue one more Interest
+  vector<Name> packetNames;
+  for (size_t i = 0; i <= manager.windowSize(); ++i) {
+    packetNames.push_back(Name("/foo/bar").appendSequenceNumber(i).append("digest"));
+  }
+  std::set<Name> failedNames;
+  for (const auto& packetName : packetNames) {
+    manager.download_data_packet(packetName,
+                                 [] (const Name&) {
+                                   BOOST_FAIL("Unexpected data");
+                                 },
+                                 [&failedNames] (const Name& name, const std::string&) {
+                                   failedNames.insert(name);
+                                 });
+  }
+  advanceClocks(time::milliseconds(1), 10);
+  auto countSent = [this] (const Name& name) {
+    return std::count_if(face->sentInterests.begin(), face->sentInterests.end(),
+                         [&name] (const Interest& i) { return i.getName() == name; });
+  };
+  BOOST_CHECK_EQUAL(countSent(packetNames.front()), 1);
+  BOOST_CHECK_EQUAL(countSent(packetNames.back()), 0);
+
+  // the first Interest is Nacked through every prefix, then given up, and the queued Interest
+  // takes its slot
+  for (size_t nNacks = 0; failedNames.empty(); ++nNacks) {
+    BOOST_REQUIRE_LT(nNacks, face->sentInterests.size());
+    auto interest = std::find_if(face->sentInterests.rbegin(), face->sentInterests.rend(),
+                                 [&packetNames] (const Interest& i) {
+                                   return i.getName() == packetNames.front();
+                                 });
+    BOOST_REQUIRE(face->sentInterests.rend() != interest);
+    lp::Nack nack(*interest);
+    nack.setReason(lp::NackReason::NO_ROUTE);
+    face->receive(nack);
+    advanceClocks(time::milliseconds(1), 10);
+  }
+  BOOST_CHECK_EQUAL(failedNames.size(), 1);
+  BOOST_CHECK_EQUAL(failedNames.count(packetNames.front()), 1);
+  BOOST_CHECK_EQUAL(countSent(packetNames.back()), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckCongestionBackoff, TorrentFixture)
+{
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  Name packetName = Name("/foo/bar").appendSequenceNumber(0).append("digest");
+  auto sentPacketInterests = [&] {
+    vector<Interest> interests;
+    for (const auto& i : face->sentInterests) {
+      if (i.getName() == packetName) {
+        interests.push_back(i);
+      }
+    }
+    return interests;
+  };
+
+  bool failed = false;
+  manager.download_data_packet(packetName,
+                               [] (const Name&) {
+                                 BOOST_FAIL("Unexpected data");
+                               },
+                               [&failed] (const Name&, const std::string&) {
+                                 failed = true;
+                               });
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_REQUIRE_EQUAL(sentPacketInterests().size(), 1);
+
+  // each congestion Nack doubles the delay before the Interest is sent again
+  auto backoff = manager.initialCongestionBackoff();
+  for (size_t i = 0; i < manager.maxCongestionRetries(); ++i) {
+    lp::Nack nack(sentPacketInterests().back());
+    nack.setReason(lp::NackReason::CONGESTION);
+    face->receive(nack);
+    advanceClocks(time::milliseconds(1), backoff.count() - 1);
+    BOOST_CHECK_EQUAL(sentPacketInterests().size(), i + 1);
+    advanceClocks(time::milliseconds(1), 10);
+    BOOST_REQUIRE_EQUAL(sentPacketInterests().size(), i + 2);
+    BOOST_CHECK(!failed);
+    backoff *= 2;
+  }
+
+  // then the Interest is given up
+  lp::Nack nack(sentPacketInterests().back());
+  nack.setReason(lp::NackReason::CONGESTION);
+  face->receive(nack);
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK(failed);
+  advanceClocks(time::milliseconds(10), 2 * backoff.count() / 10);
+  BOOST_CHECK_EQUAL(sentPacketInterests().size(), manager.maxCongestionRetries() + 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckDataPacketRequestsMerged, TorrentFixture)
+{
+  writeTorrent();
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  const auto& packet = fileData.front().at(1);
+  const Name packetName = packet.getFullName();
+  auto countSent = [&] {
+    return std::count_if(face->sentInterests.begin(), face->sentInterests.end(),
+                         [&packetName] (const Interest& i) { return i.getName() == packetName; });
+  };
+
+  // the concurrent requests of a packet share a single Interest
+  size_t nReceived = 0;
+  size_t nFailed = 0;
+  std::function<void()> request = [&] {
+    manager.download_data_packet(packetName,
+                                 [&nReceived, &packetName] (const Name& name) {
+                                   BOOST_CHECK_EQUAL(name, packetName.getPrefix(-1));
+                                   ++nReceived;
+                                 },
+                                 [&nFailed, &request] (const Name&, const std::string&) {
+                                   ++nFailed;
+                                   // requested again, as the sequential data fetcher does
+                                   request();
+                                 });
+  };
+  request();
+  request();
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(countSent(), 1);
+
+  // all of them fail with the Interest, and their new requests share a new Interest
+  advanceClocks(time::milliseconds(10), 210);
+  BOOST_CHECK_EQUAL(nFailed, 2);
+  BOOST_CHECK_EQUAL(countSent(), 2);
+
+  // and all of them receive the packet
+  face->receive(packet);
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(nReceived, 2);
+  BOOST_CHECK_EQUAL(nFailed, 2);
+  BOOST_CHECK_EQUAL(countSent(), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(CheckQueuedInterestsFollowGoodput, TorrentFixture)
+{
+  TestTorrentManager manager(initialSegmentName, filePath, face);
+  initialize(manager);
+
+  // queue several windows of Interests at once, as the sequential data fetcher does
+  const Name packetPrefix("/foo/bar");
+  size_t nPackets = 4 * manager.windowSize();
+  size_t nReceived = 0;
+  for (size_t i = 0; i < nPackets; ++i) {
+    manager.download_data_packet(Name(packetPrefix).appendSequenceNumber(i).append("digest"),
+                                 [&nReceived] (const Name&) {
+                                   ++nReceived;
+                                 },
+                                 [] (const Name&, const std::string&) {
+                                   BOOST_FAIL("Unexpected failure");
+                                 });
+  }
+
+  // "/ucla" answers after 10 milliseconds, "/arizona" after 500
+  std::map<Name, size_t> nSent;
+  std::multimap<size_t, Name> answers;
+  size_t nSeen = 0;
+  for (size_t step = 0; nReceived < nPackets; ++step) {
+    BOOST_REQUIRE_LT(step, 1000);
+    for (; nSeen < face->sentInterests.size(); ++nSeen) {
+      const auto& interest = face->sentInterests[nSeen];
+      if (!packetPrefix.isPrefixOf(interest.getName())) {
+        continue;
+      }
+      BOOST_REQUIRE(interest.hasLink());
+      auto prefix = interest.getLink().getDelegations().begin()->second;
+      ++nSent[prefix];
+      answers.emplace(step + (Name("/ucla") == prefix ? 1 : 50), interest.getName());
+    }
+    auto due = answers.equal_range(step);
+    vector<Name> dueNames;
+    for (auto it = due.first; it != due.second; ++it) {
+      dueNames.push_back(it->second);
+    }
+    answers.erase(due.first, due.second);
+    for (const auto& name : dueNames) {
+      auto data = make_shared<Data>(name);
+      Signer::getDefault().sign(*data);
+      face->receive(*data);
+    }
+    advanceClocks(time::milliseconds(10));
+  }
+
+  // each Interest is sent once, and the faster prefix is sent more of the queue
+  BOOST_CHECK_EQUAL(nSent["/ucla"] + nSent["/arizona"], nPackets);
+  BOOST_CHECK_GT(nSent["/arizona"], 0);
+  BOOST_CHECK_GT(nSent["/ucla"], 2 * nSent["/arizona"]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE(CheckTorrentManagerUtilities, FaceFixture)
@@ -1258,7 +2092,10 @@ BOOST_AUTO_TEST_CASE(CheckWriteTorrentComplete)
                                         false);
       torrentSegments = temp.first;
     }
-    // Initialize manager
+    // Initialize manager, for a torrent kept in the legacy directories
+    std::string dirPath = ".appdata/foo/";
+    std::string torrentPath = dirPath + "torrent_files/";
+    fs::create_directories(torrentPath);
     TestTorrentManager manager(initialSegmentName,
                                filePath,
                                face);
@@ -1268,8 +2105,6 @@ BOOST_AUTO_TEST_CASE(CheckWriteTorrentComplete)
     advanceClocks(time::milliseconds(1), 10);
     manager.sendRoutablePrefixResponse();
 
-    std::string dirPath = ".appdata/foo/";
-    std::string torrentPath = dirPath + "torrent_files/";
     BOOST_CHECK(manager.torrentSegments().empty());
     for (const auto& t : torrentSegments) {
       BOOST_CHECK(manager.writeTorrentSegment(t, torrentPath));
@@ -1350,6 +2185,8 @@ BOOST_AUTO_TEST_CASE(CheckWriteManifestComplete)
         manifests.insert(manifests.end(), ms.first.begin(), ms.first.end());
       }
     }
+    // a torrent kept in the legacy directories
+    fs::create_directories(torrentPath);
     TestTorrentManager manager(initialSegmentName,
                               filePath,
                               face);
@@ -1402,6 +2239,123 @@ BOOST_AUTO_TEST_CASE(CheckWriteManifestComplete)
   }
 }
 
+BOOST_AUTO_TEST_CASE(CheckWriteManifestConflict)
+{
+  std::string manifestPath = ".appdata/foo/manifests/";
+  Name initialSegmentName = "/ndn/multicast/NTORRENT/foo/torrent-file/sha256digest=9e0410fa477309b40a4ef9cb2bebe70ed2e9fa2defcb584979d768b3f6ced981";
+  // two manifests with the same name, for different packet sizes
+  auto manifests1 = FileManifest::generate("tests/testdata/foo/bar1.txt",
+                                           "/ndn/multicast/NTORRENT/foo/", 1024, 1024);
+  auto manifests2 = FileManifest::generate("tests/testdata/foo/bar1.txt",
+                                           "/ndn/multicast/NTORRENT/foo/", 1024, 512);
+  const auto& m1 = manifests1.front();
+  const auto& m2 = manifests2.front();
+  BOOST_REQUIRE_EQUAL(m1.getName(), m2.getName());
+  BOOST_REQUIRE_NE(m1.getFullName(), m2.getFullName());
+
+  // a torrent kept in the legacy directories
+  fs::create_directories(".appdata/foo/torrent_files/");
+  TestTorrentManager manager(initialSegmentName, "tests/testdata/temp", face);
+  manager.Initialize();
+
+  BOOST_CHECK(manager.writeFileManifest(m1, manifestPath));
+  // the manifest we have is neither replaced nor overwritten on disk
+  BOOST_CHECK(!manager.writeFileManifest(m2, manifestPath));
+  BOOST_REQUIRE_EQUAL(manager.fileManifests().size(), 1);
+  BOOST_CHECK(manager.fileManifests().front() == m1);
+  auto stored = io::load<FileManifest>(manifestPath + m1.file_name() + "/0");
+  BOOST_REQUIRE(nullptr != stored);
+  BOOST_CHECK_EQUAL(stored->getFullName(), m1.getFullName());
+
+  fs::remove_all(".appdata");
+}
+
+BOOST_AUTO_TEST_CASE(CheckWriteToNewStore)
+{
+  std::string dirPath = ".appdata/foo/";
+  std::string storePath = MetadataStore::pathFor(dirPath);
+  Name initialSegmentName = "/ndn/multicast/NTORRENT/foo/torrent-file/sha256digest=9e0410fa477309b40a4ef9cb2bebe70ed2e9fa2defcb584979d768b3f6ced981";
+  auto temp = TorrentFile::generate("tests/testdata/foo", 1024, 1024, 1024, false);
+  const auto& torrentSegments = temp.first;
+  vector<FileManifest> manifests;
+  for (const auto& ms : temp.second) {
+    manifests.insert(manifests.end(), ms.first.begin(), ms.first.end());
+  }
+  BOOST_REQUIRE_GE(manifests.size(), 2);
+
+  // a torrent without metadata on disk gets a binary store, and no legacy directories
+  TestTorrentManager manager(initialSegmentName, "tests/testdata/temp", face);
+  manager.Initialize();
+  BOOST_CHECK(MetadataStore::exists(storePath));
+  for (const auto& t : torrentSegments) {
+    BOOST_CHECK(manager.writeTorrentSegment(t, dirPath + "torrent_files/"));
+  }
+  BOOST_CHECK(manager.writeFileManifest(manifests[0], dirPath + "manifests/"));
+  BOOST_CHECK(!fs::exists(dirPath + "torrent_files"));
+  BOOST_CHECK(!fs::exists(dirPath + "manifests"));
+
+  // a manifest that cannot be stored is not kept, and can be written once the store is back
+  auto backupPath = storePath + ".bak";
+  fs::copy_file(storePath, backupPath);
+  fs::remove(storePath);
+  fs::create_directory(storePath);
+  BOOST_CHECK(!manager.writeFileManifest(manifests[1], dirPath + "manifests/"));
+  BOOST_CHECK_EQUAL(manager.fileManifests().size(), 1);
+  fs::remove(storePath);
+  fs::rename(backupPath, storePath);
+  BOOST_CHECK(manager.writeFileManifest(manifests[1], dirPath + "manifests/"));
+  BOOST_CHECK_EQUAL(manager.fileManifests().size(), 2);
+
+  // a new manager reads the metadata back from the store
+  TestTorrentManager manager2(initialSegmentName, "tests/testdata/temp", face);
+  manager2.Initialize();
+  BOOST_CHECK(manager2.torrentSegments() == torrentSegments);
+  BOOST_CHECK_EQUAL(manager2.fileManifests().size(), 2);
+
+  fs::remove_all(".appdata");
+}
+
+BOOST_AUTO_TEST_CASE(CheckWriteDataVerifiesImplicitDigest)
+{
+  std::string filePath = "tests/testdata/temp/";
+  fs::remove_all(filePath);
+  auto content = FileManifest::generate("tests/testdata/foo/bar.txt",
+                                        "/ndn/multicast/NTORRENT/foo/", 10, 4, true);
+  const auto& manifest = content.first[0];
+  const auto& packets = content.second;
+  BOOST_REQUIRE(packets.size() > 1);
+
+  TestTorrentManager manager("/ndn/multicast/NTORRENT/foo/torrent-file/sha256digest",
+                             filePath, face);
+  BOOST_CHECK_EQUAL(TorrentManager::VERIFY_IMPLICIT_DIGEST, manager.getVerificationMode());
+  manager.pushFileManifestSegment(manifest);
+
+  // a packet whose name matches the catalog but whose content does not
+  Data forged(packets[0].getName());
+  forged.setContent(packets[1].getContent());
+  Signer::signWithSha256(forged);
+  BOOST_CHECK(!manager.writeData(forged));
+
+  // a packet whose wire differs only in its last byte
+  const Block& wire = packets[0].wireEncode();
+  auto tamperedWire = make_shared<Buffer>(wire.wire(), wire.size());
+  tamperedWire->back() ^= 0x01;
+  Data tampered{Block(tamperedWire)};
+  BOOST_REQUIRE_EQUAL(tampered.getName(), packets[0].getName());
+  BOOST_CHECK(!manager.writeData(tampered));
+
+  BOOST_CHECK(manager.writeData(packets[0]));
+  BOOST_CHECK(manager.fileState(manifest.getFullName())[0]);
+
+  // names are enough when only names are checked
+  Data forged1(packets[1].getName());
+  forged1.setContent(packets[0].getContent());
+  Signer::signWithSha256(forged1);
+  manager.setVerificationMode(TorrentManager::VERIFY_NAME);
+  BOOST_CHECK(manager.writeData(forged1));
+  fs::remove_all(filePath);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace tests
@@ -23,11 +23,16 @@
 #include "update-handler.hpp"
 #include "unit-test-time-fixture.hpp"
 #include "dummy-parser-fixture.hpp"
+#include "util/signer.hpp"
 
 #include <ndn-cxx/name.hpp>
 #include <ndn-cxx/util/dummy-client-face.hpp>
 #include <ndn-cxx/util/io.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <set>
+
 namespace ndn {
 namespace ntorrent {
 namespace tests {
@@ -37,9 +42,8 @@ using std::vector;
 
 class TestUpdateHandler : public UpdateHandler {
 public:
-  TestUpdateHandler(Name torrentName, shared_ptr<KeyChain> keyChain,
-                    shared_ptr<StatsTable> statsTable, shared_ptr<Face> face)
-  : UpdateHandler(torrentName, keyChain, statsTable, face)
+  TestUpdateHandler(Name torrentName, shared_ptr<StatsTable> statsTable, shared_ptr<Face> face)
+  : UpdateHandler(torrentName, statsTable, face)
   {
   }
 
@@ -75,25 +79,23 @@ BOOST_AUTO_TEST_CASE(TestInitialSetup)
 {
   shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
 
-  shared_ptr<KeyChain> keyChain = make_shared<KeyChain>();
-
-  TestUpdateHandler handler1(Name("linux15.01"), keyChain, table1, face1);
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
   advanceClocks(time::milliseconds(1), 10);
   // Create a data packet containing one name as content
   shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
                                                       { Name("ucla") });
-  keyChain->sign(*d);
+  Signer::getDefault().sign(*d);
   face1->receive(*d);
 
   BOOST_CHECK_EQUAL(handler1.getOwnRoutablePrefix().toUri(), "/ucla");
 
   shared_ptr<StatsTable> table2 = make_shared<StatsTable>(Name("linux15.01"));
-  TestUpdateHandler handler2(Name("linux15.01"), keyChain, table2, face2);
+  TestUpdateHandler handler2(Name("linux15.01"), table2, face2);
   advanceClocks(time::milliseconds(1), 10);
   // Create a data packet containing one name as content
   d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
                                      { Name("arizona") });
-  keyChain->sign(*d);
+  Signer::getDefault().sign(*d);
   face2->receive(*d);
 
   BOOST_CHECK_EQUAL(handler2.getOwnRoutablePrefix().toUri(), "/arizona");
@@ -106,24 +108,22 @@ BOOST_AUTO_TEST_CASE(TestAliveInterestExchange)
   table1->insert(Name("isp2"));
   table1->insert(Name("isp3"));
 
-  shared_ptr<KeyChain> keyChain = make_shared<KeyChain>();
-
-  TestUpdateHandler handler1(Name("linux15.01"), keyChain, table1, face1);
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
   advanceClocks(time::milliseconds(1), 10);
   // Create a data packet containing one name as content
   shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
                                                       { Name("ucla") });
-  keyChain->sign(*d);
+  Signer::getDefault().sign(*d);
   face1->receive(*d);
 
   shared_ptr<StatsTable> table2 = make_shared<StatsTable>(Name("linux15.01"));
   table2->insert(Name("ucla"));
-  TestUpdateHandler handler2(Name("linux15.01"), keyChain, table2, face2);
+  TestUpdateHandler handler2(Name("linux15.01"), table2, face2);
   advanceClocks(time::milliseconds(1), 10);
   // Create a data packet containing one name as content
   d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
                                      { Name("arizona") });
-  keyChain->sign(*d);
+  Signer::getDefault().sign(*d);
   face2->receive(*d);
 
   handler2.sendAliveInterest(table2->begin());
@@ -138,23 +138,20 @@ BOOST_AUTO_TEST_CASE(TestAliveInterestExchange)
   BOOST_CHECK_EQUAL(dataVec.size(), 1);
   BOOST_CHECK_EQUAL(dataVec[0].getName().toUri(), "/NTORRENT/linux15.01/ALIVE/test");
 
-  auto block = dataVec[0].getContent();
-  shared_ptr<vector<Name>> nameVec = DummyParser::decodeContent(block);
-  auto it = nameVec->begin();
-
-  BOOST_CHECK_EQUAL(it->toUri(), "/test");
-  ++it;
-  BOOST_CHECK_EQUAL(it->toUri(), "/isp3");
-  ++it;
-  BOOST_CHECK_EQUAL(it->toUri(), "/isp2");
-  ++it;
-  BOOST_CHECK_EQUAL(it->toUri(), "/isp1");
+  // the sender is not told about itself
+  auto peers = UpdateHandler::decodePeerEntries(dataVec[0].getContent());
+  std::set<Name> names;
+  for (const auto& peer : peers) {
+    names.insert(peer.prefix);
+  }
+  BOOST_CHECK_EQUAL(peers.size(), 3);
+  BOOST_CHECK(names == std::set<Name>({ Name("isp1"), Name("isp2"), Name("isp3") }));
 
-  BOOST_CHECK_EQUAL((table1->end() - 1)->getRecordName().toUri(), "/test");
+  BOOST_CHECK_EQUAL(std::prev(table1->end())->getRecordName().toUri(), "/test");
 
   d = DummyParser::createDataPacket(Name("/NTORRENT/linux15.01/ALIVE/arizona"),
                                      { Name("isp1"), Name("isp2"), Name("isp3") });
-  keyChain->sign(*d);
+  Signer::getDefault().sign(*d);
 
   advanceClocks(time::milliseconds(1), 40);
   face2->receive(*d);
@@ -192,56 +189,37 @@ BOOST_AUTO_TEST_CASE(TestAliveInterestExchange)
   advanceClocks(time::milliseconds(1), 30);
   face2->receive(*iter);
 
+  // the response is a sample of five of the prefixes of table1, the sender left out
+  peers = UpdateHandler::decodePeerEntries(iter->getContent());
+  BOOST_CHECK_EQUAL(peers.size(), static_cast<size_t>(UpdateHandler::MAX_NUM_OF_ENCODED_NAMES));
+
   i = table2->begin();
   BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/ucla");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
   ++i;
-
   BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp1");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
   ++i;
-
   BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp2");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
   ++i;
-
   BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp3");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
   ++i;
 
-  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/test");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
-  ++i;
-
-  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp4");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
-  ++i;
-
-  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp5");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
-  ++i;
-
-  BOOST_CHECK_EQUAL(i->getRecordName().toUri(), "/isp6");
-  BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
-  BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
-  ++i;
+  size_t nNewNames = 0;
+  for (const auto& peer : peers) {
+    BOOST_CHECK(peer.prefix != Name("arizona"));
+    BOOST_CHECK(table1->find(peer.prefix) != table1->end());
+    BOOST_CHECK(table2->find(peer.prefix) != table2->end());
+    if (peer.prefix != Name("isp3")) {
+      ++nNewNames;
+    }
+  }
+  BOOST_CHECK_EQUAL(table2->size(), 4 + nNewNames);
 
-  BOOST_CHECK(i == table2->end());
+  for (; i != table2->end(); ++i) {
+    BOOST_CHECK(table1->find(i->getRecordName()) != table1->end());
+    BOOST_CHECK_EQUAL(i->getRecordSuccessRate(), 0);
+    BOOST_CHECK_EQUAL(i->getRecordSentInterests(), 0);
+    BOOST_CHECK_EQUAL(i->getRecordReceivedData(), 0);
+  }
 }
 
 BOOST_AUTO_TEST_CASE(TestNeedsUpdate)
@@ -251,16 +229,14 @@ BOOST_AUTO_TEST_CASE(TestNeedsUpdate)
   table1->insert(Name("isp2"));
   table1->insert(Name("isp3"));
 
-  shared_ptr<KeyChain> keyChain = make_shared<KeyChain>();
-
-  UpdateHandler handler1(Name("linux15.01"), keyChain, table1, face1);
+  UpdateHandler handler1(Name("linux15.01"), table1, face1);
 
   BOOST_CHECK(handler1.needsUpdate());
 
-  auto i = table1->begin() + 1;
+  auto i = std::next(table1->begin());
   i->incrementSentInterests();
   i->incrementSentInterests();
-  i->incrementReceivedData();
+  i->incrementReceivedData(8000, time::milliseconds(100));
 
   BOOST_CHECK(handler1.needsUpdate());
 
@@ -268,6 +244,366 @@ BOOST_AUTO_TEST_CASE(TestNeedsUpdate)
   table1->insert(Name("isp5"));
 
   BOOST_CHECK(!handler1.needsUpdate());
+
+  // the prefix stops counting once it no longer delivers data
+  advanceClocks(time::seconds(1), 10);
+  BOOST_CHECK(handler1.needsUpdate());
+
+  // and a prefix that fails most of its recent Interests does not count
+  auto j = table1->find(Name("isp4"));
+  j->incrementSentInterests();
+  j->incrementReceivedData(8000, time::milliseconds(100));
+  BOOST_CHECK(!handler1.needsUpdate());
+  for (int k = 0; k < 2; ++k) {
+    j->incrementSentInterests();
+    j->incrementTimeouts();
+  }
+  BOOST_CHECK(handler1.needsUpdate());
+}
+
+static Block
+makePeerEntry(const Name& prefix, uint64_t ageMs, uint64_t successRatePerMille)
+{
+  Block entry(UpdateHandler::PEER_ENTRY_TYPE);
+  entry.push_back(prefix.wireEncode());
+  entry.push_back(makeNonNegativeIntegerBlock(UpdateHandler::PEER_AGE_TYPE, ageMs));
+  entry.push_back(makeNonNegativeIntegerBlock(UpdateHandler::PEER_SUCCESS_RATE_TYPE,
+                                              successRatePerMille));
+  entry.encode();
+  return entry;
+}
+
+static shared_ptr<Data>
+makeAliveData(const Name& name, const vector<Block>& entries)
+{
+  Block content(tlv::Content);
+  for (const auto& entry : entries) {
+    content.push_back(entry);
+  }
+  content.encode();
+
+  shared_ptr<Data> data = make_shared<Data>(name);
+  data->setContentType(tlv::ContentType_Blob);
+  data->setContent(content);
+  return data;
+}
+
+static size_t
+countInterests(const vector<Interest>& interests, const Name& prefix)
+{
+  return std::count_if(interests.begin(), interests.end(),
+                       [&prefix] (const Interest& i) { return prefix.isPrefixOf(i.getName()); });
+}
+
+BOOST_AUTO_TEST_CASE(TestLearnOwnRoutablePrefixRetries)
+{
+  shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
+  table1->insert(Name("isp1"));
+
+  Name learnPrefix("/localhop/nfd/rib/routable-prefixes");
+  Name alivePrefix("/NTORRENT/linux15.01/ALIVE");
+
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(handler1.getState(), UpdateHandler::LEARNING_OWN_PREFIX);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, learnPrefix), 1);
+
+  // nothing is sent until the own routable prefix is known
+  handler1.sendAliveInterest(table1->begin());
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, alivePrefix), 0);
+
+  // the request times out after 100ms and is retried 100ms later
+  advanceClocks(time::milliseconds(1), 150);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, learnPrefix), 1);
+  advanceClocks(time::milliseconds(1), 50);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, learnPrefix), 2);
+
+  // the next retry waits twice as long
+  advanceClocks(time::milliseconds(1), 250);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, learnPrefix), 2);
+  advanceClocks(time::milliseconds(1), 50);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, learnPrefix), 3);
+
+  shared_ptr<Data> d = DummyParser::createDataPacket(learnPrefix, { Name("ucla") });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+
+  BOOST_CHECK_EQUAL(handler1.getState(), UpdateHandler::IDLE);
+  BOOST_CHECK_EQUAL(handler1.getOwnRoutablePrefix().toUri(), "/ucla");
+
+  advanceClocks(time::milliseconds(100), 10);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, learnPrefix), 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestAliveInterestRetries)
+{
+  shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
+  table1->insert(Name("isp1"));
+  table1->insert(Name("isp2"));
+  table1->insert(Name("isp3"));
+
+  Name alivePrefix("/NTORRENT/linux15.01/ALIVE");
+
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
+  advanceClocks(time::milliseconds(1), 10);
+  shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
+                                                      { Name("ucla") });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+
+  handler1.sendAliveInterest(table1->begin());
+  BOOST_CHECK_EQUAL(handler1.getState(), UpdateHandler::EXCHANGING);
+  // a second ALIVE Interest is not sent while the first one is outstanding
+  handler1.sendAliveInterest(table1->begin());
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, alivePrefix), 1);
+
+  // a Nack moves on to the next prefix right away
+  lp::Nack nack(face1->sentInterests.back());
+  nack.setReason(lp::NackReason::NO_ROUTE);
+  face1->receive(nack);
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, alivePrefix), 2);
+
+  // then each timeout does, until every prefix has been tried once
+  advanceClocks(time::milliseconds(100), 200);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, alivePrefix), 3);
+  BOOST_CHECK_EQUAL(handler1.getState(), UpdateHandler::IDLE);
+
+  vector<Name> delegations;
+  for (const auto& interest : face1->sentInterests) {
+    if (alivePrefix.isPrefixOf(interest.getName())) {
+      delegations.push_back(interest.getLink().getDelegations().begin()->second);
+    }
+  }
+  vector<Name> expected = { Name("isp1"), Name("isp2"), Name("isp3") };
+  BOOST_CHECK_EQUAL_COLLECTIONS(delegations.begin(), delegations.end(),
+                                expected.begin(), expected.end());
+
+  // the handler can start a new exchange
+  handler1.sendAliveInterest(table1->begin());
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, alivePrefix), 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestMalformedAliveData)
+{
+  shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
+  table1->insert(Name("isp1"));
+  table1->insert(Name("isp2"));
+
+  Name alivePrefix("/NTORRENT/linux15.01/ALIVE");
+
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
+  advanceClocks(time::milliseconds(1), 10);
+  shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
+                                                      { Name("ucla") });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+
+  handler1.sendAliveInterest(table1->begin());
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, alivePrefix), 1);
+
+  // a response that cannot be decoded does not escape the callback of the face
+  Block malformed(UpdateHandler::PEER_ENTRY_TYPE);
+  malformed.push_back(Name("isp3").wireEncode());
+  malformed.encode();
+  d = makeAliveData(Name("/NTORRENT/linux15.01/ALIVE/ucla"), { malformed });
+  Signer::getDefault().sign(*d);
+  BOOST_CHECK_NO_THROW(face1->receive(*d));
+  BOOST_CHECK_NO_THROW(advanceClocks(time::milliseconds(1), 10));
+  BOOST_CHECK(table1->find(Name("isp3")) == table1->end());
+
+  // the exchange is retried through the next prefix after a while
+  BOOST_CHECK_EQUAL(handler1.getState(), UpdateHandler::EXCHANGING);
+  BOOST_CHECK_EQUAL(countInterests(face1->sentInterests, alivePrefix), 1);
+  advanceClocks(time::milliseconds(1), UpdateHandler::ALIVE_RETRY_DELAY.count());
+  BOOST_REQUIRE_EQUAL(countInterests(face1->sentInterests, alivePrefix), 2);
+  BOOST_CHECK_EQUAL(face1->sentInterests.back().getLink().getDelegations().begin()->second,
+                    Name("isp2"));
+
+  d = makeAliveData(Name("/NTORRENT/linux15.01/ALIVE/ucla"),
+                    { makePeerEntry(Name("isp3"), 0, 900) });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+  BOOST_CHECK_EQUAL(handler1.getState(), UpdateHandler::IDLE);
+  BOOST_CHECK(table1->find(Name("isp3")) != table1->end());
+}
+
+BOOST_AUTO_TEST_CASE(TestPeerEntries)
+{
+  shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
+  table1->insert(Name("isp1"));
+  table1->insert(Name("isp2"));
+
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
+  advanceClocks(time::milliseconds(1), 10);
+  shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
+                                                      { Name("ucla") });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+
+  auto isp1 = table1->find(Name("isp1"));
+  isp1->incrementSentInterests();
+  isp1->incrementReceivedData();
+  advanceClocks(time::seconds(1), 10);
+
+  face1->receive(Interest(Name("/NTORRENT/linux15.01/ALIVE/peer")));
+  advanceClocks(time::milliseconds(1), 10);
+
+  BOOST_REQUIRE_EQUAL(face1->sentData.size(), 1);
+  const Data& response = face1->sentData.back();
+  BOOST_CHECK_EQUAL(response.getFreshnessPeriod(), time::seconds(1));
+
+  // the highest scored prefix comes first, and the sender is left out
+  auto peers = UpdateHandler::decodePeerEntries(response.getContent());
+  BOOST_REQUIRE_EQUAL(peers.size(), 2);
+  BOOST_CHECK_EQUAL(peers[0].prefix, Name("isp1"));
+  BOOST_CHECK_EQUAL(peers[0].successRate, 1);
+  BOOST_CHECK(peers[0].age >= time::seconds(10));
+  BOOST_CHECK_EQUAL(peers[1].prefix, Name("isp2"));
+  BOOST_CHECK_EQUAL(peers[1].successRate, 0);
+  BOOST_CHECK(peers[1].age >= time::seconds(10));
+
+  // the sender is added to the table
+  BOOST_CHECK(table1->find(Name("peer")) != table1->end());
+
+  // bare names are accepted as just seen prefixes
+  d = DummyParser::createDataPacket(Name("/NTORRENT/linux15.01/ALIVE/peer"), { Name("isp3") });
+  peers = UpdateHandler::decodePeerEntries(d->getContent());
+  BOOST_REQUIRE_EQUAL(peers.size(), 1);
+  BOOST_CHECK_EQUAL(peers[0].prefix, Name("isp3"));
+  BOOST_CHECK(peers[0].age == time::milliseconds::zero());
+
+  Block malformed(UpdateHandler::PEER_ENTRY_TYPE);
+  malformed.push_back(Name("isp4").wireEncode());
+  malformed.encode();
+  d = makeAliveData(Name("/NTORRENT/linux15.01/ALIVE/peer"), { malformed });
+  BOOST_CHECK_THROW(UpdateHandler::decodePeerEntries(d->getContent()), UpdateHandler::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestMergePeers)
+{
+  shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
+  table1->insert(Name("isp1"));
+
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
+  advanceClocks(time::milliseconds(1), 10);
+  shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
+                                                      { Name("ucla") });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+
+  handler1.sendAliveInterest(table1->begin());
+  advanceClocks(time::milliseconds(1), 10);
+
+  auto lifetime = time::duration_cast<time::milliseconds>(UpdateHandler::PEER_LIFETIME).count();
+  d = makeAliveData(Name("/NTORRENT/linux15.01/ALIVE/ucla"),
+                    { makePeerEntry(Name("isp2"), 1000, 900),
+                      makePeerEntry(Name("isp3"), lifetime + 1000, 900),
+                      makePeerEntry(Name("ucla"), 0, 1000) });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+
+  BOOST_CHECK_EQUAL(handler1.getState(), UpdateHandler::IDLE);
+  // the stale prefix and the own prefix are left out
+  BOOST_CHECK_EQUAL(table1->size(), 2);
+  BOOST_CHECK(table1->find(Name("isp3")) == table1->end());
+  BOOST_CHECK(table1->find(Name("ucla")) == table1->end());
+
+  auto isp2 = table1->find(Name("isp2"));
+  BOOST_REQUIRE(isp2 != table1->end());
+  BOOST_CHECK_CLOSE(isp2->getRecordAdvertisedSuccessRate(), 0.9, 0.0001);
+  BOOST_CHECK(isp2->getRecordLastSeen() <= time::steady_clock::now() - time::seconds(1));
+
+  // the prefixes not seen alive for PEER_LIFETIME are expired, unless an Interest is pending
+  table1->find(Name("isp1"))->incrementSentInterests();
+  advanceClocks(time::seconds(10), lifetime / 10000 + 1);
+  face1->receive(Interest(Name("/NTORRENT/linux15.01/ALIVE/peer")));
+  advanceClocks(time::milliseconds(1), 10);
+
+  BOOST_CHECK_EQUAL(table1->size(), 2);
+  BOOST_CHECK(table1->find(Name("isp1")) != table1->end());
+  BOOST_CHECK(table1->find(Name("isp2")) == table1->end());
+  BOOST_CHECK(table1->find(Name("peer")) != table1->end());
+}
+
+BOOST_AUTO_TEST_CASE(TestBoundedPeers)
+{
+  shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
+  for (size_t i = 0; i < UpdateHandler::MAX_NUM_OF_PEERS; ++i) {
+    table1->insert(Name("isp").appendNumber(i));
+  }
+
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
+  advanceClocks(time::milliseconds(1), 10);
+  shared_ptr<Data> d = DummyParser::createDataPacket(Name("/localhop/nfd/rib/routable-prefixes"),
+                                                      { Name("ucla") });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+
+  handler1.sendAliveInterest(table1->begin());
+  advanceClocks(time::milliseconds(1), 10);
+
+  // a prefix with a better success rate takes the place of the stalest low scored one
+  d = makeAliveData(Name("/NTORRENT/linux15.01/ALIVE/ucla"),
+                    { makePeerEntry(Name("good"), 0, 900), makePeerEntry(Name("bad"), 0, 0) });
+  Signer::getDefault().sign(*d);
+  face1->receive(*d);
+  advanceClocks(time::milliseconds(1), 10);
+
+  BOOST_CHECK_EQUAL(table1->size(), static_cast<size_t>(UpdateHandler::MAX_NUM_OF_PEERS));
+  BOOST_CHECK(table1->find(Name("good")) != table1->end());
+  BOOST_CHECK(table1->find(Name("bad")) == table1->end());
+  // the prefix the response came through was just seen alive
+  BOOST_CHECK(table1->find(Name("isp").appendNumber(0)) != table1->end());
+  BOOST_CHECK(table1->find(Name("isp").appendNumber(1)) == table1->end());
+}
+
+BOOST_AUTO_TEST_CASE(TestWeightedSample)
+{
+  shared_ptr<StatsTable> table1 = make_shared<StatsTable>(Name("linux15.01"));
+  for (int i = 0; i < 9; ++i) {
+    table1->insert(Name("isp").appendNumber(i));
+    auto record = table1->find(Name("isp").appendNumber(i));
+    record->incrementSentInterests();
+    record->incrementTimeouts();
+  }
+  table1->insert(Name("seeder"));
+  auto seeder = table1->find(Name("seeder"));
+  seeder->incrementSentInterests();
+  seeder->incrementReceivedData();
+
+  TestUpdateHandler handler1(Name("linux15.01"), table1, face1);
+  advanceClocks(time::milliseconds(1), 10);
+
+  // each response is a different sample, in which the seeder is nearly always included
+  std::set<Name> sampled;
+  size_t nSeederSampled = 0;
+  for (int i = 0; i < 100; ++i) {
+    face1->receive(Interest(Name("/NTORRENT/linux15.01/ALIVE/peer")));
+    advanceClocks(time::milliseconds(1), 2);
+    auto peers = UpdateHandler::decodePeerEntries(face1->sentData.back().getContent());
+    BOOST_REQUIRE_EQUAL(peers.size(), static_cast<size_t>(UpdateHandler::MAX_NUM_OF_ENCODED_NAMES));
+    for (const auto& peer : peers) {
+      sampled.insert(peer.prefix);
+    }
+    if (peers[0].prefix == Name("seeder")) {
+      ++nSeederSampled;
+    }
+  }
+  BOOST_CHECK_GE(nSeederSampled, 95);
+  BOOST_CHECK_EQUAL(sampled.size(), 10);
+  BOOST_CHECK(sampled.count(Name("peer")) == 0);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
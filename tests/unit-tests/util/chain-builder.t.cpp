@@ -0,0 +1,131 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "../boost-test.hpp"
+#include "file-manifest.hpp"
+#include "util/chain-builder.hpp"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestChainBuilder)
+
+BOOST_AUTO_TEST_CASE(CheckSameChainAsInMemory)
+{
+  auto manifests = FileManifest::generate("tests/testdata/foo/bar1.txt",
+                                          "/ndn/multicast/NTORRENT/foo/", 10, 100);
+  BOOST_REQUIRE(manifests.size() > 2);
+
+  std::string spillPath = "tests/testdata/temp-chain";
+  vector<FileManifest> built;
+  {
+    ChainBuilder<FileManifest> chain([] (FileManifest& m, const Name& next) {
+                                       m.set_submanifest_ptr(std::make_shared<Name>(next));
+                                     },
+                                     spillPath);
+    BOOST_CHECK(chain.build([] (const Data&) {}).empty());
+    for (const auto& m : manifests) {
+      chain.append(FileManifest(m.getName(), m.data_packet_size(), m.catalog_prefix(),
+                                m.catalog()));
+    }
+    BOOST_CHECK_EQUAL(manifests.size(), chain.size());
+    // all the segments but the last one are spilled
+    BOOST_CHECK(fs::exists(spillPath));
+    auto initialName = chain.build([&built] (const Data& d) {
+                                     built.push_back(FileManifest(d.wireEncode()));
+                                   });
+    BOOST_CHECK_EQUAL(manifests.front().getFullName(), initialName);
+    BOOST_CHECK_EQUAL(0, chain.size());
+    BOOST_CHECK(!fs::exists(spillPath));
+  }
+  // the segments are passed from the last one to the initial one
+  BOOST_REQUIRE_EQUAL(manifests.size(), built.size());
+  for (size_t i = 0; i < manifests.size(); ++i) {
+    const auto& m = built[manifests.size() - 1 - i];
+    BOOST_CHECK_EQUAL(manifests[i].getFullName(), m.getFullName());
+    BOOST_CHECK(manifests[i] == m);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CheckFileManifestGenerateStreaming)
+{
+  auto manifests = FileManifest::generate("tests/testdata/foo/bar2.txt",
+                                          "/ndn/multicast/NTORRENT/foo/", 20, 256);
+  vector<Name> names;
+  auto initialName = FileManifest::generateStreaming("tests/testdata/foo/bar2.txt",
+                                                     "/ndn/multicast/NTORRENT/foo/", 20, 256,
+                                                     [&names] (const Data& d) {
+                                                       names.push_back(d.getFullName());
+                                                     });
+  BOOST_CHECK_EQUAL(manifests.front().getFullName(), initialName);
+  BOOST_REQUIRE_EQUAL(manifests.size(), names.size());
+  for (size_t i = 0; i < manifests.size(); ++i) {
+    BOOST_CHECK_EQUAL(manifests[i].getFullName(), names[manifests.size() - 1 - i]);
+  }
+  BOOST_CHECK_THROW(FileManifest::generateStreaming("tests/testdata/foo/none.txt",
+                                                    "/ndn/multicast/NTORRENT/foo/", 20, 256,
+                                                    [] (const Data&) {}),
+                    FileManifest::Error);
+}
+
+BOOST_AUTO_TEST_CASE(CheckGenerateStreamingDefaultSizes)
+{
+  // a file of several manifests, each larger than MAX_NDN_PACKET_SIZE with the default sizes
+  std::string filePath = "tests/testdata/temp-large.bin";
+  {
+    fs::ofstream os(filePath, fs::ofstream::binary);
+    for (size_t i = 0; i < 5 * 1024 * 1024 / 2; ++i) {
+      os.put(static_cast<char>((i * 2654435761u) >> 24));
+    }
+  }
+  auto manifests = FileManifest::generate(filePath, "/ndn/multicast/NTORRENT/foo/", 1024, 1024);
+  BOOST_REQUIRE(manifests.size() > 2);
+  BOOST_REQUIRE(manifests.front().wireEncode().size() > MAX_NDN_PACKET_SIZE);
+
+  vector<Name> names;
+  auto initialName = FileManifest::generateStreaming(filePath,
+                                                     "/ndn/multicast/NTORRENT/foo/", 1024, 1024,
+                                                     [&names] (const Data& d) {
+                                                       names.push_back(d.getFullName());
+                                                     });
+  BOOST_CHECK_EQUAL(manifests.front().getFullName(), initialName);
+  BOOST_REQUIRE_EQUAL(manifests.size(), names.size());
+  for (size_t i = 0; i < manifests.size(); ++i) {
+    BOOST_CHECK_EQUAL(manifests[i].getFullName(), names[manifests.size() - 1 - i]);
+  }
+  fs::remove(filePath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace nTorrent
+} // namespace ndn
@@ -0,0 +1,88 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "../boost-test.hpp"
+#include "util/digest-pool.hpp"
+#include "util/signer.hpp"
+
+#include <string>
+#include <vector>
+
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+
+static Name
+makeName(size_t i)
+{
+  return Name("/ndn/multicast/NTORRENT/foo/bar.txt/%00").appendSequenceNumber(i);
+}
+
+static std::string
+makeContent(size_t i)
+{
+  return std::string(1 + i % 300, 'a' + i % 26);
+}
+
+BOOST_AUTO_TEST_SUITE(TestDigestPool)
+
+BOOST_AUTO_TEST_CASE(CheckSameAsSigner)
+{
+  for (size_t nThreads : {0, 1, 3}) {
+    DigestPool pool(nThreads);
+    BOOST_CHECK_EQUAL(nThreads, pool.getNumThreads());
+    // batches both smaller and larger than what is handed to the workers
+    for (size_t nPackets : {0, 1, 7, 100, 1001}) {
+      // the contents must outlive the jobs which point into them
+      vector<std::string> contents;
+      for (size_t i = 0; i < nPackets; ++i) {
+        contents.push_back(makeContent(i));
+      }
+      vector<DigestPool::Job> jobs;
+      vector<Data> expected;
+      for (size_t i = 0; i < nPackets; ++i) {
+        auto begin = reinterpret_cast<const uint8_t*>(contents[i].data());
+        jobs.push_back(DigestPool::Job{makeName(i), begin, begin + contents[i].size()});
+        Data d(makeName(i));
+        d.setContent(begin, contents[i].size());
+        Signer::signWithSha256(d);
+        expected.push_back(d);
+      }
+      auto packets = pool.encode(jobs);
+      BOOST_REQUIRE_EQUAL(nPackets, packets.size());
+      for (size_t i = 0; i < nPackets; ++i) {
+        BOOST_CHECK(expected[i].wireEncode() == packets[i].wire);
+        BOOST_CHECK_EQUAL(expected[i].getFullName(), packets[i].fullName);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace nTorrent
+} // namespace ndn
@@ -20,6 +20,7 @@
 */
 
 #include "../boost-test.hpp"
+#include "manifest-tree-node.hpp"
 #include "util/io-util.hpp"
 
 namespace ndn {
@@ -50,6 +51,29 @@ BOOST_AUTO_TEST_CASE(TestFindType)
   n3 = Name(n3.toUri() + "/sha256digest");
 
   BOOST_CHECK_EQUAL(IoUtil::findType(n3), 2);
+
+  Name n4("NTORRENT/linux/file0");
+  n4.append(ManifestTreeNode::NAME_MARKER);
+  n4.appendSequenceNumber(1);
+  n4.appendSequenceNumber(0);
+  n4 = Name(n4.toUri() + "/sha256digest");
+
+  BOOST_CHECK_EQUAL(IoUtil::findType(n4), IoUtil::MANIFEST_TREE_NODE);
+
+  // a file called "manifest-tree"
+  Name n5("NTORRENT/linux/manifest-tree");
+  n5.appendSequenceNumber(1);
+  n5.appendSequenceNumber(0);
+  n5 = Name(n5.toUri() + "/sha256digest");
+
+  BOOST_CHECK_EQUAL(IoUtil::findType(n5), IoUtil::DATA_PACKET);
+
+  // a file in a directory called "manifest-tree"
+  Name n6("NTORRENT/linux/manifest-tree/file0");
+  n6.appendSequenceNumber(1);
+  n6 = Name(n6.toUri() + "/sha256digest");
+
+  BOOST_CHECK_EQUAL(IoUtil::findType(n6), IoUtil::FILE_MANIFEST);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,288 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "../boost-test.hpp"
+#include "file-manifest.hpp"
+#include "torrent-file.hpp"
+#include "util/io-util.hpp"
+#include "util/metadata-store.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+
+namespace fs = boost::filesystem;
+
+static vector<Data>
+makeMetadata()
+{
+  auto content = TorrentFile::generate("tests/testdata/foo", 1, 10, 10);
+  vector<Data> packets(content.first.begin(), content.first.end());
+  for (const auto& ms : content.second) {
+    packets.insert(packets.end(), ms.first.begin(), ms.first.end());
+  }
+  return packets;
+}
+
+static void
+checkEntries(const MetadataStore& store, const vector<Data>& packets)
+{
+  BOOST_REQUIRE_EQUAL(packets.size(), store.entries().size());
+  for (size_t i = 0; i < packets.size(); ++i) {
+    const auto& entry = store.entries()[i];
+    BOOST_CHECK_EQUAL(packets[i].getFullName(), entry.fullName);
+    BOOST_CHECK_EQUAL(packets[i].getFullName(), Data(store.read(entry.offset)).getFullName());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(TestMetadataStore)
+
+BOOST_AUTO_TEST_CASE(CheckAppendAndReopen)
+{
+  std::string dirPath = "tests/testdata/temp";
+  std::string storePath = MetadataStore::pathFor(dirPath);
+  fs::remove_all(dirPath);
+  auto packets = makeMetadata();
+  BOOST_REQUIRE(packets.size() > 2);
+
+  BOOST_CHECK(!MetadataStore::exists(storePath));
+  {
+    MetadataStore store(storePath);
+    BOOST_CHECK(MetadataStore::exists(storePath));
+    BOOST_CHECK(store.entries().empty());
+    for (size_t i = 0; i + 1 < packets.size(); ++i) {
+      store.append(packets[i]);
+    }
+    store.flush();
+    // appending after the footer overwrites it
+    store.append(packets.back());
+    checkEntries(store, packets);
+  }
+  // the index is written back when the store is closed
+  {
+    MetadataStore store(storePath);
+    checkEntries(store, packets);
+  }
+  // the manifests can be decoded straight from the store
+  {
+    MetadataStore store(storePath);
+    const auto& entry = store.entries().back();
+    BOOST_CHECK(IoUtil::FILE_MANIFEST == IoUtil::findType(entry.fullName));
+    FileManifest m(MetadataStore::readBlock(storePath, entry.offset));
+    BOOST_CHECK_EQUAL(packets.back().getFullName(), m.getFullName());
+  }
+  fs::remove_all(dirPath);
+}
+
+BOOST_AUTO_TEST_CASE(CheckRecoverWithoutFooter)
+{
+  std::string dirPath = "tests/testdata/temp";
+  std::string storePath = MetadataStore::pathFor(dirPath);
+  fs::remove_all(dirPath);
+  auto packets = makeMetadata();
+
+  uint64_t lastOffset = 0;
+  {
+    MetadataStore store(storePath);
+    for (const auto& p : packets) {
+      lastOffset = store.append(p);
+    }
+  }
+  uint64_t recordsEnd = lastOffset + packets.back().wireEncode().size();
+  // simulate a crash before the footer is written
+  fs::resize_file(storePath, recordsEnd);
+  {
+    MetadataStore store(storePath);
+    checkEntries(store, packets);
+  }
+  {
+    MetadataStore store(storePath);
+    checkEntries(store, packets);
+  }
+  // simulate a crash in the middle of appending the last record
+  fs::resize_file(storePath, lastOffset + 3);
+  {
+    // the partial record is dropped
+    MetadataStore store(storePath);
+    checkEntries(store, vector<Data>(packets.begin(), packets.end() - 1));
+    BOOST_CHECK_EQUAL(lastOffset, fs::file_size(storePath));
+    // and can be appended again
+    store.append(packets.back());
+  }
+  {
+    MetadataStore store(storePath);
+    checkEntries(store, packets);
+  }
+  fs::remove_all(dirPath);
+}
+
+BOOST_AUTO_TEST_CASE(CheckRecoverPartialRecord)
+{
+  std::string dirPath = "tests/testdata/temp";
+  std::string storePath = MetadataStore::pathFor(dirPath);
+  fs::remove_all(dirPath);
+  auto packets = makeMetadata();
+  BOOST_REQUIRE(packets.size() > 1);
+
+  uint64_t lastOffset = 0;
+  {
+    MetadataStore store(storePath);
+    for (size_t i = 0; i + 1 < packets.size(); ++i) {
+      lastOffset = store.append(packets[i]);
+    }
+  }
+  // simulate a crash after the first half of the last record is appended
+  uint64_t recordsEnd = lastOffset + packets[packets.size() - 2].wireEncode().size();
+  fs::resize_file(storePath, recordsEnd);
+  {
+    const Block& wire = packets.back().wireEncode();
+    fs::ofstream os(storePath, fs::ofstream::binary | fs::ofstream::app);
+    os.write(reinterpret_cast<const char*>(wire.wire()), wire.size() / 2);
+  }
+  {
+    MetadataStore store(storePath);
+    checkEntries(store, vector<Data>(packets.begin(), packets.end() - 1));
+    BOOST_CHECK_EQUAL(recordsEnd, fs::file_size(storePath));
+  }
+  // a complete record that is not valid is still reported
+  fs::resize_file(storePath, recordsEnd);
+  {
+    fs::ofstream os(storePath, fs::ofstream::binary | fs::ofstream::app);
+    const char invalid[] = {0x05, 0x02, 0x07, 0x00};
+    os.write(invalid, sizeof(invalid));
+  }
+  BOOST_CHECK_THROW(MetadataStore store(storePath), MetadataStore::Error);
+  BOOST_CHECK_EQUAL(recordsEnd + 4, fs::file_size(storePath));
+  fs::remove_all(dirPath);
+}
+
+BOOST_AUTO_TEST_CASE(CheckLargeRecords)
+{
+  // a file large enough for its manifest and the index to exceed MAX_NDN_PACKET_SIZE with the
+  // default sizes
+  std::string srcPath = "tests/testdata/temp-large";
+  fs::remove_all(srcPath);
+  fs::create_directories(srcPath);
+  {
+    fs::ofstream os(srcPath + "/large.bin", fs::ofstream::binary);
+    for (size_t i = 0; i < 1024 * 1024; ++i) {
+      os.put(static_cast<char>((i * 2654435761u) >> 24));
+    }
+  }
+  auto content = TorrentFile::generate(srcPath, 1024, 1024, 1024);
+  vector<Data> packets(content.first.begin(), content.first.end());
+  for (const auto& ms : content.second) {
+    packets.insert(packets.end(), ms.first.begin(), ms.first.end());
+  }
+  BOOST_REQUIRE(std::any_of(packets.begin(), packets.end(), [] (const Data& d) {
+    return d.wireEncode().size() > MAX_NDN_PACKET_SIZE;
+  }));
+
+  std::string dirPath = "tests/testdata/temp";
+  std::string storePath = MetadataStore::pathFor(dirPath);
+  fs::remove_all(dirPath);
+  uint64_t lastOffset = 0;
+  {
+    MetadataStore store(storePath);
+    for (const auto& p : packets) {
+      lastOffset = store.append(p);
+    }
+    checkEntries(store, packets);
+  }
+  // through the index footer
+  {
+    MetadataStore store(storePath);
+    checkEntries(store, packets);
+  }
+  // through a scan of the records
+  fs::resize_file(storePath, lastOffset + packets.back().wireEncode().size());
+  {
+    MetadataStore store(storePath);
+    checkEntries(store, packets);
+  }
+  fs::remove_all(dirPath);
+  fs::remove_all(srcPath);
+}
+
+BOOST_AUTO_TEST_CASE(CheckInvalidStore)
+{
+  std::string dirPath = "tests/testdata/temp";
+  fs::create_directories(dirPath);
+  std::string storePath = MetadataStore::pathFor(dirPath);
+  fs::ofstream os(storePath);
+  os << "not a store";
+  os.close();
+  BOOST_CHECK_THROW(MetadataStore store(storePath), MetadataStore::Error);
+  fs::remove_all(dirPath);
+}
+
+BOOST_AUTO_TEST_CASE(CheckMigrate)
+{
+  std::string dirPath = "tests/testdata/temp/";
+  fs::remove_all(dirPath);
+  auto content = TorrentFile::generate("tests/testdata/foo", 1, 10, 10);
+  vector<Data> packets;
+  for (const auto& t : content.first) {
+    BOOST_CHECK(IoUtil::writeTorrentSegment(t, dirPath + "torrent_files/"));
+    packets.push_back(t);
+  }
+  for (const auto& ms : content.second) {
+    for (const auto& m : ms.first) {
+      BOOST_CHECK(IoUtil::writeFileManifest(m, dirPath + "manifests/"));
+      packets.push_back(m);
+    }
+  }
+  std::string storePath = MetadataStore::pathFor(dirPath);
+  BOOST_CHECK_EQUAL(packets.size(), MetadataStore::migrate(dirPath, storePath));
+  // records that are already in the store are not copied again
+  BOOST_CHECK_EQUAL(0, MetadataStore::migrate(dirPath, storePath));
+
+  MetadataStore store(storePath);
+  BOOST_CHECK_EQUAL(packets.size(), store.entries().size());
+  size_t numSegments = 0;
+  for (const auto& e : store.entries()) {
+    BOOST_CHECK(packets.end() != std::find_if(packets.begin(), packets.end(),
+                                              [&e](const Data& d) {
+                                                return d.getFullName() == e.fullName;
+                                              }));
+    if (IoUtil::TORRENT_FILE == IoUtil::findType(e.fullName)) {
+      // the torrent-file segments are migrated first
+      BOOST_CHECK_EQUAL(numSegments, &e - &store.entries().front());
+      ++numSegments;
+    }
+  }
+  BOOST_CHECK_EQUAL(content.first.size(), numSegments);
+  fs::remove_all(dirPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace nTorrent
+} // namespace ndn
@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "../boost-test.hpp"
+#include "util/signer.hpp"
+
+#include <string>
+#include <vector>
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+
+static Data
+makeData(size_t i)
+{
+  Data d(Name("/ndn/multicast/NTORRENT/foo/bar.txt/%00").appendSequenceNumber(i));
+  std::string content(i * 100, 'a' + i);
+  d.setContent(encoding::makeBinaryBlock(tlv::Content,
+                                         reinterpret_cast<const uint8_t*>(content.data()),
+                                         content.size()));
+  return d;
+}
+
+BOOST_AUTO_TEST_SUITE(TestSigner)
+
+BOOST_AUTO_TEST_CASE(CheckSameAsKeyChain)
+{
+  security::KeyChain keyChain;
+  for (size_t i = 0; i < 5; ++i) {
+    Data d1 = makeData(i);
+    Data d2 = makeData(i);
+    keyChain.sign(d1, signingWithSha256());
+    Signer::signWithSha256(d2);
+    BOOST_CHECK(d1.wireEncode() == d2.wireEncode());
+    BOOST_CHECK_EQUAL(d1.getFullName(), d2.getFullName());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CheckBatch)
+{
+  vector<Data> packets;
+  vector<Data> expected;
+  for (size_t i = 0; i < 5; ++i) {
+    packets.push_back(makeData(i));
+    expected.push_back(makeData(i));
+    Signer::signWithSha256(expected.back());
+  }
+  auto& signer = Signer::getDefault();
+  BOOST_CHECK_EQUAL(&signer, &Signer::getDefault());
+  signer.sign(packets.begin(), packets.end());
+  for (size_t i = 0; i < packets.size(); ++i) {
+    BOOST_CHECK_EQUAL(expected[i].getFullName(), packets[i].getFullName());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace nTorrent
+} // namespace ndn
@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/**
+* Copyright (c) 2016 Regents of the University of California.
+*
+* This file is part of the nTorrent codebase.
+*
+* nTorrent is free software: you can redistribute it and/or modify it under the
+* terms of the GNU Lesser General Public License as published by the Free Software
+* Foundation, either version 3 of the License, or (at your option) any later version.
+*
+* nTorrent is distributed in the hope that it will be useful, but WITHOUT ANY
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+* PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+*
+* You should have received copies of the GNU General Public License and GNU Lesser
+* General Public License along with nTorrent, e.g., in COPYING.md file. If not, see
+* <http://www.gnu.org/licenses/>.
+*
+* See AUTHORS for complete list of nTorrent authors and contributors.
+*/
+
+#include "../boost-test.hpp"
+#include "file-manifest.hpp"
+#include "manifest-tree-node.hpp"
+#include "util/io-util.hpp"
+#include "util/tree-builder.hpp"
+
+#include <vector>
+
+namespace ndn {
+namespace ntorrent {
+namespace tests {
+
+using std::vector;
+
+BOOST_AUTO_TEST_SUITE(TestTreeBuilder)
+
+BOOST_AUTO_TEST_CASE(CheckNodesCompletedInOrder)
+{
+  auto manifests = FileManifest::generate("tests/testdata/foo/bar1.txt",
+                                          "/ndn/multicast/NTORRENT/foo/", 1, 1024);
+  BOOST_REQUIRE_EQUAL(48, manifests.size());
+  Name filePrefix = manifests.front().getName().getPrefix(-1);
+
+  vector<ManifestTreeNode> nodes;
+  TreeBuilder tree(filePrefix, 4, manifests.size(), [&nodes] (const Data& d) {
+                     nodes.push_back(ManifestTreeNode(d.wireEncode()));
+                   });
+  for (size_t i = 0; i < manifests.size(); ++i) {
+    BOOST_CHECK(tree.getRootName().empty());
+    tree.append(manifests[i].getFullName());
+    // a node is passed as soon as its last child is appended, its parent after it
+    BOOST_CHECK_EQUAL(nodes.size(), (i + 1) / 4 + (i + 1) / 16 + (i + 1) / 48);
+  }
+  BOOST_REQUIRE_EQUAL(16, nodes.size());
+  BOOST_CHECK(nodes.back().isRoot());
+  BOOST_CHECK_EQUAL(nodes.back().getFullName(), tree.getRootName());
+  for (const auto& node : nodes) {
+    BOOST_CHECK_EQUAL(48, node.getLeafCount());
+    BOOST_CHECK_EQUAL(4, node.getFanout());
+  }
+  for (size_t i = 0; i < manifests.size(); ++i) {
+    BOOST_CHECK(nodes[(i / 4) + (i / 16)].verifyChild(manifests[i]));
+  }
+
+  // the root is complete, and a leaf out of order is rejected
+  BOOST_CHECK_THROW(tree.append(manifests.front().getFullName()), ManifestTreeNode::Error);
+  TreeBuilder other(filePrefix, 4, manifests.size(), [] (const Data&) {});
+  BOOST_CHECK_THROW(other.append(manifests[1].getFullName()), ManifestTreeNode::Error);
+}
+
+BOOST_AUTO_TEST_CASE(CheckSingleLeaf)
+{
+  auto manifests = FileManifest::generate("tests/testdata/foo/bar.txt",
+                                          "/ndn/multicast/NTORRENT/foo/", 1024, 1024);
+  BOOST_REQUIRE_EQUAL(1, manifests.size());
+  vector<Name> names;
+  TreeBuilder tree(manifests.front().getName().getPrefix(-1), 2, 1, [&names] (const Data& d) {
+                     names.push_back(d.getFullName());
+                   });
+  tree.append(manifests.front().getFullName());
+  // there is always a root, even above a single sub-manifest
+  BOOST_REQUIRE_EQUAL(1, names.size());
+  BOOST_CHECK_EQUAL(names.front(), tree.getRootName());
+  BOOST_CHECK_EQUAL(IoUtil::MANIFEST_TREE_NODE, IoUtil::findType(tree.getRootName()));
+}
+
+BOOST_AUTO_TEST_CASE(CheckFileManifestGenerateStreaming)
+{
+  auto tree = FileManifest::generateTree("tests/testdata/foo/bar1.txt",
+                                         "/ndn/multicast/NTORRENT/foo/", 1, 1024, 4);
+  vector<Name> names;
+  auto rootName = FileManifest::generateStreaming("tests/testdata/foo/bar1.txt",
+                                                  "/ndn/multicast/NTORRENT/foo/", 1, 1024,
+                                                  [&names] (const Data& d) {
+                                                    names.push_back(d.getFullName());
+                                                  },
+                                                  4);
+  BOOST_CHECK_EQUAL(tree.second.back().getFullName(), rootName);
+  BOOST_REQUIRE_EQUAL(tree.first.size() + tree.second.size(), names.size());
+  BOOST_CHECK_EQUAL(rootName, names.back());
+  // the sub-manifests are passed in order, each node after its children
+  size_t leaf = 0;
+  size_t node = 0;
+  for (const auto& name : names) {
+    if (IoUtil::MANIFEST_TREE_NODE == IoUtil::findType(name)) {
+      BOOST_CHECK_EQUAL(tree.second[node++].getFullName(), name);
+    }
+    else {
+      BOOST_CHECK_EQUAL(tree.first[leaf++].getFullName(), name);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace nTorrent
+} // namespace ndn